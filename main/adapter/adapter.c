@@ -6,13 +6,10 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
-#include <freertos/FreeRTOS.h>
-#include <freertos/ringbuf.h>
-#include <xtensa/hal.h>
-#include <esp_timer.h>
-#include "sdkconfig.h"
+#include <math.h>
 #include "../zephyr/types.h"
 #include "../util.h"
+#include "../trace.h"
 #include "config.h"
 #include "adapter.h"
 #include "npiso.h"
@@ -28,6 +25,17 @@
 #include "xb1.h"
 #include "sw.h"
 
+#define ADAPTER_MAP_SRC_MAX 128
+#define ADAPTER_CURVE_SHIFT 6
+#define ADAPTER_CURVE_PTS (1 << ADAPTER_CURVE_SHIFT)
+#define ADAPTER_CURVE_FRAC (15 - ADAPTER_CURVE_SHIFT)
+#define ADAPTER_DIAG_SHIFT 5
+#define ADAPTER_DIAG_PTS (1 << ADAPTER_DIAG_SHIFT)
+#define ADAPTER_DIAG_FRAC 10
+#define ADAPTER_STICK_MAX 2
+/* N64 gate diagonal vs cardinal reach */
+#define ADAPTER_N64_GATE_DIAG 0.82f
+
 const uint32_t hat_to_ld_btns[16] = {
     BIT(PAD_LD_UP), BIT(PAD_LD_UP) | BIT(PAD_LD_RIGHT), BIT(PAD_LD_RIGHT), BIT(PAD_LD_DOWN) | BIT(PAD_LD_RIGHT),
     BIT(PAD_LD_DOWN), BIT(PAD_LD_DOWN) | BIT(PAD_LD_LEFT), BIT(PAD_LD_LEFT), BIT(PAD_LD_UP) | BIT(PAD_LD_LEFT),
@@ -166,11 +174,63 @@ static buffer_init_t buffer_init_func[WIRED_MAX] = {
     NULL, /* EXP_BOARD */
 };
 
+/* Per BT device mapping dispatch table, compiled from in_cfg on config change */
+struct map_entry {
+    int32_t deadzone;
+    int32_t threshold;
+    int32_t range;
+    uint32_t in_scale;
+    int32_t out_max;
+    const uint16_t *curve;
+    const struct ctrl_meta *dst_meta;
+    uint8_t cfg_idx;
+    uint8_t dst_id;
+    uint8_t dst_btn_idx;
+    uint8_t dst_axis_idx;
+};
+
+struct map_table {
+    uint32_t src_mask[4];
+    uint32_t dst_mask;
+    const struct ctrl_meta *src_meta[ADAPTER_MAX_AXES];
+    uint8_t src_first[ADAPTER_MAP_SRC_MAX + 1];
+    uint8_t diag[WIRED_MAX_DEV][ADAPTER_STICK_MAX];
+    struct map_entry entries[ADAPTER_MAPPING_MAX];
+};
+
+/* Last state sent to from_generic for an output */
+struct out_state {
+    uint32_t map_mask[4];
+    int32_t btns[4];
+    int32_t axes[ADAPTER_MAX_AXES];
+};
+
+struct in_state {
+    int32_t dev_type;
+    uint32_t report_id;
+    uint8_t input[sizeof(((struct bt_data *)0)->input)];
+};
+
 struct generic_ctrl ctrl_input;
 struct generic_ctrl ctrl_output[WIRED_MAX_DEV];
 struct generic_fb fb_input;
 struct bt_adapter bt_adapter = {0};
 struct wired_adapter wired_adapter = {0};
+struct adapter_stats adapter_stats = {0};
+static struct map_table map_tables[BT_MAX_DEV];
+static atomic_t map_tables_valid = 0;
+/* Output meta are only rebuilt when the wired system or an output dev mode change */
+static int32_t meta_system_id = WIRED_NONE;
+static int32_t meta_dev_mode[WIRED_MAX_DEV];
+static struct generic_ctrl meta_ctrl[WIRED_MAX_DEV];
+static struct in_state in_states[BT_MAX_DEV];
+static atomic_t in_states_valid = 0;
+static struct out_state out_states[WIRED_MAX_DEV];
+static atomic_t out_states_valid = 0;
+/* Q15 response curves, PASSTHROUGH bypass the curve */
+static uint16_t curve_lut[PASSTHROUGH][ADAPTER_CURVE_PTS + 1];
+/* Q14 radial gain per stick direction, 1st half indexed by y/x, 2nd by x/y */
+static uint16_t diag_lut[DIAG_MAX][2 * ADAPTER_DIAG_PTS + 1];
 
 static uint32_t btn_id_to_btn_idx(uint8_t btn_id) {
     if (btn_id < 32) {
@@ -187,15 +247,121 @@ static uint32_t btn_id_to_btn_idx(uint8_t btn_id) {
     }
 }
 
-static uint32_t adapter_map_from_axis(struct map_cfg * map_cfg) {
-    uint32_t out_mask = BIT(map_cfg->dst_id);
-    struct generic_ctrl *out = &ctrl_output[map_cfg->dst_id];
+static void adapter_map_refresh_axis(struct map_table *table, struct in_cfg *in_cfg, uint32_t axis) {
+    const struct ctrl_meta *meta = ctrl_input.axes[axis].meta;
+    uint32_t slots = axis_to_btn_mask(axis) & table->src_mask[0];
+
+    /* All axes sources live in the first buttons word */
+    while (slots) {
+        uint32_t slot = __builtin_ffs(slots) - 1;
+        slots &= ~BIT(slot);
+
+        for (uint32_t i = table->src_first[slot]; i < table->src_first[slot + 1]; i++) {
+            struct map_entry *entry = &table->entries[i];
+            struct map_cfg *map_cfg = &in_cfg->map_cfg[entry->cfg_idx];
+
+            entry->deadzone = (int32_t)(((float)map_cfg->perc_deadzone/10000) * meta->abs_max) + meta->deadzone;
+            entry->threshold = (int32_t)(((float)map_cfg->perc_threshold/100) * meta->abs_max);
+            entry->range = meta->abs_max - entry->deadzone;
+            if (entry->range < 1) {
+                entry->range = 1;
+            }
+            /* Round up so a full range input reach the last curve point */
+            entry->in_scale = (BIT(31) + entry->range - 1) / entry->range;
+        }
+    }
+    table->src_meta[axis] = meta;
+}
+
+static void adapter_map_compile(struct map_table *table, struct in_cfg *in_cfg) {
+    uint8_t slot_cnt[ADAPTER_MAP_SRC_MAX] = {0};
+    uint8_t slot_pos[ADAPTER_MAP_SRC_MAX];
+    uint32_t entry_cnt = 0;
+
+    memset(table->src_mask, 0, sizeof(table->src_mask));
+    table->dst_mask = 0;
+    memset(table->src_meta, 0, sizeof(table->src_meta));
+    memset(table->diag, DIAG_PASSTHROUGH, sizeof(table->diag));
+
+    /* Count mappings per source so each source get a contiguous entries range */
+    for (uint32_t i = 0; i < in_cfg->map_size; i++) {
+        struct map_cfg *map_cfg = &in_cfg->map_cfg[i];
+
+        if (map_cfg->src_btn < ADAPTER_MAP_SRC_MAX && map_cfg->dst_id < WIRED_MAX_DEV) {
+            slot_cnt[map_cfg->src_btn]++;
+        }
+    }
+
+    for (uint32_t i = 0; i < ADAPTER_MAP_SRC_MAX; i++) {
+        table->src_first[i] = entry_cnt;
+        slot_pos[i] = entry_cnt;
+        entry_cnt += slot_cnt[i];
+        if (slot_cnt[i]) {
+            table->src_mask[btn_id_to_btn_idx(i)] |= BIT(i & 0x1F);
+        }
+    }
+    table->src_first[ADAPTER_MAP_SRC_MAX] = entry_cnt;
+
+    /* Fill entries keeping config order within a source */
+    for (uint32_t i = 0; i < in_cfg->map_size; i++) {
+        struct map_cfg *map_cfg = &in_cfg->map_cfg[i];
+
+        if (map_cfg->src_btn < ADAPTER_MAP_SRC_MAX && map_cfg->dst_id < WIRED_MAX_DEV) {
+            struct map_entry *entry = &table->entries[slot_pos[map_cfg->src_btn]++];
+
+            entry->cfg_idx = i;
+            entry->dst_id = map_cfg->dst_id;
+            table->dst_mask |= BIT(map_cfg->dst_id);
+            entry->dst_btn_idx = btn_id_to_btn_idx(map_cfg->dst_btn);
+            entry->dst_axis_idx = btn_id_to_axis(map_cfg->dst_btn);
+            entry->deadzone = 0;
+            entry->threshold = 0;
+            entry->range = 1;
+            entry->in_scale = 0;
+            entry->curve = ((map_cfg->algo & 0xF) < PASSTHROUGH) ? curve_lut[map_cfg->algo & 0xF] : NULL;
+            entry->dst_meta = NULL;
+
+            /* Diagonal mode apply to the whole stick a mapping target */
+            if (entry->dst_axis_idx < ADAPTER_STICK_MAX * 2 && (map_cfg->algo >> 4) < DIAG_MAX
+                    && (map_cfg->algo >> 4) != DIAG_PASSTHROUGH) {
+                table->diag[entry->dst_id][entry->dst_axis_idx >> 1] = map_cfg->algo >> 4;
+            }
+        }
+    }
+}
+
+static void adapter_map_refresh_dst(struct map_entry *entry, struct map_cfg *map_cfg, const struct ctrl_meta *meta) {
+    entry->out_max = meta->abs_max * map_cfg->perc_max / 100;
+    entry->dst_meta = meta;
+}
+
+static int32_t adapter_map_curve(struct map_entry *entry, int32_t value) {
+    uint32_t x, idx, frac;
+    int32_t y;
+
+    if (value > entry->range) {
+        value = entry->range;
+    }
+    /* Normalize to Q15 then interpolate between the 2 nearest curve points */
+    x = ((uint32_t)value * entry->in_scale) >> 16;
+    idx = x >> ADAPTER_CURVE_FRAC;
+    frac = x & (BIT(ADAPTER_CURVE_FRAC) - 1);
+    if (idx >= ADAPTER_CURVE_PTS) {
+        return entry->out_max;
+    }
+    y = entry->curve[idx] + ((((int32_t)entry->curve[idx + 1] - entry->curve[idx]) * (int32_t)frac) >> ADAPTER_CURVE_FRAC);
+
+    return (int32_t)(((int64_t)y * entry->out_max) >> 15);
+}
+
+static uint32_t adapter_map_from_axis(struct map_entry *entry, struct map_cfg *map_cfg, uint32_t src_axis_idx) {
+    uint32_t out_mask = BIT(entry->dst_id);
+    struct generic_ctrl *out = &ctrl_output[entry->dst_id];
     uint8_t src = map_cfg->src_btn;
     uint8_t dst = map_cfg->dst_btn;
     uint32_t dst_mask = BIT(dst & 0x1F);
-    uint32_t dst_btn_idx = btn_id_to_btn_idx(dst);
-    uint32_t src_axis_idx = btn_id_to_axis(src);
-    uint32_t dst_axis_idx = btn_id_to_axis(dst);
+    uint32_t dst_btn_idx = entry->dst_btn_idx;
+    uint32_t dst_axis_idx = entry->dst_axis_idx;
 
     /* Check if mapping dst exist in output */
     if (dst_mask & out->mask[dst_btn_idx]) {
@@ -208,23 +374,21 @@ static uint32_t adapter_map_from_axis(struct map_cfg * map_cfg) {
             /* Check if dst is an axis */
             if (dst_mask & out->desc[dst_btn_idx]) {
                 /* Dst is an axis */
-                int32_t deadzone = (int32_t)(((float)map_cfg->perc_deadzone/10000) * ctrl_input.axes[src_axis_idx].meta->abs_max) + ctrl_input.axes[src_axis_idx].meta->deadzone;
+                int32_t deadzone = entry->deadzone;
                 /* Check if axis over deadzone */
                 if (abs_src_value > deadzone) {
                     int32_t value = abs_src_value - deadzone;
                     int32_t dst_sign = btn_sign(out->axes[dst_axis_idx].meta->polarity, dst);
-                    float scale, fvalue;
-                    switch (map_cfg->algo & 0xF) {
-                        case LINEAR:
-                            scale = ((float)out->axes[dst_axis_idx].meta->abs_max / (ctrl_input.axes[src_axis_idx].meta->abs_max - deadzone)) * (((float)map_cfg->perc_max)/100);
-                            break;
-                        default:
-                            scale = ((float)map_cfg->perc_max)/100;
-                            break;
 
+                    if (entry->curve) {
+                        if (entry->dst_meta != out->axes[dst_axis_idx].meta) {
+                            adapter_map_refresh_dst(entry, map_cfg, out->axes[dst_axis_idx].meta);
+                        }
+                        value = dst_sign * adapter_map_curve(entry, value);
+                    }
+                    else {
+                        value = dst_sign * value * map_cfg->perc_max / 100;
                     }
-                    fvalue = dst_sign * value * scale;
-                    value = (int32_t)fvalue;
 
                     if (abs(value) > abs(out->axes[dst_axis_idx].value)) {
                         out->axes[dst_axis_idx].value = value;
@@ -233,9 +397,8 @@ static uint32_t adapter_map_from_axis(struct map_cfg * map_cfg) {
             }
             else {
                 /* Dst is a button */
-                int32_t threshold = (int32_t)(((float)map_cfg->perc_threshold/100) * ctrl_input.axes[src_axis_idx].meta->abs_max);
                 /* Check if axis over threshold */
-                if (abs_src_value > threshold) {
+                if (abs_src_value > entry->threshold) {
                     out->btns[dst_btn_idx].value |= dst_mask;
                 }
             }
@@ -247,12 +410,12 @@ static uint32_t adapter_map_from_axis(struct map_cfg * map_cfg) {
     return out_mask;
 }
 
-static uint32_t adapter_map_from_btn(struct map_cfg * map_cfg, uint32_t src_mask, uint32_t src_btn_idx) {
-    uint32_t out_mask = BIT(map_cfg->dst_id);
-    struct generic_ctrl *out = &ctrl_output[map_cfg->dst_id];
+static uint32_t adapter_map_from_btn(struct map_entry *entry, struct map_cfg *map_cfg, uint32_t src_mask, uint32_t src_btn_idx) {
+    uint32_t out_mask = BIT(entry->dst_id);
+    struct generic_ctrl *out = &ctrl_output[entry->dst_id];
     uint8_t dst = map_cfg->dst_btn;
     uint32_t dst_mask = BIT(dst & 0x1F);
-    uint32_t dst_btn_idx = btn_id_to_btn_idx(dst);
+    uint32_t dst_btn_idx = entry->dst_btn_idx;
 
     /* Check if mapping dst exist in output */
     if (dst_mask & out->mask[dst_btn_idx]) {
@@ -261,11 +424,13 @@ static uint32_t adapter_map_from_btn(struct map_cfg * map_cfg, uint32_t src_mask
             /* Check if dst is an axis */
             if (dst_mask & out->desc[dst_btn_idx]) {
                 /* Dst is an axis */
-                uint32_t axis_id = btn_id_to_axis(dst);
-                float fvalue = out->axes[axis_id].meta->abs_max
-                            * btn_sign(out->axes[axis_id].meta->polarity, dst)
-                            * (((float)map_cfg->perc_max)/100);
-                int32_t value = (int32_t)fvalue;
+                uint32_t axis_id = entry->dst_axis_idx;
+                int32_t value;
+
+                if (entry->dst_meta != out->axes[axis_id].meta) {
+                    adapter_map_refresh_dst(entry, map_cfg, out->axes[axis_id].meta);
+                }
+                value = entry->out_max * btn_sign(out->axes[axis_id].meta->polarity, dst);
 
                 if (abs(value) > abs(out->axes[axis_id].value)) {
                     out->axes[axis_id].value = value;
@@ -283,37 +448,212 @@ static uint32_t adapter_map_from_btn(struct map_cfg * map_cfg, uint32_t src_mask
     return out_mask;
 }
 
-static uint32_t adapter_mapping(struct in_cfg * in_cfg) {
+static void adapter_output_reset(struct generic_ctrl *out) {
+    memset(out->map_mask, 0, sizeof(out->map_mask));
+    for (uint32_t i = 0; i < ARRAY_SIZE(out->btns); i++) {
+        out->btns[i].value = 0;
+    }
+    for (uint32_t i = 0; i < ADAPTER_MAX_AXES; i++) {
+        out->axes[i].value = 0;
+    }
+}
+
+static struct map_table *adapter_map_table(uint8_t dev_id, struct in_cfg *in_cfg) {
+    struct map_table *table = &map_tables[dev_id];
+
+    if (!atomic_test_bit(&map_tables_valid, dev_id)) {
+        adapter_map_compile(table, in_cfg);
+        atomic_set_bit(&map_tables_valid, dev_id);
+    }
+    return table;
+}
+
+static void adapter_meta_invalidate(void) {
+    for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
+        meta_dev_mode[i] = -1;
+    }
+}
+
+static void adapter_meta_refresh(uint8_t dev_id, int32_t dev_mode) {
+    struct map_table *table = adapter_map_table(dev_id, &config.in_cfg[dev_id]);
+
+    if (wired_adapter.system_id != meta_system_id) {
+        meta_system_id = wired_adapter.system_id;
+        adapter_meta_invalidate();
+    }
+
+    /* Only rebuild the outputs this device write to, other devices may use another mode */
+    for (uint32_t i = 0, dst_mask = table->dst_mask; dst_mask; i++, dst_mask >>= 1) {
+        if ((dst_mask & 0x1) && meta_dev_mode[i] != dev_mode) {
+            meta_init_func[wired_adapter.system_id](dev_mode, meta_ctrl);
+            ctrl_output[i] = meta_ctrl[i];
+            meta_dev_mode[i] = dev_mode;
+            atomic_clear_bit(&out_states_valid, i);
+            atomic_clear(&in_states_valid);
+        }
+    }
+}
+
+static uint32_t adapter_mapping(uint8_t dev_id, struct in_cfg * in_cfg) {
+    struct map_table *table = adapter_map_table(dev_id, in_cfg);
     uint32_t out_mask = 0;
 
-    for (uint32_t i = 0; i < in_cfg->map_size; i++) {
-        uint8_t src = in_cfg->map_cfg[i].src_btn;
-        uint32_t src_mask = BIT(src & 0x1F);
-        uint32_t src_btn_idx = btn_id_to_btn_idx(src);
+    /* Only clear the outputs this device can write to */
+    for (uint32_t i = 0, dst_mask = table->dst_mask; dst_mask; i++, dst_mask >>= 1) {
+        if (dst_mask & 0x1) {
+            adapter_output_reset(&ctrl_output[i]);
+        }
+    }
+
+    for (uint32_t src_btn_idx = 0; src_btn_idx < ARRAY_SIZE(table->src_mask); src_btn_idx++) {
+        /* Only visit sources that are both mapped and present in input */
+        uint32_t srcs = table->src_mask[src_btn_idx] & ctrl_input.mask[src_btn_idx];
+
+        while (srcs) {
+            uint32_t bit = __builtin_ffs(srcs) - 1;
+            uint32_t src_mask = BIT(bit);
+            uint32_t slot = src_btn_idx * 32 + bit;
+            srcs &= ~src_mask;
 
-        /* Check if mapping src exist in input */
-        if (src_mask & ctrl_input.mask[src_btn_idx]) {
             /* Check if src is an axis */
             if (src_mask & ctrl_input.desc[src_btn_idx]) {
                 /* Src is an axis */
-                out_mask |= adapter_map_from_axis(&in_cfg->map_cfg[i]);
+                uint32_t src_axis_idx = btn_id_to_axis(slot);
+
+                if (src_axis_idx >= ADAPTER_MAX_AXES) {
+                    continue;
+                }
+                if (table->src_meta[src_axis_idx] != ctrl_input.axes[src_axis_idx].meta) {
+                    adapter_map_refresh_axis(table, in_cfg, src_axis_idx);
+                }
+                for (uint32_t i = table->src_first[slot]; i < table->src_first[slot + 1]; i++) {
+                    struct map_entry *entry = &table->entries[i];
+                    out_mask |= adapter_map_from_axis(entry, &in_cfg->map_cfg[entry->cfg_idx], src_axis_idx);
+                }
             }
             else {
                 /* Src is a button */
-                out_mask |= adapter_map_from_btn(&in_cfg->map_cfg[i], src_mask, src_btn_idx);
+                for (uint32_t i = table->src_first[slot]; i < table->src_first[slot + 1]; i++) {
+                    struct map_entry *entry = &table->entries[i];
+                    out_mask |= adapter_map_from_btn(entry, &in_cfg->map_cfg[entry->cfg_idx], src_mask, src_btn_idx);
+                }
             }
         }
     }
     return out_mask;
 }
 
-static void adapter_fb_stop_cb(void* arg) {
-    uint8_t dev_id = (uint8_t)(uintptr_t)arg;
+static void adapter_diag_stick(const uint16_t *lut, struct ctrl *x_axis, struct ctrl *y_axis) {
+    int32_t abs_x = abs(x_axis->value);
+    int32_t abs_y = abs(y_axis->value);
+    uint32_t t, idx, frac;
+    int32_t gain;
+
+    if (abs_x == 0 && abs_y == 0) {
+        return;
+    }
 
-    /* Send 1 byte, system that require callback stop shall look for that */
-    xRingbufferSend(wired_adapter.input_q_hdl, &dev_id, 1, 0);
+    /* Fold the direction into a 0 to 2 * ADAPTER_DIAG_PTS index in Q10 */
+    if (abs_x >= abs_y) {
+        t = ((uint32_t)abs_y << (ADAPTER_DIAG_SHIFT + ADAPTER_DIAG_FRAC)) / abs_x;
+    }
+    else {
+        t = (2 * ADAPTER_DIAG_PTS << ADAPTER_DIAG_FRAC)
+            - (((uint32_t)abs_x << (ADAPTER_DIAG_SHIFT + ADAPTER_DIAG_FRAC)) / abs_y);
+    }
+    idx = t >> ADAPTER_DIAG_FRAC;
+    frac = t & (BIT(ADAPTER_DIAG_FRAC) - 1);
+    gain = lut[idx];
+    if (idx < 2 * ADAPTER_DIAG_PTS) {
+        gain += (((int32_t)lut[idx + 1] - lut[idx]) * (int32_t)frac) >> ADAPTER_DIAG_FRAC;
+    }
+
+    x_axis->value = (x_axis->value * gain) / (1 << 14);
+    y_axis->value = (y_axis->value * gain) / (1 << 14);
+}
+
+static void adapter_diag(uint8_t dev_id, uint32_t out_mask) {
+    struct map_table *table = &map_tables[dev_id];
+
+    for (uint32_t i = 0; out_mask; i++, out_mask >>= 1) {
+        if (out_mask & 0x1) {
+            for (uint32_t j = 0; j < ADAPTER_STICK_MAX; j++) {
+                if (table->diag[i][j] != DIAG_PASSTHROUGH) {
+                    adapter_diag_stick(diag_lut[table->diag[i][j]], &ctrl_output[i].axes[j * 2], &ctrl_output[i].axes[j * 2 + 1]);
+                }
+            }
+        }
+    }
+}
+
+static uint32_t adapter_input_unchanged(struct bt_data *bt_data) {
+    struct in_state *state = &in_states[bt_data->dev_id];
+
+    /* Identical mouse reports still mean motion */
+    if (bt_data->dev_type == HID_GENERIC && bt_data->report_type == MOUSE) {
+        return 0;
+    }
+    if (atomic_test_bit(&in_states_valid, bt_data->dev_id) && state->dev_type == bt_data->dev_type
+            && state->report_id == bt_data->report_id
+            && memcmp(state->input, bt_data->input, sizeof(state->input)) == 0) {
+        return 1;
+    }
+    state->dev_type = bt_data->dev_type;
+    state->report_id = bt_data->report_id;
+    memcpy(state->input, bt_data->input, sizeof(state->input));
+    atomic_set_bit(&in_states_valid, bt_data->dev_id);
+    return 0;
 }
 
+static uint32_t adapter_output_unchanged(uint8_t wired_id, int32_t dev_mode) {
+    struct generic_ctrl *out = &ctrl_output[wired_id];
+    struct out_state *state = &out_states[wired_id];
+    uint32_t changed = !atomic_test_bit(&out_states_valid, wired_id);
+
+    /* Mouse outputs accumulate motion, identical axes still move */
+    if (dev_mode == DEV_MOUSE) {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(state->map_mask); i++) {
+        if (state->map_mask[i] != out->map_mask[i] || state->btns[i] != out->btns[i].value) {
+            state->map_mask[i] = out->map_mask[i];
+            state->btns[i] = out->btns[i].value;
+            changed = 1;
+        }
+    }
+    for (uint32_t i = 0; i < ADAPTER_MAX_AXES; i++) {
+        if (state->axes[i] != out->axes[i].value) {
+            state->axes[i] = out->axes[i].value;
+            changed = 1;
+        }
+    }
+    atomic_set_bit(&out_states_valid, wired_id);
+    return !changed;
+}
+
+/* bt_data is the report the frame is built from, NULL if not from BT */
+static void adapter_output_publish(uint8_t wired_id, struct bt_data *bt_data) {
+    struct wired_data *wired_data = &wired_adapter.data[wired_id];
+    uint32_t seq = atomic_get(&wired_data->frame_seq) + 1;
+
+    /* Fill the frame not in use by wired driver then flip */
+    memcpy(wired_data->frame[seq & 0x1], wired_data->output, sizeof(wired_data->output));
+    wired_data->frame_ts[seq & 0x1] = bt_data ? bt_data->timestamp : 0;
+    wired_data->frame_ts_valid[seq & 0x1] = (bt_data != NULL);
+    if (wired_adapter.frame_encode) {
+        wired_adapter.frame_encode(wired_id, seq & 0x1);
+    }
+    atomic_set(&wired_data->frame_seq, seq);
+}
+
+#ifdef ADAPTER_TEST
+/* Host tests publish wired_data->output like a translated report */
+void adapter_test_publish(uint8_t wired_id, struct bt_data *bt_data) {
+    adapter_output_publish(wired_id, bt_data);
+}
+#endif /* ADAPTER_TEST */
+
 uint8_t btn_id_to_axis(uint8_t btn_id) {
     switch (btn_id) {
         case PAD_LX_LEFT:
@@ -389,8 +729,11 @@ int8_t btn_sign(uint32_t polarity, uint8_t btn_id) {
 }
 
 void adapter_init_buffer(uint8_t wired_id) {
+    atomic_clear_bit(&out_states_valid, wired_id);
+    atomic_clear(&in_states_valid);
     if (wired_adapter.system_id != WIRED_NONE && buffer_init_func[wired_adapter.system_id]) {
         buffer_init_func[wired_adapter.system_id](config.out_cfg[wired_id].dev_mode, &wired_adapter.data[wired_id]);
+        adapter_output_publish(wired_id, NULL);
     }
 }
 
@@ -398,11 +741,15 @@ void adapter_init_buffer(uint8_t wired_id) {
 //#define INPUT_MAP_DBG
 void adapter_bridge(struct bt_data *bt_data) {
     uint32_t out_mask = 0;
-    //uint32_t end, start = xthal_get_ccount();
-    //static uint32_t last = 0;
-    //uint32_t cur = xthal_get_ccount();
 #if 1
     if (bt_data->dev_id != BT_NONE && to_generic_func[bt_data->dev_type]) {
+        adapter_stats.reports[bt_data->dev_type]++;
+        if (adapter_input_unchanged(bt_data) && wired_adapter.system_id == meta_system_id) {
+            adapter_stats.input_skip[bt_data->dev_type]++;
+            return;
+        }
+
+        TRACE(TRACE_TO_GENERIC, bt_data->dev_type);
         to_generic_func[bt_data->dev_type](bt_data, &ctrl_input);
 
 #ifdef INPUT_DBG
@@ -412,9 +759,13 @@ void adapter_bridge(struct bt_data *bt_data) {
             BOLD, ctrl_input.btns[2].value, RESET, BOLD, ctrl_input.btns[3].value, RESET);
 #else
         if (wired_adapter.system_id != WIRED_NONE && from_generic_func[wired_adapter.system_id]) {
-            meta_init_func[wired_adapter.system_id](config.out_cfg[bt_data->dev_id].dev_mode, ctrl_output);
+            int32_t dev_mode = config.out_cfg[bt_data->dev_id].dev_mode;
+
+            adapter_meta_refresh(bt_data->dev_id, dev_mode);
 
-            out_mask = adapter_mapping(&config.in_cfg[bt_data->dev_id]);
+            TRACE(TRACE_MAPPING, bt_data->dev_id);
+            out_mask = adapter_mapping(bt_data->dev_id, &config.in_cfg[bt_data->dev_id]);
+            adapter_diag(bt_data->dev_id, out_mask);
 
 #ifdef INPUT_MAP_DBG
             printf("LX: %s%08X%s, LY: %s%08X%s, RX: %s%08X%s, RY: %s%08X%s, LT: %s%08X%s, RT: %s%08X%s, BTNS: %s%08X%s, BTNS: %s%08X%s, BTNS: %s%08X%s, BTNS: %s%08X%s\n",
@@ -423,34 +774,29 @@ void adapter_bridge(struct bt_data *bt_data) {
                 BOLD, ctrl_output[0].btns[2].value, RESET, BOLD, ctrl_output[0].btns[3].value, RESET);
 #else
             for (uint32_t i = 0; out_mask; i++, out_mask >>= 1) {
-                from_generic_func[wired_adapter.system_id](config.out_cfg[bt_data->dev_id].dev_mode, &ctrl_output[i], &wired_adapter.data[i]);
+                if (out_mask & 0x1) {
+                    adapter_stats.outputs[bt_data->dev_type]++;
+                    if (adapter_output_unchanged(i, dev_mode)) {
+                        adapter_stats.output_skip[bt_data->dev_type]++;
+                        continue;
+                    }
+                    TRACE(TRACE_FROM_GENERIC, i);
+                    from_generic_func[wired_adapter.system_id](dev_mode, &ctrl_output[i], &wired_adapter.data[i]);
+                    adapter_output_publish(i, bt_data);
+                }
             }
 #endif
         }
 #endif
     }
 #endif
-    //end = xthal_get_ccount();
-    //printf("%dus\n", (end - start)/CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ);
-    //printf("%dus\n", (cur - last)/CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ);
-    //last = cur;
 }
 
-void adapter_fb_stop_timer_start(uint8_t dev_id, uint64_t dur_us) {
-    if (wired_adapter.data[dev_id].fb_timer_hdl == NULL) {
-        const esp_timer_create_args_t fb_timer_args = {
-            .callback = &adapter_fb_stop_cb,
-            .arg = (void*)(uintptr_t)dev_id,
-            .name = "fb_timer"
-        };
-        esp_timer_create(&fb_timer_args, (esp_timer_handle_t *)&wired_adapter.data[dev_id].fb_timer_hdl);
-        esp_timer_start_once(wired_adapter.data[dev_id].fb_timer_hdl, dur_us);
-    }
-}
-
-void adapter_fb_stop_timer_stop(uint8_t dev_id) {
-    esp_timer_delete(wired_adapter.data[dev_id].fb_timer_hdl);
-    wired_adapter.data[dev_id].fb_timer_hdl = NULL;
+void adapter_config_changed(void) {
+    /* Mapping tables get recompiled on next report of each device */
+    atomic_clear(&map_tables_valid);
+    atomic_clear(&in_states_valid);
+    adapter_meta_invalidate();
 }
 
 uint32_t adapter_bridge_fb(uint8_t *fb_data, uint32_t fb_len, struct bt_data *bt_data) {
@@ -466,19 +812,126 @@ uint32_t adapter_bridge_fb(uint8_t *fb_data, uint32_t fb_len, struct bt_data *bt
     return ret;
 }
 
-void IRAM_ATTR adapter_q_fb(uint8_t *data, uint32_t len) {
-    UBaseType_t ret;
-    ret = xRingbufferSendFromISR(wired_adapter.input_q_hdl, data, len, NULL);
-    if (ret != pdTRUE) {
-        ets_printf("# %s input_q full!\n", __FUNCTION__);
+void IRAM_ATTR adapter_latency_record(uint8_t wired_id, uint32_t now) {
+    struct wired_data *wired_data = &wired_adapter.data[wired_id];
+    struct wired_latency *latency = &wired_adapter.latency[wired_id];
+    uint32_t seq = atomic_get(&wired_data->frame_seq);
+    uint32_t timestamp = wired_data->frame_ts[seq & 0x1];
+    uint32_t age, bucket;
+
+    /* Only account the first time a frame built from a BT report is served */
+    if (seq == latency->last_seq || !wired_data->frame_ts_valid[seq & 0x1]) {
+        return;
+    }
+    latency->last_seq = seq;
+
+    age = now - timestamp;
+    bucket = age / ADAPTER_LATENCY_BUCKET_US;
+    if (bucket >= ADAPTER_LATENCY_BUCKETS) {
+        bucket = ADAPTER_LATENCY_BUCKETS - 1;
+    }
+    latency->hist[bucket]++;
+    latency->sum += age;
+    if (latency->cnt == 0 || age < latency->min) {
+        latency->min = age;
+    }
+    if (age > latency->max) {
+        latency->max = age;
+    }
+    latency->cnt++;
+}
+
+void adapter_latency_get(uint8_t wired_id, struct adapter_latency_stats *stats) {
+    struct wired_latency *latency = &wired_adapter.latency[wired_id];
+    uint32_t target, acc = 0;
+
+    memset((void *)stats, 0, sizeof(*stats));
+    stats->cnt = latency->cnt;
+    if (stats->cnt == 0) {
+        return;
+    }
+    stats->min = latency->min;
+    stats->max = latency->max;
+    stats->avg = (uint32_t)(latency->sum / stats->cnt);
+
+    /* p99 is the upper bound of the bucket reaching 99% of samples */
+    target = stats->cnt - stats->cnt / 100;
+    for (uint32_t i = 0; i < ADAPTER_LATENCY_BUCKETS; i++) {
+        acc += latency->hist[i];
+        if (acc >= target) {
+            stats->p99 = (i + 1) * ADAPTER_LATENCY_BUCKET_US;
+            break;
+        }
+    }
+    if (stats->p99 > stats->max) {
+        stats->p99 = stats->max;
+    }
+}
+
+static void adapter_curve_init(void) {
+    for (uint32_t i = 0; i <= ADAPTER_CURVE_PTS; i++) {
+        float x = (float)i / ADAPTER_CURVE_PTS;
+        float y[PASSTHROUGH] = {
+            x, /* LINEAR */
+            1.0f - (1.0f - x) * (1.0f - x), /* AGGRESSIVE */
+            x * x, /* RELAXED */
+            x * x * x, /* WIDE */
+            x * x * (3.0f - 2.0f * x), /* S_CURVE */
+        };
+
+        for (uint32_t j = 0; j < PASSTHROUGH; j++) {
+            curve_lut[j][i] = (uint16_t)(y[j] * BIT(15) + 0.5f);
+        }
+    }
+}
+
+/* Gate radius at angle for a unit circle, square, hexagon and N64 octagon */
+static float adapter_gate_radius(uint32_t gate, float angle) {
+    float c = fabsf(cosf(angle)), s = fabsf(sinf(angle));
+
+    switch (gate) {
+        case SQUARE_CIRCLE:
+            return 1.0f / ((c > s) ? c : s);
+        case CIRCLE_HEX:
+        {
+            float sector = floorf(angle / (float)(M_PI / 3));
+            return cosf((float)(M_PI / 6)) / cosf(angle - sector * (float)(M_PI / 3) - (float)(M_PI / 6));
+        }
+        case CIRCLE_OCTAGON:
+        {
+            float lo = (c < s) ? c : s, hi = (c > s) ? c : s;
+            return 1.0f / (hi + lo * (1.0f - ADAPTER_N64_GATE_DIAG) / ADAPTER_N64_GATE_DIAG);
+        }
+        default:
+            return 1.0f;
+    }
+}
+
+static void adapter_diag_init(void) {
+    for (uint32_t i = 0; i <= 2 * ADAPTER_DIAG_PTS; i++) {
+        float angle = (i <= ADAPTER_DIAG_PTS) ? atanf((float)i / ADAPTER_DIAG_PTS)
+            : (float)(M_PI / 2) - atanf((float)(2 * ADAPTER_DIAG_PTS - i) / ADAPTER_DIAG_PTS);
+        float square = adapter_gate_radius(SQUARE_CIRCLE, angle);
+        float hex = adapter_gate_radius(CIRCLE_HEX, angle);
+        float gain[DIAG_MAX] = {
+            1.0f, /* DIAG_PASSTHROUGH */
+            square, /* CIRCLE_SQUARE */
+            hex, /* CIRCLE_HEX */
+            1.0f / square, /* SQUARE_CIRCLE */
+            hex / square, /* SQUARE_HEX */
+            adapter_gate_radius(CIRCLE_OCTAGON, angle), /* CIRCLE_OCTAGON */
+        };
+
+        for (uint32_t j = 0; j < DIAG_MAX; j++) {
+            diag_lut[j][i] = (uint16_t)(gain[j] * BIT(14) + 0.5f);
+        }
     }
 }
 
 void adapter_init(void) {
     wired_adapter.system_id = WIRED_NONE;
 
-    wired_adapter.input_q_hdl = xRingbufferCreate(64, RINGBUF_TYPE_NOSPLIT);
-    if (wired_adapter.input_q_hdl == NULL) {
-        printf("# %s: Failed to create ring buffer\n", __FUNCTION__);
-    }
+    adapter_curve_init();
+    adapter_diag_init();
+    adapter_fb_init();
 }
@@ -6,6 +6,7 @@
 #ifndef _ADAPTER_H_
 #define _ADAPTER_H_
 
+#include <stddef.h>
 #include <esp_attr.h>
 #include "../zephyr/atomic.h"
 
@@ -19,6 +20,8 @@
 #define BT_MAX_DEV   7 /* BT limitation */
 #define WIRED_MAX_DEV 12 /* Saturn limit */
 #define ADAPTER_MAX_AXES 6
+#define ADAPTER_LATENCY_BUCKETS 64
+#define ADAPTER_LATENCY_BUCKET_US 500
 #define REPORT_MAX_USAGE 16
 
 /* BT device ID */
@@ -253,6 +256,7 @@ enum {
     WIRED_NEW_DATA,
     WIRED_SAVE_MEM,
     WIRED_WAITING_FOR_RELEASE,
+    WIRED_ORIGIN_DONE,
 };
 
 /* Dev mode */
@@ -297,6 +301,8 @@ enum {
     CIRCLE_HEX,
     SQUARE_CIRCLE,
     SQUARE_HEX,
+    CIRCLE_OCTAGON,
+    DIAG_MAX,
 };
 
 struct ctrl_meta {
@@ -364,6 +370,7 @@ struct bt_data {
     uint32_t report_id;
     uint32_t report_cnt;
     int32_t report_type;
+    uint32_t timestamp;
     struct hid_report reports[REPORT_MAX];
     uint8_t input[128];
     int32_t axes_cal[ADAPTER_MAX_AXES];
@@ -381,22 +388,77 @@ struct wired_data {
     int32_t dev_mode;
     int32_t acc_mode;
     uint8_t output[64];
+    /* Published frames, frame_seq LSB select the one wired driver read.
+     * ISR copies use wired_frame_read_begin/retry as a seqlock.
+     */
+    atomic_t frame_seq;
+    /* BT RX time of the report that built a frame, if frame_ts_valid */
+    uint32_t frame_ts[2];
+    uint32_t frame_ts_valid[2];
+    uint8_t frame[2][64];
 } __packed;
 
+/* Packed but used as an array, atomics must stay word aligned in each element */
+_Static_assert(sizeof(struct wired_data) % 4 == 0, "wired_data size not word aligned");
+_Static_assert(offsetof(struct wired_data, flags) % 4 == 0, "wired_data flags not word aligned");
+_Static_assert(offsetof(struct wired_data, frame_seq) % 4 == 0, "wired_data frame_seq not word aligned");
+
+/* Age of input data when first served by wired driver, in us */
+struct wired_latency {
+    uint32_t last_seq;
+    uint32_t cnt;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    uint32_t hist[ADAPTER_LATENCY_BUCKETS];
+};
+
+/* Console frames checked by wired drivers that can repair or drop them */
+struct wired_rx_stats {
+    uint32_t good;
+    uint32_t repaired;
+    uint32_t dropped;
+};
+
+struct adapter_latency_stats {
+    uint32_t cnt;
+    uint32_t min;
+    uint32_t avg;
+    uint32_t p99;
+    uint32_t max;
+};
+
+typedef void (*frame_encode_t)(uint8_t wired_id, uint32_t idx);
+
 struct wired_adapter {
     /* from wired driver */
     int32_t system_id;
     void *input_q_hdl;
+    /* Optional, called on adapter core to encode frame[idx] before it get published */
+    frame_encode_t frame_encode;
     /* from adapter */
     int32_t driver_mode;
     /* Bi-directional */
     struct wired_data data[WIRED_MAX_DEV];
+    /* from wired driver */
+    struct wired_latency latency[WIRED_MAX_DEV];
+    struct wired_rx_stats rx_stats[WIRED_MAX_DEV];
 };
 
 struct bt_adapter {
     struct bt_data data[BT_MAX_DEV];
 };
 
+/* Work avoided by change detection, per BT device type. Readable over BLE
+ * along with each output adapter_latency_get() and wired RX stats.
+ */
+struct adapter_stats {
+    uint32_t reports[BT_MAX];
+    uint32_t input_skip[BT_MAX];
+    uint32_t outputs[BT_MAX];
+    uint32_t output_skip[BT_MAX];
+};
+
 typedef void (*to_generic_t)(struct bt_data *bt_data, struct generic_ctrl *ctrl_data);
 typedef void (*from_generic_t)(int32_t dev_mode, struct generic_ctrl *ctrl_data, struct wired_data *wired_data);
 typedef void (*fb_to_generic_t)(int32_t dev_mode, uint8_t *raw_fb_data, uint32_t raw_fb_len, struct generic_fb *fb_data);
@@ -408,16 +470,42 @@ extern const uint32_t hat_to_ld_btns[16];
 extern const uint32_t generic_btns_mask[32];
 extern struct bt_adapter bt_adapter;
 extern struct wired_adapter wired_adapter;
+extern struct adapter_stats adapter_stats;
+
+/* Last complete frame published by the adapter, for adapter core side reads */
+static inline uint8_t *wired_frame(struct wired_data *wired_data) {
+    return wired_data->frame[atomic_get(&wired_data->frame_seq) & 0x1];
+}
+
+/* Wired ISR copy of frame state: a publish fill the slot of the one before
+ * it, so a copy of slot seq & 1 is only good if frame_seq didn't move.
+ */
+#define WIRED_FRAME_READ_TRY 3
+
+static inline uint32_t wired_frame_read_begin(struct wired_data *wired_data) {
+    return atomic_get(&wired_data->frame_seq);
+}
+
+static inline bool wired_frame_read_retry(struct wired_data *wired_data, uint32_t seq) {
+    return atomic_get(&wired_data->frame_seq) != seq;
+}
 
 uint8_t btn_id_to_axis(uint8_t btn_id);
 uint32_t axis_to_btn_mask(uint8_t axis);
 int8_t btn_sign(uint32_t polarity, uint8_t btn_id);
 void adapter_init_buffer(uint8_t wired_id);
 void adapter_bridge(struct bt_data *bt_data);
+void adapter_config_changed(void);
+void adapter_fb_init(void);
 void adapter_fb_stop_timer_start(uint8_t dev_id, uint64_t dur_us);
 void adapter_fb_stop_timer_stop(uint8_t dev_id);
 uint32_t adapter_bridge_fb(uint8_t *fb_data, uint32_t fb_len, struct bt_data *bt_data);
 void IRAM_ATTR adapter_q_fb(uint8_t *data, uint32_t len);
+void IRAM_ATTR adapter_latency_record(uint8_t wired_id, uint32_t now);
+void adapter_latency_get(uint8_t wired_id, struct adapter_latency_stats *stats);
 void adapter_init(void);
+#ifdef ADAPTER_TEST
+void adapter_test_publish(uint8_t wired_id, struct bt_data *bt_data);
+#endif /* ADAPTER_TEST */
 
 #endif /* _ADAPTER_H_ */
@@ -5,11 +5,14 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
 #include <sys/stat.h>
 #include "adapter.h"
 #include "config.h"
 
+#ifndef CONFIG_FILE
 #define CONFIG_FILE "/sd/config.bin"
+#endif
 
 struct config config;
 
@@ -25,6 +28,7 @@ static void config_init_struct(struct config *data) {
     for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
         data->out_cfg[i].dev_mode = 0x00;
         data->out_cfg[i].acc_mode = 0x00;
+        data->mem_bank[i] = 0x00;
         data->in_cfg[i].bt_dev_id = 0x00;
         data->in_cfg[i].bt_subdev_id = 0x00;
         data->in_cfg[i].map_size = KBM_MAX;
@@ -56,9 +60,18 @@ static int32_t config_load_from_file(struct config *data) {
             printf("%s: failed to open file for reading\n", __FUNCTION__);
         }
         else {
-            fread((void *)data, sizeof(*data), 1, file);
+            size_t size = fread((void *)data, 1, sizeof(*data), file);
             fclose(file);
             ret = 0;
+            if (size < offsetof(struct config, mem_bank)) {
+                /* Truncated, reset below */
+                data->magic = 0;
+            }
+            else if (size < sizeof(*data) && data->magic == CONFIG_MAGIC) {
+                /* Config from before pak banks, keep it with bank 0 */
+                memset(data->mem_bank, 0, sizeof(data->mem_bank));
+                ret = config_store_on_file(data);
+            }
         }
     }
     if (data->magic != CONFIG_MAGIC) { /* TODO use CRC32 */
@@ -86,8 +99,10 @@ static int32_t config_store_on_file(struct config *data) {
 
 void config_init(void) {
     config_load_from_file(&config);
+    adapter_config_changed();
 }
 
 void config_update(void) {
     config_store_on_file(&config);
+    adapter_config_changed();
 }
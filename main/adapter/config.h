@@ -44,6 +44,8 @@ struct config {
     struct global_cfg global_cfg;
     struct out_cfg out_cfg[WIRED_MAX_DEV];
     struct in_cfg in_cfg[WIRED_MAX_DEV];
+    /* Appended, config saved without it load with bank 0 */
+    uint8_t mem_bank[WIRED_MAX_DEV];
 } __packed;
 
 extern struct config config;
@@ -82,7 +82,7 @@ void dc_init_buffer(int32_t dev_mode, struct wired_data *wired_data) {
 }
 
 void dc_meta_init(int32_t dev_mode, struct generic_ctrl *ctrl_data) {
-    memset((void *)ctrl_data, 0, sizeof(*ctrl_data)*4);
+    memset((void *)ctrl_data, 0, sizeof(*ctrl_data)*WIRED_MAX_DEV);
 
     for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
         for (uint32_t j = 0; j < ADAPTER_MAX_AXES; j++) {
@@ -67,13 +67,14 @@ void gc_init_buffer(int32_t dev_mode, struct wired_data *wired_data) {
     struct gc_map *map = (struct gc_map *)wired_data->output;
 
     map->buttons = 0x8020;
+    atomic_clear_bit(&wired_data->flags, WIRED_ORIGIN_DONE);
     for (uint32_t i = 0; i < ADAPTER_MAX_AXES; i++) {
         map->axes[gc_axes_idx[i]] = gc_axes_meta[i].neutral;
     }
 }
 
 void gc_meta_init(int32_t dev_mode, struct generic_ctrl *ctrl_data) {
-    memset((void *)ctrl_data, 0, sizeof(*ctrl_data)*4);
+    memset((void *)ctrl_data, 0, sizeof(*ctrl_data)*WIRED_MAX_DEV);
 
     for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
         for (uint32_t j = 0; j < ADAPTER_MAX_AXES; j++) {
@@ -116,6 +117,11 @@ void gc_from_generic(int32_t dev_mode, struct generic_ctrl *ctrl_data, struct wi
         }
     }
 
+    /* Origin bit cleared by wired driver on published frame */
+    if (atomic_test_bit(&wired_data->flags, WIRED_ORIGIN_DONE)) {
+        map_tmp.buttons &= ~0x0020;
+    }
+
     memcpy(wired_data->output, (void *)&map_tmp, sizeof(map_tmp));
 }
 
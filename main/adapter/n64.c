@@ -84,7 +84,7 @@ void n64_init_buffer(int32_t dev_mode, struct wired_data *wired_data) {
 }
 
 void n64_meta_init(int32_t dev_mode, struct generic_ctrl *ctrl_data) {
-    memset((void *)ctrl_data, 0, sizeof(*ctrl_data)*4);
+    memset((void *)ctrl_data, 0, sizeof(*ctrl_data)*WIRED_MAX_DEV);
 
     for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
         for (uint32_t j = 0; j < N64_AXES_MAX; j++) {
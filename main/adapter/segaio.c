@@ -45,14 +45,29 @@ const struct ctrl_meta segaio_axes_meta[ADAPTER_MAX_AXES] =
     {.size_min = 0, .size_max = 255, .neutral = 0x00, .abs_max = 0xFF},
 };
 
+const struct ctrl_meta segaio_mouse_axes_meta[2] =
+{
+    {.size_min = -128, .size_max = 127, .neutral = 0x00, .abs_max = 0x80},
+    {.size_min = -128, .size_max = 127, .neutral = 0x00, .abs_max = 0x80},
+};
+
 struct segaio_map {
     uint16_t buttons;
     uint8_t axes[4];
 } __packed;
 
+/* Motion accumulated since boot, wrap around, wired driver send difference with last read */
+struct segaio_mouse_map {
+    uint8_t buttons;
+    int32_t pos[2];
+} __packed;
+
 const uint32_t segaio_mask[4] = {0xBB1F0F0F, 0x00000000, 0x00000000, 0x00000000};
 const uint32_t segaio_desc[4] = {0x1100000F, 0x00000000, 0x00000000, 0x00000000};
 
+const uint32_t segaio_mouse_mask[4] = {0x191000F0, 0x00000000, 0x00000000, 0x00000000};
+const uint32_t segaio_mouse_desc[4] = {0x000000F0, 0x00000000, 0x00000000, 0x00000000};
+
 const uint32_t segaio_btns_mask[32] = {
     0, 0, 0, 0,
     0, 0, 0, 0,
@@ -64,15 +79,40 @@ const uint32_t segaio_btns_mask[32] = {
     0, BIT(SATURN_C), 0, BIT(SATURN_R),
 };
 
+/* Mega Mouse buttons nibble: Start, Middle, Right, Left */
+const uint32_t segaio_mouse_btns_mask[32] = {
+    0, 0, 0, 0,
+    0, 0, 0, 0,
+    0, 0, 0, 0,
+    0, 0, 0, 0,
+    0, 0, 0, 0,
+    BIT(3), 0, 0, 0,
+    BIT(1), 0, 0, BIT(2),
+    BIT(0), 0, 0, 0,
+};
+
 void segaio_init_buffer(int32_t dev_mode, struct wired_data *wired_data) {
-    struct segaio_map *map = (struct segaio_map *)wired_data->output;
+    switch (dev_mode) {
+        case DEV_MOUSE:
+        {
+            struct segaio_mouse_map *map = (struct segaio_mouse_map *)wired_data->output;
 
-    map->buttons = 0xFFFF;
-    for (uint32_t i = 0; i < ADAPTER_MAX_AXES; i++) {
-        if (i == 2 || i == 3) {
-            continue;
+            memset((void *)map, 0, sizeof(*map));
+            break;
+        }
+        default:
+        {
+            struct segaio_map *map = (struct segaio_map *)wired_data->output;
+
+            map->buttons = 0xFFFF;
+            for (uint32_t i = 0; i < ADAPTER_MAX_AXES; i++) {
+                if (i == 2 || i == 3) {
+                    continue;
+                }
+                map->axes[segaio_axes_idx[i]] = segaio_axes_meta[i].neutral;
+            }
+            break;
         }
-        map->axes[segaio_axes_idx[i]] = segaio_axes_meta[i].neutral;
     }
 }
 
@@ -80,15 +120,59 @@ void segaio_meta_init(int32_t dev_mode, struct generic_ctrl *ctrl_data) {
     memset((void *)ctrl_data, 0, sizeof(*ctrl_data)*WIRED_MAX_DEV);
 
     for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
-        ctrl_data[i].mask = segaio_mask;
-        ctrl_data[i].desc = segaio_desc;
-        for (uint32_t j = 0; j < ADAPTER_MAX_AXES; j++) {
-            ctrl_data[i].axes[j].meta = &segaio_axes_meta[j];
+        switch (dev_mode) {
+            case DEV_MOUSE:
+                ctrl_data[i].mask = segaio_mouse_mask;
+                ctrl_data[i].desc = segaio_mouse_desc;
+                for (uint32_t j = 0; j < ARRAY_SIZE(segaio_mouse_axes_meta); j++) {
+                    ctrl_data[i].axes[j + 2].meta = &segaio_mouse_axes_meta[j];
+                }
+                break;
+            default:
+                ctrl_data[i].mask = segaio_mask;
+                ctrl_data[i].desc = segaio_desc;
+                for (uint32_t j = 0; j < ADAPTER_MAX_AXES; j++) {
+                    ctrl_data[i].axes[j].meta = &segaio_axes_meta[j];
+                }
+                break;
         }
     }
 }
 
-void segaio_from_generic(int32_t dev_mode, struct generic_ctrl *ctrl_data, struct wired_data *wired_data) {
+static void segaio_mouse_from_generic(struct generic_ctrl *ctrl_data, struct wired_data *wired_data) {
+    struct segaio_mouse_map map_tmp;
+
+    memcpy((void *)&map_tmp, wired_data->output, sizeof(map_tmp));
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(generic_btns_mask); i++) {
+        if (ctrl_data->map_mask[0] & generic_btns_mask[i]) {
+            if (ctrl_data->btns[0].value & generic_btns_mask[i]) {
+                map_tmp.buttons |= segaio_mouse_btns_mask[i];
+            }
+            else {
+                map_tmp.buttons &= ~segaio_mouse_btns_mask[i];
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(segaio_mouse_axes_meta); i++) {
+        if (ctrl_data->map_mask[0] & (axis_to_btn_mask(i + 2) & segaio_mouse_desc[0])) {
+            int32_t value = ctrl_data->axes[i + 2].value;
+
+            if (value > ctrl_data->axes[i + 2].meta->size_max) {
+                value = ctrl_data->axes[i + 2].meta->size_max;
+            }
+            else if (value < ctrl_data->axes[i + 2].meta->size_min) {
+                value = ctrl_data->axes[i + 2].meta->size_min;
+            }
+            map_tmp.pos[i] = (int32_t)((uint32_t)map_tmp.pos[i] + (uint32_t)value);
+        }
+    }
+
+    memcpy(wired_data->output, (void *)&map_tmp, sizeof(map_tmp));
+}
+
+static void segaio_ctrl_from_generic(struct generic_ctrl *ctrl_data, struct wired_data *wired_data) {
     struct segaio_map map_tmp;
 
     memcpy((void *)&map_tmp, wired_data->output, sizeof(map_tmp));
@@ -123,3 +207,14 @@ void segaio_from_generic(int32_t dev_mode, struct generic_ctrl *ctrl_data, struc
 
     memcpy(wired_data->output, (void *)&map_tmp, sizeof(map_tmp));
 }
+
+void segaio_from_generic(int32_t dev_mode, struct generic_ctrl *ctrl_data, struct wired_data *wired_data) {
+    switch (dev_mode) {
+        case DEV_MOUSE:
+            segaio_mouse_from_generic(ctrl_data, wired_data);
+            break;
+        default:
+            segaio_ctrl_from_generic(ctrl_data, wired_data);
+            break;
+    }
+}
@@ -40,6 +40,10 @@ enum {
     BR_IN_CFG_CTRL_CHRC_HDL,
     BR_IN_CFG_DATA_ATT_HDL,
     BR_IN_CFG_DATA_CHRC_HDL,
+    BR_STATS_ATT_HDL,
+    BR_STATS_CHRC_HDL,
+    BR_MEM_BANK_ATT_HDL,
+    BR_MEM_BANK_CHRC_HDL,
     MAX_HDL,
 };
 
@@ -51,6 +55,12 @@ static uint8_t power = 0;
 static uint16_t out_ctrl_cfg_id = 0;
 static uint16_t ctrl_offset = 0;
 static uint16_t ctrl_cfg_id = 0;
+/* Stats are copied on 1st read so blob reads return one consistent set */
+static struct {
+    struct adapter_stats adapter;
+    struct adapter_latency_stats latency[WIRED_MAX_DEV];
+    struct wired_rx_stats rx[WIRED_MAX_DEV];
+} __packed stats_snapshot;
 
 static void bt_att_cmd(uint16_t handle, uint8_t code, uint16_t len) {
     uint16_t packet_len = (BT_HCI_H4_HDR_SIZE + BT_HCI_ACL_HDR_SIZE
@@ -203,7 +213,12 @@ static void bt_att_cmd_blueretro_char_read_type_rsp(uint16_t handle, uint16_t st
     else {
         rd_type_rsp->data->handle = start;
     }
-    *data = BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE;
+    if (rd_type_rsp->data->handle == BR_STATS_ATT_HDL) {
+        *data = BT_GATT_CHRC_READ;
+    }
+    else {
+        *data = BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE;
+    }
     data++;
     *(uint16_t *)data = rd_type_rsp->data->handle + 1;
     data += 2;
@@ -295,6 +310,39 @@ static void bt_att_cmd_config_rd_rsp(uint16_t handle, uint8_t config_id, uint16_
     bt_att_cmd(handle, offset ? BT_ATT_OP_READ_BLOB_RSP : BT_ATT_OP_READ_RSP, len);
 }
 
+static void bt_att_cmd_stats_rd_rsp(uint16_t handle, uint16_t offset) {
+    uint32_t len = 0;
+    printf("# %s\n", __FUNCTION__);
+
+    if (offset == 0) {
+        memcpy((void *)&stats_snapshot.adapter, (void *)&adapter_stats, sizeof(stats_snapshot.adapter));
+        for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
+            adapter_latency_get(i, &stats_snapshot.latency[i]);
+        }
+        memcpy((void *)stats_snapshot.rx, (void *)wired_adapter.rx_stats, sizeof(stats_snapshot.rx));
+    }
+
+    if (offset < sizeof(stats_snapshot)) {
+        len = sizeof(stats_snapshot) - offset;
+
+        if (len > (mtu - 1)) {
+            len = mtu - 1;
+        }
+
+        memcpy(bt_hci_pkt_tmp.att_data, (void *)&stats_snapshot + offset, len);
+    }
+
+    bt_att_cmd(handle, offset ? BT_ATT_OP_READ_BLOB_RSP : BT_ATT_OP_READ_RSP, len);
+}
+
+static void bt_att_cmd_mem_bank_rd_rsp(uint16_t handle) {
+    printf("# %s\n", __FUNCTION__);
+
+    *bt_hci_pkt_tmp.att_data = config.mem_bank[out_ctrl_cfg_id];
+
+    bt_att_cmd(handle, BT_ATT_OP_READ_RSP, sizeof(uint8_t));
+}
+
 static void bt_att_cmd_conf_rd_rsp(uint16_t handle) {
     printf("# %s\n", __FUNCTION__);
 
@@ -339,9 +387,9 @@ static void bt_att_cmd_read_group_rsp(uint16_t handle, uint16_t start, uint16_t
     else {
         rd_grp_rsp->len = 20;
 
-        if (start <= BR_GRP_HDL && end >= BR_IN_CFG_DATA_CHRC_HDL) {
+        if (start <= BR_GRP_HDL && end >= BR_MEM_BANK_CHRC_HDL) {
             gatt_data->start_handle = BR_GRP_HDL;
-            gatt_data->end_handle = BR_IN_CFG_DATA_CHRC_HDL;
+            gatt_data->end_handle = BR_MEM_BANK_CHRC_HDL;
             memcpy(gatt_data->value, br_grp_base_uuid, sizeof(br_grp_base_uuid));
             len += rd_grp_rsp->len;
         }
@@ -429,7 +477,7 @@ void bt_att_hdlr(struct bt_dev *device, struct bt_hci_pkt *bt_hci_acl_pkt, uint3
                     bt_att_cmd_batt_char_read_type_rsp(device->acl_handle);
                 }
                 /* BLUERETRO */
-                else if (start >= BATT_CHRC_HDL && start < BR_IN_CFG_DATA_CHRC_HDL && end >= BR_IN_CFG_DATA_CHRC_HDL) {
+                else if (start >= BATT_CHRC_HDL && start < BR_MEM_BANK_CHRC_HDL && end >= BR_MEM_BANK_CHRC_HDL) {
                     bt_att_cmd_blueretro_char_read_type_rsp(device->acl_handle, start);
                 }
                 else {
@@ -470,6 +518,12 @@ void bt_att_hdlr(struct bt_dev *device, struct bt_hci_pkt *bt_hci_acl_pkt, uint3
                 case BR_IN_CFG_DATA_CHRC_HDL:
                     bt_att_cmd_config_rd_rsp(device->acl_handle, (rd_req->handle - BR_GLBL_CFG_CHRC_HDL) / 2, 0);
                     break;
+                case BR_STATS_CHRC_HDL:
+                    bt_att_cmd_stats_rd_rsp(device->acl_handle, 0);
+                    break;
+                case BR_MEM_BANK_CHRC_HDL:
+                    bt_att_cmd_mem_bank_rd_rsp(device->acl_handle);
+                    break;
                 default:
                     bt_att_cmd_error_rsp(device->acl_handle, BT_ATT_OP_READ_REQ, rd_req->handle, BT_ATT_ERR_INVALID_HANDLE);
                     break;
@@ -489,6 +543,9 @@ void bt_att_hdlr(struct bt_dev *device, struct bt_hci_pkt *bt_hci_acl_pkt, uint3
                 case BR_IN_CFG_DATA_CHRC_HDL:
                     bt_att_cmd_config_rd_rsp(device->acl_handle, (rd_blob_req->handle - BR_GLBL_CFG_CHRC_HDL)/2, rd_blob_req->offset);
                     break;
+                case BR_STATS_CHRC_HDL:
+                    bt_att_cmd_stats_rd_rsp(device->acl_handle, rd_blob_req->offset);
+                    break;
                 default:
                     bt_att_cmd_error_rsp(device->acl_handle, BT_ATT_OP_READ_BLOB_REQ, rd_blob_req->handle, BT_ATT_ERR_INVALID_HANDLE);
                     break;
@@ -511,6 +568,7 @@ void bt_att_hdlr(struct bt_dev *device, struct bt_hci_pkt *bt_hci_acl_pkt, uint3
         {
             struct bt_att_write_req *wr_req = (struct bt_att_write_req *)bt_hci_acl_pkt->att_data;
             uint16_t *data = (uint16_t *)wr_req->value;
+            uint32_t data_len = len - (BT_HCI_H4_HDR_SIZE + BT_HCI_ACL_HDR_SIZE + sizeof(struct bt_l2cap_hdr) + sizeof(struct bt_att_hdr) + sizeof(wr_req->handle));
             printf("# BT_ATT_OP_WRITE_REQ\n");
             switch (wr_req->handle) {
                 case BR_GLBL_CFG_CHRC_HDL:
@@ -520,10 +578,21 @@ void bt_att_hdlr(struct bt_dev *device, struct bt_hci_pkt *bt_hci_acl_pkt, uint3
                     bt_att_cmd_wr_rsp(device->acl_handle);
                     break;
                 case BR_OUT_CFG_DATA_CHRC_HDL:
-                    memcpy((void *)&config.out_cfg[out_ctrl_cfg_id], wr_req->value, sizeof(config.out_cfg[0]));
+                    /* Short write only update leading fields */
+                    if (data_len > sizeof(config.out_cfg[0])) {
+                        data_len = sizeof(config.out_cfg[0]);
+                    }
+                    memcpy((void *)&config.out_cfg[out_ctrl_cfg_id], wr_req->value, data_len);
                     config_update();
                     bt_att_cmd_wr_rsp(device->acl_handle);
                     break;
+                case BR_MEM_BANK_CHRC_HDL:
+                    if (data_len) {
+                        config.mem_bank[out_ctrl_cfg_id] = *wr_req->value;
+                        config_update();
+                    }
+                    bt_att_cmd_wr_rsp(device->acl_handle);
+                    break;
                 case BR_IN_CFG_DATA_CHRC_HDL:
                     memcpy((void *)&config.in_cfg[ctrl_cfg_id], wr_req->value, sizeof(config.in_cfg[0]));
                     config_update();
@@ -4,6 +4,7 @@
  */
 
 #include "host.h"
+#include "../trace.h"
 #include "hidp_generic.h"
 #include "hidp_ps3.h"
 #include "hidp_wii.h"
@@ -66,6 +67,7 @@ void bt_hid_init(struct bt_dev *device) {
 
 void bt_hid_hdlr(struct bt_dev *device, struct bt_hci_pkt *bt_hci_acl_pkt) {
     if (device->type > BT_NONE && bt_hid_hdlr_list[device->type]) {
+        TRACE(TRACE_HIDP, device->type);
         bt_hid_hdlr_list[device->type](device, bt_hci_acl_pkt);
     }
 }
@@ -91,5 +93,5 @@ void bt_hid_cmd(uint16_t handle, uint16_t cid, uint8_t hidp_hdr, uint8_t protoco
     bt_hci_pkt_tmp.hidp_hdr.hdr = hidp_hdr;
     bt_hci_pkt_tmp.hidp_hdr.protocol = protocol;
 
-    bt_host_txq_add((uint8_t *)&bt_hci_pkt_tmp, packet_len);
+    bt_host_txq_add_hid((uint8_t *)&bt_hci_pkt_tmp, packet_len);
 }
@@ -10,6 +10,7 @@
 #include <freertos/ringbuf.h>
 #include <esp_system.h>
 #include <esp_bt.h>
+#include <esp_timer.h>
 #include <nvs_flash.h>
 #include <driver/gpio.h>
 #include "host.h"
@@ -18,20 +19,52 @@
 #include "sdp.h"
 #include "att.h"
 #include "../util.h"
+#include "../trace.h"
 
 //#define H4_TRACE /* Display packet dump that can be parsed by wireshark/text2pcap */
 
 #define BT_TX 0
 #define BT_RX 1
 #define BT_DEV_MAX 7
+/* ACL in flight tracked per device, BLE config interface last */
+#define BT_ACL_SLOT_MAX (BT_DEV_MAX + 1)
 
+#ifndef LINK_KEYS_FILE
 #define LINK_KEYS_FILE "/sd/linkkeys.bin"
+#endif
 #define BDADDR_FILE "/sd/bdaddr.bin"
 
 enum {
     /* BT CTRL flags */
     BT_CTRL_READY,
     BT_HOST_DISCONN_SW_INHIBIT,
+    /* ACL credits known from Read Buffer Size */
+    BT_CTRL_ACL_FLOW,
+    /* LE ACL got its own buffers, otherwise share BR/EDR ones */
+    BT_CTRL_LE_ACL_FLOW,
+};
+
+/* TX queues in priority order */
+enum {
+    BT_TXQ_HID = 0,
+    BT_TXQ_BULK,
+    BT_TXQ_MAX,
+};
+
+enum {
+    BT_ACL_POOL_BREDR = 0,
+    BT_ACL_POOL_LE,
+    BT_ACL_POOL_MAX,
+};
+
+struct bt_host_txq {
+    RingbufHandle_t hdl;
+    /* Head packet received but not yet sent */
+    uint8_t *pkt;
+    size_t len;
+    /* Held by an internal wait packet until wait_end */
+    uint32_t wait;
+    TickType_t wait_end;
 };
 
 struct bt_host_link_keys {
@@ -42,13 +75,18 @@ struct bt_host_link_keys {
 struct bt_hci_pkt bt_hci_pkt_tmp;
 
 static struct bt_host_link_keys bt_host_link_keys = {0};
-static RingbufHandle_t txq_hdl;
+static struct bt_host_txq txq[BT_TXQ_MAX] = {0};
+static TaskHandle_t bt_tx_task_hdl = NULL;
+static atomic_t cmd_credits = ATOMIC_INIT(1);
+static atomic_t acl_credits[BT_ACL_POOL_MAX] = {0};
+static atomic_t acl_inflight[BT_ACL_SLOT_MAX] = {0};
 static struct bt_dev bt_dev_conf = {0};
 static struct bt_dev bt_dev[BT_DEV_MAX] = {0};
 static atomic_t bt_flags = 0;
 static uint32_t frag_size = 0;
 static uint32_t frag_offset = 0;
 static uint8_t frag_buf[1024];
+static uint32_t bt_host_rx_ts;
 static esp_timer_handle_t disconn_sw_timer_hdl;
 
 #ifdef H4_TRACE
@@ -162,29 +200,225 @@ static int32_t bt_host_store_keys_on_file(struct bt_host_link_keys *data) {
     return ret;
 }
 
-static void bt_tx_task(void *param) {
-    size_t packet_len;
-    uint8_t *packet;
+/* Return device slot using handle, -1 if none */
+static int32_t bt_host_acl_slot(uint16_t handle) {
+    struct bt_dev *device = NULL;
+    int32_t slot = bt_host_get_dev_from_handle(handle, &device);
 
-    while(1) {
-        /* TX packet from Q */
-        if (atomic_test_bit(&bt_flags, BT_CTRL_READY)) {
-            packet = (uint8_t *)xRingbufferReceive(txq_hdl, &packet_len, portMAX_DELAY);
-            if (packet) {
-                if (packet[0] == 0xFF) {
-                    /* Internal wait packet */
-                    vTaskDelay(packet[1] / portTICK_PERIOD_MS);
+    if (slot < 0 && atomic_test_bit(&bt_dev_conf.flags, BT_DEV_DEVICE_FOUND)
+        && bt_acl_handle(handle) == bt_dev_conf.acl_handle) {
+        slot = BT_DEV_MAX;
+    }
+    return slot;
+}
+
+static uint32_t bt_host_acl_pool(int32_t slot) {
+    if (slot == BT_DEV_MAX && atomic_test_bit(&bt_flags, BT_CTRL_LE_ACL_FLOW)) {
+        return BT_ACL_POOL_LE;
+    }
+    return BT_ACL_POOL_BREDR;
+}
+
+/* Packets without a slot never took a credit, nothing to return */
+static void bt_host_acl_completed(int32_t slot, uint32_t count) {
+    if (slot < 0) {
+        return;
+    }
+    atomic_sub(&acl_inflight[slot], MIN(atomic_get(&acl_inflight[slot]), count));
+    if (atomic_test_bit(&bt_flags, BT_CTRL_ACL_FLOW)) {
+        atomic_add(&acl_credits[bt_host_acl_pool(slot)], count);
+    }
+}
+
+/* Update credits from events before they reach HCI handler */
+static void bt_host_flow_evt(struct bt_hci_pkt *bt_hci_evt_pkt) {
+    switch (bt_hci_evt_pkt->evt_hdr.evt) {
+        case BT_HCI_EVT_CMD_COMPLETE:
+        {
+            struct bt_hci_evt_cmd_complete *cmd_complete = (struct bt_hci_evt_cmd_complete *)bt_hci_evt_pkt->evt_data;
+            uint8_t *rp = &bt_hci_evt_pkt->evt_data[sizeof(*cmd_complete)];
+
+            atomic_set(&cmd_credits, cmd_complete->ncmd);
+            switch (cmd_complete->opcode) {
+                case BT_HCI_OP_RESET:
+                    /* Controller flushed its buffers */
+                    atomic_clear_bit(&bt_flags, BT_CTRL_ACL_FLOW);
+                    atomic_clear_bit(&bt_flags, BT_CTRL_LE_ACL_FLOW);
+                    for (uint32_t i = 0; i < BT_ACL_SLOT_MAX; i++) {
+                        atomic_set(&acl_inflight[i], 0);
+                    }
+                    break;
+                case BT_HCI_OP_READ_BUFFER_SIZE:
+                {
+                    struct bt_hci_rp_read_buffer_size *read_buffer_size = (struct bt_hci_rp_read_buffer_size *)rp;
+
+                    if (read_buffer_size->status == BT_HCI_ERR_SUCCESS && read_buffer_size->acl_max_num) {
+                        atomic_set(&acl_credits[BT_ACL_POOL_BREDR], read_buffer_size->acl_max_num);
+                        atomic_set_bit(&bt_flags, BT_CTRL_ACL_FLOW);
+                        printf("# %s ACL credits: %d\n", __FUNCTION__, read_buffer_size->acl_max_num);
+                    }
+                    break;
                 }
-                else {
-#ifdef H4_TRACE
-                    bt_h4_trace(packet, packet_len, BT_TX);
-#endif /* H4_TRACE */
-                    atomic_clear_bit(&bt_flags, BT_CTRL_READY);
-                    esp_vhci_host_send_packet(packet, packet_len);
+                case BT_HCI_OP_LE_READ_BUFFER_SIZE:
+                {
+                    struct bt_hci_rp_le_read_buffer_size *le_read_buffer_size = (struct bt_hci_rp_le_read_buffer_size *)rp;
+
+                    if (le_read_buffer_size->status == BT_HCI_ERR_SUCCESS && le_read_buffer_size->le_max_num) {
+                        atomic_set(&acl_credits[BT_ACL_POOL_LE], le_read_buffer_size->le_max_num);
+                        atomic_set_bit(&bt_flags, BT_CTRL_LE_ACL_FLOW);
+                        printf("# %s LE ACL credits: %d\n", __FUNCTION__, le_read_buffer_size->le_max_num);
+                    }
+                    break;
                 }
-                vRingbufferReturnItem(txq_hdl, (void *)packet);
             }
+            break;
+        }
+        case BT_HCI_EVT_CMD_STATUS:
+        {
+            struct bt_hci_evt_cmd_status *cmd_status = (struct bt_hci_evt_cmd_status *)bt_hci_evt_pkt->evt_data;
+
+            atomic_set(&cmd_credits, cmd_status->ncmd);
+            break;
+        }
+        case BT_HCI_EVT_NUM_COMPLETED_PACKETS:
+        {
+            struct bt_hci_evt_num_completed_packets *num_completed_packets = (struct bt_hci_evt_num_completed_packets *)bt_hci_evt_pkt->evt_data;
+
+            for (uint32_t i = 0; i < num_completed_packets->num_handles; i++) {
+                bt_host_acl_completed(bt_host_acl_slot(num_completed_packets->h[i].handle),
+                    num_completed_packets->h[i].count);
+            }
+            break;
+        }
+        case BT_HCI_EVT_DISCONN_COMPLETE:
+        {
+            struct bt_hci_evt_disconn_complete *disconn_complete = (struct bt_hci_evt_disconn_complete *)bt_hci_evt_pkt->evt_data;
+            int32_t slot = bt_host_acl_slot(disconn_complete->handle);
+
+            /* Packets still in flight are flushed without Number Of Completed Packets */
+            if (disconn_complete->status == BT_HCI_ERR_SUCCESS && slot >= 0) {
+                bt_host_acl_completed(slot, atomic_get(&acl_inflight[slot]));
+            }
+            break;
+        }
+        default:
+            return;
+    }
+    if (bt_tx_task_hdl) {
+        xTaskNotifyGive(bt_tx_task_hdl);
+    }
+}
+
+/* Return queue head skipping internal wait packets, NULL if empty or waiting */
+static uint8_t *bt_host_txq_head(struct bt_host_txq *q, TickType_t *timeout) {
+    while (1) {
+        if (q->wait) {
+            TickType_t left = q->wait_end - xTaskGetTickCount();
+
+            if ((int32_t)left > 0) {
+                *timeout = MIN(*timeout, left);
+                return NULL;
+            }
+            q->wait = 0;
+        }
+        if (q->pkt == NULL) {
+            q->pkt = (uint8_t *)xRingbufferReceive(q->hdl, &q->len, 0);
+            if (q->pkt == NULL) {
+                return NULL;
+            }
+        }
+        if (q->pkt[0] != 0xFF) {
+            return q->pkt;
         }
+        /* Internal wait packet, only hold this queue */
+        q->wait = 1;
+        q->wait_end = xTaskGetTickCount() + q->pkt[1] / portTICK_PERIOD_MS;
+        vRingbufferReturnItem(q->hdl, (void *)q->pkt);
+        q->pkt = NULL;
+    }
+}
+
+static uint32_t bt_host_tx_credit_avail(uint8_t *packet) {
+    struct bt_hci_pkt *pkt = (struct bt_hci_pkt *)packet;
+
+    switch (pkt->h4_hdr.type) {
+        case BT_HCI_H4_TYPE_CMD:
+            return atomic_get(&cmd_credits) > 0;
+        case BT_HCI_H4_TYPE_ACL:
+        {
+            int32_t slot = bt_host_acl_slot(pkt->acl_hdr.handle);
+
+            /* Unknown handle can't be returned on disconnect, send it unaccounted */
+            if (!atomic_test_bit(&bt_flags, BT_CTRL_ACL_FLOW) || slot < 0) {
+                return 1;
+            }
+            return atomic_get(&acl_credits[bt_host_acl_pool(slot)]) > 0;
+        }
+        default:
+            return 1;
+    }
+}
+
+static void bt_host_tx_credit_take(uint8_t *packet) {
+    struct bt_hci_pkt *pkt = (struct bt_hci_pkt *)packet;
+
+    switch (pkt->h4_hdr.type) {
+        case BT_HCI_H4_TYPE_CMD:
+            atomic_dec(&cmd_credits);
+            break;
+        case BT_HCI_H4_TYPE_ACL:
+        {
+            int32_t slot = bt_host_acl_slot(pkt->acl_hdr.handle);
+
+            if (slot < 0) {
+                break;
+            }
+            atomic_inc(&acl_inflight[slot]);
+            if (atomic_test_bit(&bt_flags, BT_CTRL_ACL_FLOW)) {
+                atomic_dec(&acl_credits[bt_host_acl_pool(slot)]);
+            }
+            break;
+        }
+    }
+}
+
+/* Send as many packets as controller & credits allow, return time until a queue wait end */
+static TickType_t bt_host_tx_sched(void) {
+    TickType_t timeout = portMAX_DELAY;
+
+    while (atomic_test_bit(&bt_flags, BT_CTRL_READY)) {
+        struct bt_host_txq *q = NULL;
+
+        for (uint32_t i = 0; i < BT_TXQ_MAX; i++) {
+            uint8_t *packet = bt_host_txq_head(&txq[i], &timeout);
+
+            if (packet && bt_host_tx_credit_avail(packet)) {
+                q = &txq[i];
+                break;
+            }
+        }
+        if (q == NULL) {
+            break;
+        }
+#ifdef H4_TRACE
+        bt_h4_trace(q->pkt, q->len, BT_TX);
+#endif /* H4_TRACE */
+        bt_host_tx_credit_take(q->pkt);
+        atomic_clear_bit(&bt_flags, BT_CTRL_READY);
+        esp_vhci_host_send_packet(q->pkt, q->len);
+        vRingbufferReturnItem(q->hdl, (void *)q->pkt);
+        q->pkt = NULL;
+    }
+    return timeout;
+}
+
+static void bt_tx_task(void *param) {
+    TickType_t timeout = portMAX_DELAY;
+
+    while(1) {
+        /* Woken by new packet, controller ready or credits returned */
+        ulTaskNotifyTake(pdTRUE, timeout);
+        timeout = bt_host_tx_sched();
     }
 }
 
@@ -198,6 +432,7 @@ static void bt_fb_task(void *param) {
         if (fb_data) {
             struct bt_dev *device = &bt_dev[fb_data[0]];
             if (adapter_bridge_fb(fb_data, fb_len, &bt_adapter.data[device->id])) {
+                TRACE(TRACE_FB_TX, device->id);
                 bt_hid_feedback(device, bt_adapter.data[device->id].output);
             }
             vRingbufferReturnItem(wired_adapter.input_q_hdl, (void *)fb_data);
@@ -250,6 +485,7 @@ static void bt_host_acl_hdlr(struct bt_hci_pkt *bt_hci_acl_pkt, uint32_t len) {
     struct bt_dev *device = NULL;
     struct bt_hci_pkt *pkt = bt_hci_acl_pkt;
     uint32_t pkt_len = len;
+    TRACE(TRACE_ACL_RX, len);
     bt_host_get_dev_from_handle(pkt->acl_hdr.handle, &device);
 
     if (bt_acl_flags(pkt->acl_hdr.handle) == BT_ACL_CONT) {
@@ -302,6 +538,9 @@ static void bt_host_acl_hdlr(struct bt_hci_pkt *bt_hci_acl_pkt, uint32_t len) {
  */
 static void bt_host_tx_pkt_ready(void) {
     atomic_set_bit(&bt_flags, BT_CTRL_READY);
+    if (bt_tx_task_hdl) {
+        xTaskNotifyGive(bt_tx_task_hdl);
+    }
 }
 
 /*
@@ -310,6 +549,8 @@ static void bt_host_tx_pkt_ready(void) {
  */
 static int bt_host_rx_pkt(uint8_t *data, uint16_t len) {
     struct bt_hci_pkt *bt_hci_pkt = (struct bt_hci_pkt *)data;
+
+    bt_host_rx_ts = esp_timer_get_time();
 #ifdef H4_TRACE
     bt_h4_trace(data, len, BT_RX);
 #endif /* H4_TRACE */
@@ -319,6 +560,7 @@ static int bt_host_rx_pkt(uint8_t *data, uint16_t len) {
             bt_host_acl_hdlr(bt_hci_pkt, len);
             break;
         case BT_HCI_H4_TYPE_EVT:
+            bt_host_flow_evt(bt_hci_pkt);
             bt_hci_evt_hdlr(bt_hci_pkt);
             break;
         default:
@@ -422,8 +664,9 @@ int32_t bt_host_init(void) {
 
     bt_host_tx_pkt_ready();
 
-    txq_hdl = xRingbufferCreate(256*8, RINGBUF_TYPE_NOSPLIT);
-    if (txq_hdl == NULL) {
+    txq[BT_TXQ_HID].hdl = xRingbufferCreate(256*4, RINGBUF_TYPE_NOSPLIT);
+    txq[BT_TXQ_BULK].hdl = xRingbufferCreate(256*8, RINGBUF_TYPE_NOSPLIT);
+    if (txq[BT_TXQ_HID].hdl == NULL || txq[BT_TXQ_BULK].hdl == NULL) {
         printf("Failed to create ring buffer\n");
         return ret;
     }
@@ -432,21 +675,32 @@ int32_t bt_host_init(void) {
 
     xTaskCreatePinnedToCore(&bt_host_task, "bt_host_task", 4096, NULL, 5, NULL, 0);
     xTaskCreatePinnedToCore(&bt_fb_task, "bt_fb_task", 2048, NULL, 10, NULL, 0);
-    xTaskCreatePinnedToCore(&bt_tx_task, "bt_tx_task", 2048, NULL, 11, NULL, 0);
+    xTaskCreatePinnedToCore(&bt_tx_task, "bt_tx_task", 2048, NULL, 11, &bt_tx_task_hdl, 0);
 
     bt_hci_init();
 
     return ret;
 }
 
-int32_t bt_host_txq_add(uint8_t *packet, uint32_t packet_len) {
-    UBaseType_t ret = xRingbufferSend(txq_hdl, (void *)packet, packet_len, 0);
+static int32_t bt_host_txq_send(struct bt_host_txq *q, uint8_t *packet, uint32_t packet_len) {
+    UBaseType_t ret = xRingbufferSend(q->hdl, (void *)packet, packet_len, 0);
     if (ret != pdTRUE) {
         printf("# %s txq full!\n", __FUNCTION__);
     }
+    else if (bt_tx_task_hdl) {
+        xTaskNotifyGive(bt_tx_task_hdl);
+    }
     return (ret == pdTRUE ? 0 : -1);
 }
 
+int32_t bt_host_txq_add(uint8_t *packet, uint32_t packet_len) {
+    return bt_host_txq_send(&txq[BT_TXQ_BULK], packet, packet_len);
+}
+
+int32_t bt_host_txq_add_hid(uint8_t *packet, uint32_t packet_len) {
+    return bt_host_txq_send(&txq[BT_TXQ_HID], packet, packet_len);
+}
+
 int32_t bt_host_load_link_key(struct bt_hci_cp_link_key_reply *link_key_reply) {
     int32_t ret = -1;
     for (uint32_t i = 0; i < ARRAY_SIZE(bt_host_link_keys.link_keys); i++) {
@@ -493,6 +747,7 @@ void bt_host_bridge(struct bt_dev *device, uint8_t report_id, uint8_t *data, uin
         bt_adapter.data[device->id].report_id = report_id;
         bt_adapter.data[device->id].dev_id = device->id;
         bt_adapter.data[device->id].dev_type = device->type;
+        bt_adapter.data[device->id].timestamp = bt_host_rx_ts;
         memcpy(bt_adapter.data[device->id].input, data, len);
         adapter_bridge(&bt_adapter.data[device->id]);
     }
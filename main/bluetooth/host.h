@@ -97,6 +97,8 @@ void bt_host_reset_dev(struct bt_dev *device);
 void bt_host_q_wait_pkt(uint32_t ms);
 int32_t bt_host_init(void);
 int32_t bt_host_txq_add(uint8_t *packet, uint32_t packet_len);
+/* HID channels traffic (rumble, LED, ...) sent ahead of bulk SDP/ATT/L2CAP */
+int32_t bt_host_txq_add_hid(uint8_t *packet, uint32_t packet_len);
 int32_t bt_host_load_link_key(struct bt_hci_cp_link_key_reply *link_key_reply);
 int32_t bt_host_store_link_key(struct bt_hci_evt_link_key_notify *link_key_notify);
 void bt_host_bridge(struct bt_dev *device, uint8_t report_id, uint8_t *data, uint32_t len);
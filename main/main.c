@@ -10,6 +10,7 @@
 #include "drivers/led.h"
 #include "adapter/adapter.h"
 #include "adapter/config.h"
+#include "trace.h"
 #include "bluetooth/host.h"
 #include "wired/detect.h"
 #include "wired/npiso.h"
@@ -98,7 +99,7 @@ static void wired_init_task(void *arg) {
         printf("# Config override system : %d: %s\n", wired_adapter.system_id, sys_name[wired_adapter.system_id]);
     }
 
-    for (uint32_t i = 0; i < WIRED_MAX; i++) {
+    for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
         adapter_init_buffer(i);
     }
 
@@ -117,6 +118,7 @@ static void wl_init_task(void *arg) {
     }
 
     config_init();
+    trace_init();
 
     if (bt_host_init()) {
         err_led_set();
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "trace.h"
+
+#ifdef TRACE_ENABLE
+#include <stdio.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <xtensa/hal.h>
+#include <esp_attr.h>
+#include "zephyr/atomic.h"
+
+#define TRACE_CORE_MAX 2
+#define TRACE_RING_SIZE 1024 /* Power of 2 */
+
+struct trace_ring {
+    atomic_t head;
+    uint32_t tail;
+    uint32_t lost;
+    struct trace_rec recs[TRACE_RING_SIZE];
+};
+
+static struct trace_ring trace_rings[TRACE_CORE_MAX];
+static struct trace_rec trace_buf[TRACE_RING_SIZE];
+
+void IRAM_ATTR trace_event(uint32_t evt, uint32_t arg) {
+    struct trace_ring *ring = &trace_rings[xPortGetCoreID()];
+    /* Slot reservation is atomic so ISR can preempt a task mid record */
+    uint32_t pos = (uint32_t)atomic_inc(&ring->head);
+    struct trace_rec *rec = &ring->recs[pos & (TRACE_RING_SIZE - 1)];
+
+    /* seq is cleared first and set last, drain task only take a record
+     * whose seq match its ring position before and after the copy.
+     */
+    atomic_set((atomic_t *)&rec->seq, 0);
+    rec->ccount = xthal_get_ccount();
+    rec->evt = evt;
+    rec->arg = arg;
+    atomic_set((atomic_t *)&rec->seq, pos + 1);
+}
+
+static uint32_t trace_ring_drain(struct trace_ring *ring) {
+    uint32_t head = atomic_get(&ring->head);
+    uint32_t cnt = 0;
+
+    if (head - ring->tail > TRACE_RING_SIZE) {
+        ring->lost += head - ring->tail - TRACE_RING_SIZE;
+        ring->tail = head - TRACE_RING_SIZE;
+    }
+    while (ring->tail != head) {
+        struct trace_rec *rec = &ring->recs[ring->tail & (TRACE_RING_SIZE - 1)];
+        uint32_t seq = ring->tail + 1;
+        uint32_t rec_seq = atomic_get((atomic_t *)&rec->seq);
+
+        if (rec_seq != seq) {
+            if (rec_seq == 0 || (int32_t)(rec_seq - seq) < 0) {
+                /* Writer not done yet, pick it up next time */
+                break;
+            }
+            /* Writer lapped the ring, record is gone */
+            ring->lost++;
+            ring->tail++;
+            continue;
+        }
+        trace_buf[cnt] = *rec;
+        if (atomic_get((atomic_t *)&rec->seq) != seq) {
+            /* Overwritten while copying */
+            ring->lost++;
+            ring->tail++;
+            continue;
+        }
+        cnt++;
+        ring->tail++;
+    }
+    return cnt;
+}
+
+static void trace_task(void *arg) {
+    struct trace_blk_hdr hdr = {.magic = TRACE_MAGIC};
+    FILE *file = fopen(TRACE_FILE, "wb");
+
+    if (file == NULL) {
+        printf("# %s: failed to open file\n", __FUNCTION__);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    while (1) {
+        for (uint32_t i = 0; i < TRACE_CORE_MAX; i++) {
+            hdr.core = i;
+            hdr.cnt = trace_ring_drain(&trace_rings[i]);
+            hdr.lost = trace_rings[i].lost;
+            if (hdr.cnt) {
+                fwrite((void *)&hdr, sizeof(hdr), 1, file);
+                fwrite((void *)trace_buf, sizeof(trace_buf[0]), hdr.cnt, file);
+            }
+        }
+        fflush(file);
+        vTaskDelay(100 / portTICK_PERIOD_MS);
+    }
+}
+
+void trace_init(void) {
+    xTaskCreatePinnedToCore(&trace_task, "trace_task", 2048, NULL, 1, NULL, 0);
+}
+#endif /* TRACE_ENABLE */
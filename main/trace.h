@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+
+//#define TRACE_ENABLE
+
+/* Trace file is a sequence of blocks, all fields little endian:
+ * struct trace_blk_hdr followed by cnt struct trace_rec.
+ * test/host trace_dump turn it into a timeline.
+ */
+#define TRACE_FILE "/sd/trace.bin"
+#define TRACE_MAGIC 0x45435254 /* "TRCE" */
+
+enum {
+    TRACE_ACL_RX = 0,
+    TRACE_HIDP,
+    TRACE_TO_GENERIC,
+    TRACE_MAPPING,
+    TRACE_FROM_GENERIC,
+    TRACE_FB_TX,
+    TRACE_ISR_ENTRY,
+    TRACE_ISR_EXIT,
+    TRACE_EVT_MAX,
+};
+
+struct trace_blk_hdr {
+    uint32_t magic;
+    uint16_t core;
+    uint16_t cnt;
+    uint32_t lost;
+};
+
+struct trace_rec {
+    uint32_t seq; /* Position in core ring + 1, gaps are lost records */
+    uint32_t ccount;
+    uint16_t evt;
+    uint16_t arg;
+};
+
+#ifdef TRACE_ENABLE
+#define TRACE(evt, arg) trace_event((evt), (arg))
+
+void trace_event(uint32_t evt, uint32_t arg);
+void trace_init(void);
+#else
+#define TRACE(evt, arg)
+#define trace_init()
+#endif /* TRACE_ENABLE */
+
+#endif /* _TRACE_H_ */
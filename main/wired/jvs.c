@@ -11,6 +11,7 @@
 #include <esp32/rom/ets_sys.h>
 #include <esp32/clk.h>
 #include "../zephyr/types.h"
+#include "../zephyr/atomic.h"
 #include "../util.h"
 #include "../adapter/adapter.h"
 #include "../adapter/config.h"
@@ -34,9 +35,96 @@
 #define D0BYTE 0xCF
 #define BCAST 0xFF
 
+/* Request or reply payload, dest up to last report */
+#define JVS_BUF_MAX 128
+/* SYNC, worst case all escaped payload & checksum */
+#define JVS_FRAME_MAX (1 + 2 * (JVS_BUF_MAX + 1))
+/* Input polls cached, usually a single shape per game */
+#define JVS_CACHE_MAX 4
+#define JVS_CACHE_REQ_MAX 16
+
+enum {
+    JVS_SPEED_115200 = 0,
+    JVS_SPEED_1M,
+    JVS_SPEED_3M,
+    JVS_SPEED_MAX,
+};
+
+enum {
+    JVS_STATIC_INFO = 0,
+    JVS_STATIC_CMD_REV,
+    JVS_STATIC_JVS_REV,
+    JVS_STATIC_COMM_REV,
+    JVS_STATIC_FEATURE,
+    JVS_STATIC_MAX,
+};
+
+/* Escaped frame ready for TX FIFO, SYNC up to checksum */
+struct jvs_frame {
+    uint32_t len;
+    uint8_t data[JVS_FRAME_MAX];
+};
+
+/* Reply to an input poll (0x20 - 0x22 only), rebuilt on each wired frame publish */
+struct jvs_cache {
+    uint8_t req[JVS_CACHE_REQ_MAX];
+    uint32_t req_len;
+    /* Players & channels pairs polled, skip rebuild for others */
+    uint32_t dev_cnt;
+    atomic_t seq;
+    struct jvs_frame frames[2];
+};
+
+struct jvs_speed {
+    uint32_t baudrate;
+    /* RTS lead before 1st byte, about a bit time */
+    uint32_t turnaround_us;
+};
+
+static const struct jvs_speed jvs_speeds[JVS_SPEED_MAX] = {
+    {115200, 10},
+    {1000000, 1},
+    {3000000, 1},
+};
+
 static const uint8_t ident_str[] = "BlueRetro;JVS;ver1.0 ";
-static uint8_t rx_buf[128];
-static uint8_t tx_buf[128];
+static const uint8_t cmd_rev[] = {0x13};
+static const uint8_t jvs_rev[] = {0x30};
+static const uint8_t comm_rev[] = {0x10};
+static const uint8_t feature[] = {
+    /* Switch input */
+    0x01, 12, 16, 0x00,
+    /* Coin input */
+    0x02, 12, 0x00, 0x00,
+    /* Analog input */
+    0x03, 2 * 12, 16, 0x00,
+    /* End */
+    0x00,
+};
+/* Report data of Get Info to Get Feature (0x10 - 0x14) */
+static const struct {
+    const uint8_t *data;
+    uint32_t len;
+} static_reports[JVS_STATIC_MAX] = {
+    {ident_str, sizeof(ident_str)},
+    {cmd_rev, sizeof(cmd_rev)},
+    {jvs_rev, sizeof(jvs_rev)},
+    {comm_rev, sizeof(comm_rev)},
+    {feature, sizeof(feature)},
+};
+static uint8_t rx_buf[JVS_BUF_MAX];
+static uint8_t tx_buf[JVS_BUF_MAX];
+static struct jvs_frame tx_frame = {0};
+/* Replies to single command requests that never change */
+static struct jvs_frame static_frames[JVS_STATIC_MAX] = {0};
+/* Last frame sent, for retransmit */
+static const struct jvs_frame *last_frame = &tx_frame;
+static struct jvs_cache cache[JVS_CACHE_MAX] = {0};
+/* Entries below count are complete and never change shape */
+static atomic_t cache_cnt = ATOMIC_INIT(0);
+static uint32_t clk_div[JVS_SPEED_MAX] = {0};
+static uint8_t speed = JVS_SPEED_115200;
+static uint8_t pending_speed = JVS_SPEED_115200;
 static uint8_t node_id = 0;
 
 static inline uint32_t jvs_read_rxfifo(uint8_t *buf, uint32_t raw_len, uint32_t *len)
@@ -69,36 +157,230 @@ static inline uint32_t jvs_read_rxfifo(uint8_t *buf, uint32_t raw_len, uint32_t
     return ((sum % 256) == READ_PERI_REG(UART_FIFO_REG(1)));
 }
 
-static inline void jvs_write_txfifo(const uint8_t *buf, uint32_t len)
-{
+static inline uint32_t jvs_escape(uint8_t *dst, uint8_t byte) {
+    switch (byte) {
+        case SYNC:
+            dst[0] = MARK;
+            dst[1] = E0BYTE;
+            return 2;
+        case MARK:
+            dst[0] = MARK;
+            dst[1] = D0BYTE;
+            return 2;
+        default:
+            dst[0] = byte;
+            return 1;
+    }
+}
+
+static void IRAM_ATTR jvs_frame_build(struct jvs_frame *frame, const uint8_t *buf, uint32_t len) {
+    uint8_t *data = frame->data;
     uint8_t sum = 0;
 
-    WRITE_PERI_REG(UART_FIFO_AHB_REG(1), SYNC);
+    *data++ = SYNC;
     for (uint32_t i = 0; i < len; ++i) {
-        switch (buf[i]) {
-            case SYNC:
-                WRITE_PERI_REG(UART_FIFO_AHB_REG(1), MARK);
-                WRITE_PERI_REG(UART_FIFO_AHB_REG(1), E0BYTE);
-                break;
-            case MARK:
-                WRITE_PERI_REG(UART_FIFO_AHB_REG(1), MARK);
-                WRITE_PERI_REG(UART_FIFO_AHB_REG(1), D0BYTE);
-                break;
-            default:
-                WRITE_PERI_REG(UART_FIFO_AHB_REG(1), buf[i]);
-        }
+        data += jvs_escape(data, buf[i]);
         sum += buf[i];
     }
-    WRITE_PERI_REG(UART_FIFO_AHB_REG(1), (sum % 256));
+    data += jvs_escape(data, sum);
+    frame->len = data - frame->data;
+}
+
+static inline void jvs_frame_push(const struct jvs_frame *frame) {
+    for (uint32_t i = 0; i < frame->len; ++i) {
+        WRITE_PERI_REG(UART_FIFO_AHB_REG(1), frame->data[i]);
+    }
+}
+
+static void jvs_static_frames_init(void) {
+    uint8_t buf[64];
+
+    for (uint32_t i = 0; i < JVS_STATIC_MAX; i++) {
+        uint32_t len = 0;
+
+        buf[len++] = 0x00;
+        len++;
+        buf[len++] = 0x01;
+        buf[len++] = 0x01;
+        memcpy(&buf[len], static_reports[i].data, static_reports[i].len);
+        len += static_reports[i].len;
+        buf[1] = len - 1;
+        jvs_frame_build(&static_frames[i], buf, len);
+    }
+}
+
+static const uint8_t * IRAM_ATTR jvs_src_frame(uint32_t src_id, uint8_t wired_id, uint32_t idx) {
+    if (src_id == wired_id) {
+        return wired_adapter.data[src_id].frame[idx];
+    }
+    return wired_frame(&wired_adapter.data[src_id]);
+}
+
+/* Append Get Switch, Get Coin or Get Analog report, return request bytes used.
+ * 0 if unsupported or asking for more outputs or reply data than we have.
+ */
+static uint32_t IRAM_ATTR jvs_input_report(uint8_t *buf, uint32_t *len, const uint8_t *cmd,
+        uint32_t *dev_cnt, uint8_t wired_id, uint32_t idx) {
+    switch (cmd[0]) {
+        case 0x20: /* Get Switch */
+        {
+            uint8_t player_cnt = cmd[1];
+            uint8_t data_cnt = cmd[2];
+
+            if (player_cnt > WIRED_MAX_DEV || data_cnt > sizeof(wired_adapter.data[0].frame[0]) - 2
+                    || *len + 2 + player_cnt * data_cnt > JVS_BUF_MAX) {
+                return 0;
+            }
+            buf[(*len)++] = 0x01;
+            buf[(*len)++] = jvs_src_frame(0, wired_id, idx)[8];
+            for (uint32_t i = 0; i < player_cnt; i++) {
+                memcpy(buf + *len, jvs_src_frame(i, wired_id, idx) + 2, data_cnt);
+                *len += data_cnt;
+            }
+            *dev_cnt = MAX(*dev_cnt, player_cnt);
+            return 3;
+        }
+        case 0x21: /* Get Coin */
+        {
+            uint8_t slot_cnt = cmd[1];
+
+            if (slot_cnt > WIRED_MAX_DEV || *len + 1 + slot_cnt * 2 > JVS_BUF_MAX) {
+                return 0;
+            }
+            buf[(*len)++] = 0x01;
+            for (uint32_t i = 0; i < slot_cnt; i++) {
+                *(uint16_t *)&buf[*len] = *(uint16_t *)jvs_src_frame(i, wired_id, idx);
+                *len += 2;
+            }
+            *dev_cnt = MAX(*dev_cnt, slot_cnt);
+            return 2;
+        }
+        case 0x22: /* Get Analog */
+        {
+            uint8_t ch_cnt = cmd[1];
+
+            if (ch_cnt > WIRED_MAX_DEV * 2 || *len + 1 + ch_cnt * 2 > JVS_BUF_MAX) {
+                return 0;
+            }
+            buf[(*len)++] = 0x01;
+            for (uint32_t i = 0; i < ch_cnt; i++) {
+                *(uint16_t *)&buf[*len] = *(uint16_t *)(jvs_src_frame(i / 2, wired_id, idx) + ((i & 0x1) ? 6 : 4));
+                *len += 2;
+            }
+            *dev_cnt = MAX(*dev_cnt, (ch_cnt + 1) / 2);
+            return 2;
+        }
+    }
+    return 0;
+}
+
+/* Build reply to a request made only of input commands, 0 if anything else */
+static uint32_t IRAM_ATTR jvs_inputs_build(uint8_t *buf, const uint8_t *req, uint32_t req_len,
+        uint32_t *dev_cnt, uint8_t wired_id, uint32_t idx) {
+    const uint8_t *end = req + req_len;
+    uint32_t len = 0;
+
+    buf[len++] = 0x00;
+    len++;
+    buf[len++] = 0x01;
+    while (req < end) {
+        uint32_t used = jvs_input_report(buf, &len, req, dev_cnt, wired_id, idx);
+
+        if (!used) {
+            return 0;
+        }
+        req += used;
+    }
+    if (req != end) {
+        return 0;
+    }
+    buf[1] = len - 1;
+    return len;
+}
+
+static const struct jvs_frame * IRAM_ATTR jvs_cache_get(const uint8_t *req, uint32_t req_len, uint8_t *tx_buf) {
+    uint32_t cnt = atomic_get(&cache_cnt);
+    struct jvs_cache *entry;
+    uint32_t dev_cnt = 0;
+    uint32_t len;
+
+    for (uint32_t i = 0; i < cnt; i++) {
+        entry = &cache[i];
+        if (entry->req_len == req_len && !memcmp(entry->req, req, req_len)) {
+            return &entry->frames[atomic_get(&entry->seq) & 0x1];
+        }
+    }
+
+    /* New input poll shape, add it if there is room */
+    if (cnt >= JVS_CACHE_MAX || req_len > JVS_CACHE_REQ_MAX) {
+        return NULL;
+    }
+    len = jvs_inputs_build(tx_buf, req, req_len, &dev_cnt, WIRED_MAX_DEV, 0);
+    if (!len) {
+        return NULL;
+    }
+    entry = &cache[cnt];
+    memcpy(entry->req, req, req_len);
+    entry->req_len = req_len;
+    entry->dev_cnt = dev_cnt;
+    atomic_set(&entry->seq, 0);
+    jvs_frame_build(&entry->frames[0], tx_buf, len);
+    atomic_set(&cache_cnt, cnt + 1);
+    return &entry->frames[0];
+}
+
+/* Called on adapter core before wired_id frame[idx] get published */
+static void jvs_frame_encode(uint8_t wired_id, uint32_t idx) {
+    uint8_t buf[JVS_BUF_MAX];
+    uint32_t cnt = atomic_get(&cache_cnt);
+
+    for (uint32_t i = 0; i < cnt; i++) {
+        struct jvs_cache *entry = &cache[i];
+        uint32_t seq = atomic_get(&entry->seq) + 1;
+        uint32_t dev_cnt = 0;
+        uint32_t len;
+
+        if (wired_id >= entry->dev_cnt) {
+            continue;
+        }
+        len = jvs_inputs_build(buf, entry->req, entry->req_len, &dev_cnt, wired_id, idx);
+        jvs_frame_build(&entry->frames[seq & 0x1], buf, len);
+        atomic_set(&entry->seq, seq);
+    }
+}
+
+static void IRAM_ATTR jvs_set_speed(uint8_t new_speed) {
+    speed = new_speed;
+    UART1.clk_div.val = clk_div[speed];
+}
+
+/* Reply too big for tx_buf, discard everything and return overflow */
+static const struct jvs_frame * IRAM_ATTR jvs_overflow(uint8_t *tx_buf) {
+    tx_buf[1] = 0x02;
+    tx_buf[2] = 0x04;
+    jvs_frame_build(&tx_frame, tx_buf, 3);
+    return &tx_frame;
 }
 
-static void IRAM_ATTR jvs_parser(uint8_t *rx_buf, uint32_t rx_len, uint8_t *tx_buf, uint32_t *tx_len) {
+static const struct jvs_frame * IRAM_ATTR jvs_parser(uint8_t *rx_buf, uint32_t rx_len, uint8_t *tx_buf) {
     uint8_t *end = rx_buf + rx_len;
     uint8_t *jvs = rx_buf;
-    uint8_t len = 0;
+    uint32_t len = 0;
 
     if (*jvs == node_id || *jvs == BCAST) {
         jvs += 2;
+        /* Single command with a constant reply */
+        if (jvs + 1 == end && *jvs >= 0x10 && *jvs <= 0x14) {
+            return &static_frames[*jvs - 0x10];
+        }
+        /* Input poll, reply kept up to date by frame_encode hook */
+        if (*jvs >= 0x20 && *jvs <= 0x22) {
+            const struct jvs_frame *frame = jvs_cache_get(jvs, end - jvs, tx_buf);
+
+            if (frame) {
+                return frame;
+            }
+        }
         tx_buf[len++] = 0x00;
         len++;
         tx_buf[len++] = 0x01;
@@ -108,6 +390,7 @@ static void IRAM_ATTR jvs_parser(uint8_t *rx_buf, uint32_t rx_len, uint8_t *tx_b
                     if (*jvs++ == 0xD9) {
                         GPIO.out_w1ts = JVS_SENSE_MASK;
                         node_id = 0;
+                        pending_speed = JVS_SPEED_115200;
                     }
                     len = 0;
                     break;
@@ -122,117 +405,73 @@ static void IRAM_ATTR jvs_parser(uint8_t *rx_buf, uint32_t rx_len, uint8_t *tx_b
                     }
                     jvs++;
                     break;
-                case 0xF2: /* Set Speed */
-                    ets_printf("0xF2 NA\n");
-                    jvs += 2;
+                case 0xF2: /* Set Speed, no reply */
+                    if (*jvs < JVS_SPEED_MAX) {
+                        pending_speed = *jvs;
+                    }
+                    jvs++;
+                    len = 0;
                     break;
                 case 0x10: /* Get Info */
-                    tx_buf[len++] = 0x01;
-                    memcpy(&tx_buf[4], ident_str, sizeof(ident_str));
-                    len += sizeof(ident_str);
-                    break;
                 case 0x11: /* Get CMD Rev */
-                    tx_buf[len++] = 0x01;
-                    tx_buf[len++] = 0x13;
-                    break;
                 case 0x12: /* Get JVS Rev */
-                    tx_buf[len++] = 0x01;
-                    tx_buf[len++] = 0x30;
-                    break;
                 case 0x13: /* Get COMM Rev */
-                    tx_buf[len++] = 0x01;
-                    tx_buf[len++] = 0x10;
-                    break;
                 case 0x14: /* Get Feature */
+                {
+                    uint8_t idx = jvs[-1] - 0x10;
+                    if (len + 1 + static_reports[idx].len > JVS_BUF_MAX) {
+                        return jvs_overflow(tx_buf);
+                    }
                     tx_buf[len++] = 0x01;
-
-                    /* Switch input */
-                    tx_buf[len++] = 0x01;
-                    tx_buf[len++] = 12;
-                    tx_buf[len++] = 16;
-                    tx_buf[len++] = 0x00;
-
-                    /* Coin input */
-                    tx_buf[len++] = 0x02;
-                    tx_buf[len++] = 12;
-                    tx_buf[len++] = 0x00;
-                    tx_buf[len++] = 0x00;
-
-                    /* Analog input */
-                    tx_buf[len++] = 0x03;
-                    tx_buf[len++] = 2 * 12;
-                    tx_buf[len++] = 16;
-                    tx_buf[len++] = 0x00;
-
-                    /* End */
-                    tx_buf[len++] = 0x00;
+                    memcpy(&tx_buf[len], static_reports[idx].data, static_reports[idx].len);
+                    len += static_reports[idx].len;
                     break;
+                }
                 case 0x15: /* Set Info */
                     ets_printf("%s\n", jvs);
                     while (*jvs++ != 0);
                     tx_buf[len++] = 0x01;
                     break;
                 case 0x20: /* Get Switch */
-                {
-                    uint8_t player_cnt = *jvs++;
-                    uint8_t data_cnt = *jvs++;
-                    tx_buf[len++] = 0x01;
-                    tx_buf[len++] = wired_adapter.data[0].output[8];
-                    for (uint32_t i = 0; i < player_cnt; i++) {
-                        memcpy(tx_buf + len, wired_adapter.data[i].output + 2, data_cnt);
-                        len += data_cnt;
-                    }
-                    break;
-                }
                 case 0x21: /* Get Coin */
-                {
-                    uint8_t slot_cnt = *jvs++;
-                    tx_buf[len++] = 0x01;
-                    for (uint32_t i = 0; i < slot_cnt; i++) {
-                        *(uint16_t *)&tx_buf[len] = *(uint16_t *)wired_adapter.data[i].output;
-                        len += 2;
-                    }
-                    break;
-                }
                 case 0x22: /* Get Analog */
                 {
-                    uint8_t ch_cnt = *jvs++;
-                    tx_buf[len++] = 0x01;
-                    for (uint32_t i = 0; i < ch_cnt; i++) {
-                        *(uint16_t *)&tx_buf[len] = *(uint16_t *)(wired_adapter.data[i / 2].output + ((i & 0x1) ? 6 : 4));
-                        len += 2;
+                    uint32_t dev_cnt = 0;
+                    uint32_t used = jvs_input_report(tx_buf, &len, jvs - 1, &dev_cnt, WIRED_MAX_DEV, 0);
+
+                    if (!used) {
+                        return jvs_overflow(tx_buf);
                     }
+                    jvs += used - 1;
                     break;
                 }
                 case 0x2F: /* Retransmit */
-                    /* Last frame should still be in tx_buf */
-                    len = tx_buf[1] + 1;
-                    break;
+                    return last_frame;
                 default:
                     /* Unsupported cmd, discard everything and return error */
                     ets_printf("0x%02X NA\n", *jvs);
                     tx_buf[1] = 0x03;
                     tx_buf[2] = 0x02;
                     tx_buf[3] = 0x01;
-                    *tx_len = 4;
-                    return;
+                    jvs_frame_build(&tx_frame, tx_buf, 4);
+                    return &tx_frame;
             }
         }
         tx_buf[1] = len - 1;
     }
     if (len) {
-        *tx_len = len;
-    }
-    else {
-        *tx_len = 0;
+        jvs_frame_build(&tx_frame, tx_buf, len);
+        return &tx_frame;
     }
+    return NULL;
 }
 
 static void IRAM_ATTR uart_rx(void* arg) {
     uint32_t intr_status = UART1.int_st.val;
 
     if (intr_status & UART_INTR_RXFIFO_TOUT) {
-        uint32_t rx_len, tx_len;
+        const struct jvs_frame *frame = NULL;
+        uint32_t rx_len;
         uint16_t read_len = uart_ll_get_rxfifo_len(&UART1);
 
         if (!jvs_read_rxfifo(rx_buf, read_len, &rx_len)) {
@@ -249,13 +488,17 @@ static void IRAM_ATTR uart_rx(void* arg) {
             ets_printf("T\n");
         }
 #else
-        jvs_parser(rx_buf, rx_len, tx_buf, &tx_len);
+        frame = jvs_parser(rx_buf, rx_len, tx_buf);
 #endif
 
-        if (tx_len) {
+        if (frame) {
+            last_frame = frame;
             GPIO.out_w1ts = JVS_RTS_MASK;
-            ets_delay_us(10);
-            jvs_write_txfifo(tx_buf, tx_len);
+            ets_delay_us(jvs_speeds[speed].turnaround_us);
+            jvs_frame_push(frame);
+        }
+        else if (pending_speed != speed) {
+            jvs_set_speed(pending_speed);
         }
     }
     if (intr_status & UART_INTR_RXFIFO_OVF) {
@@ -264,6 +507,10 @@ static void IRAM_ATTR uart_rx(void* arg) {
     }
     if (intr_status & UART_INTR_TX_DONE) {
         GPIO.out_w1tc = JVS_RTS_MASK;
+        /* Speed change apply once reply is out */
+        if (pending_speed != speed) {
+            jvs_set_speed(pending_speed);
+        }
     }
     UART1.int_clr.val = intr_status;
 }
@@ -280,6 +527,10 @@ void jvs_init(void) {
         .pin_bit_mask = JVS_RTS_MASK,
     };
 
+    jvs_static_frames_init();
+    /* Hook first so no frame published after a poll is cached is missed */
+    wired_adapter.frame_encode = jvs_frame_encode;
+
     periph_module_enable(PERIPH_UART1_MODULE);
 
     /* JVS_SENSE is output */
@@ -310,8 +561,12 @@ void jvs_init(void) {
     UART1.conf1.rxfifo_full_thrhd = 120;
     UART1.conf1.txfifo_empty_thrhd = 10;
     UART1.int_ena.val |= UART_INTR_RXFIFO_TOUT | UART_INTR_RXFIFO_OVF | UART_INTR_TX_DONE;
-    UART1.clk_div.div_int = ((APB_CLK_FREQ << 4) / 115200) >> 4;
-    UART1.clk_div.div_frag = ((APB_CLK_FREQ << 4) / 115200) & 0xF;
+    for (uint32_t i = 0; i < JVS_SPEED_MAX; i++) {
+        uint32_t div = (APB_CLK_FREQ << 4) / jvs_speeds[i].baudrate;
+
+        clk_div[i] = ((div >> 4) << UART_CLKDIV_S) | ((div & 0xF) << UART_CLKDIV_FRAG_S);
+    }
+    jvs_set_speed(JVS_SPEED_115200);
     UART1.conf0.tick_ref_always_on = 1;
 
     /* We deal with the RS485 stuff ourself */
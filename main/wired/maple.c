@@ -8,14 +8,21 @@
 #include <stdlib.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <esp_timer.h>
 #include <xtensa/hal.h>
 #include <esp32/dport_access.h>
 #include <esp_intr_alloc.h>
 #include "driver/gpio.h"
+#include <driver/periph_ctrl.h>
+#include <esp32/rom/lldesc.h>
+#include <soc/i2s_struct.h>
+#include <soc/gpio_sig_map.h>
 #include "../zephyr/types.h"
+#include "../zephyr/atomic.h"
 #include "../util.h"
 #include "../adapter/adapter.h"
 #include "../adapter/config.h"
+#include "../trace.h"
 #include "maple.h"
 
 #define ID_CTRL    0x00000001
@@ -40,7 +47,10 @@
 #define CMD_MEM_INFO_REQ  0x0A
 #define CMD_BLOCK_READ    0x0B
 #define CMD_BLOCK_WRITE   0x0C
+#define CMD_GET_LAST_ERR  0x0D
 #define CMD_SET_CONDITION 0x0E
+#define CMD_FILE_ERR      0xFB
+#define CMD_REQ_RESEND    0xFC
 
 #define ADDR_MASK   0x3F
 #define ADDR_CTRL   0x20
@@ -50,8 +60,24 @@
 #define DESC_CTRL     0x000F06FE
 #define DESC_CTRL_ALT 0x003FFFFF
 #define DESC_RUMBLE   0x01010000
+#define DESC_VMU_MEM  0x000F4100
+
+#ifndef VMU_FILE
+#define VMU_FILE "/sd/vmu%d_%d.bin"
+#endif
+#define VMU_BLK_SIZE 512
+#define VMU_BLK_CNT 256
+#define VMU_PHASE_SIZE 128
+/* Blocks cache shared by all ports, 32 KB of DRAM */
+#define VMU_CACHE_BLKS 64
+/* ~1 sec of GET_CONDITION without write before write-back */
+#define VMU_SAVE_POLL_DELAY 60
 
 //#define WIRED_TRACE
+//#define MAPLE_TX_BITBANG /* Bit-bang TX with other core stalled instead of playing it with I2S1 DMA */
+#ifndef MAPLE_TX_BITBANG
+#define MAPLE_TX_I2S
+#endif
 #define DEBUG  (1ULL << 25)
 #define TIMEOUT 8
 
@@ -102,6 +128,17 @@ static const uint8_t rumble_area_dir_name[] = {
     0x6C, 0x6C, 0x6F, 0x72, 0x20, 0x20, 0x72, 0x65, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
 };
 
+static const uint8_t vmu_area_dir_name[] = {
+    0x69, 0x56, 0x00, 0xFF, 0x6C, 0x61, 0x75, 0x73, 0x6D, 0x65, 0x4D, 0x20, 0x20, 0x79, 0x72, 0x6F,
+    0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20,
+};
+
+/* Total size, partition, system area, FAT, FAT size, file info, file info size, */
+/* volume icon, save area size, save area start */
+static const uint32_t vmu_mem_info[] = {
+    0x00FF0000, 0x00FF00FE, 0x000100FD, 0x000D0000, 0x00C8001F, 0x00000000,
+};
+
 static const uint8_t brand[] = {
     0x64, 0x6F, 0x72, 0x50, 0x64, 0x65, 0x63, 0x75, 0x20, 0x79, 0x42, 0x20, 0x55, 0x20, 0x72, 0x6F,
     0x72, 0x65, 0x64, 0x6E, 0x63, 0x69, 0x4C, 0x20, 0x65, 0x73, 0x6E, 0x65, 0x6F, 0x72, 0x46, 0x20,
@@ -109,14 +146,240 @@ static const uint8_t brand[] = {
     0x4C, 0x2C, 0x53, 0x45, 0x20, 0x2E, 0x44, 0x54, 0x20, 0x20, 0x20, 0x20,
 };
 
+/* RX frame status */
+enum {
+    MAPLE_RX_GOOD = 0,
+    MAPLE_RX_REPAIRED,
+    MAPLE_RX_DROPPED,
+};
+
+/* VMU block flags */
+enum {
+    VMU_BLK_VALID = 0,
+    VMU_BLK_DIRTY,
+    VMU_BLK_BUSY,
+};
+
+/* Block data is kept in maple word order, swapped on SD access */
+struct vmu_blk {
+    atomic_t flags;
+    uint32_t port;
+    uint32_t blk;
+    uint32_t last_use;
+    uint32_t data32[VMU_BLK_SIZE / 4];
+};
+
+/* GET_CONDITION response, crc exclude src & dst */
+struct maple_cond_pkt {
+    uint8_t len;
+    uint8_t src;
+    uint8_t dst;
+    uint8_t cmd;
+    uint32_t data32[3];
+    uint8_t crc;
+} __packed;
+
 static struct maple_pkt pkt;
+/* Response pre-built by adapter core, idx match wired frame idx */
+static struct maple_cond_pkt cond_rsp[4][2] = {0};
+static uint8_t cond_crc[4][2] = {0};
 static uint32_t rumble_max = 0x00020013;
 static uint32_t rumble_val = 0x10E0073B;
 
-static void IRAM_ATTR maple_tx(uint32_t port, uint32_t maple0, uint32_t maple1, uint8_t *data, uint8_t len) {
-    uint8_t *crc = data + (len - 1);
-    *crc = 0x00;
+static struct vmu_blk *vmu_cache = NULL;
+static uint32_t vmu_use_cnt = 0;
+static int32_t vmu_bank[4] = {-1, -1, -1, -1};
+static ATOMIC_DEFINE(vmu_fetch[4], VMU_BLK_CNT);
+static TaskHandle_t vmu_task_hdl = NULL;
+static uint32_t vmu_mem_change[4] = {0};
+static uint32_t poll_after_mem_wr[4] = {0};
+
+#ifdef MAPLE_TX_I2S
+/* I2S1 LCD mode, 16 bits samples at 10 MHz, bit 0 drive maple0 & bit 1 maple1 */
+#define I2S_S(m0, m1) ((m0) | ((m1) << 1))
+#define I2S_IDLE I2S_S(1, 1)
+/* 2nd half word of each word is sent first */
+#define I2S_IDX(i) ((i) ^ 1)
+#define I2S_LEAD_SAMPLES 32
+#define I2S_START_SAMPLES 42
+#define I2S_PAIR_SAMPLES 10
+#define I2S_HEAD_SAMPLES (I2S_LEAD_SAMPLES + I2S_START_SAMPLES + 4 * I2S_PAIR_SAMPLES)
+#define I2S_END_SAMPLES 32
+/* Cover TX FIFO depth so last data is out when DMA EOF */
+#define I2S_TAIL_SAMPLES 128
+#define I2S_DESC_MAX (2 * sizeof(struct maple_pkt) + 2)
+/* Twice the packet play time at 10 samples per us */
+#define I2S_TX_TIMEOUT_US(len) (2 * (I2S_HEAD_SAMPLES + (len) * 4 * I2S_PAIR_SAMPLES + I2S_END_SAMPLES + I2S_TAIL_SAMPLES) / 10)
+
+/* Lead, start sequence and 1st byte, rendered per packet */
+static uint16_t i2s_head[I2S_HEAD_SAMPLES];
+/* Two bits pairs for each nibble value, following bytes are chained from those */
+static uint16_t i2s_nibble[16][2 * I2S_PAIR_SAMPLES];
+/* End sequence and idle */
+static uint16_t i2s_tail[I2S_END_SAMPLES + I2S_TAIL_SAMPLES];
+static lldesc_t i2s_desc[I2S_DESC_MAX];
+
+static uint32_t maple_i2s_render(uint16_t *buf, uint32_t i, uint16_t sample, uint32_t cnt) {
+    for (uint32_t end = i + cnt; i < end; i++) {
+        buf[I2S_IDX(i)] = sample;
+    }
+    return i;
+}
+
+/* Same phases as bit-banged maple_tx, each sample is one wait_100ns() */
+static uint32_t IRAM_ATTR maple_i2s_render_pair(uint16_t *buf, uint32_t i, uint32_t prev_m1, uint32_t a, uint32_t b) {
+    buf[I2S_IDX(i++)] = I2S_S(1, prev_m1);
+    buf[I2S_IDX(i++)] = I2S_S(1, prev_m1);
+    buf[I2S_IDX(i++)] = I2S_S(1, a);
+    buf[I2S_IDX(i++)] = I2S_S(0, a);
+    buf[I2S_IDX(i++)] = I2S_S(0, a);
+    buf[I2S_IDX(i++)] = I2S_S(0, 1);
+    buf[I2S_IDX(i++)] = I2S_S(0, 1);
+    buf[I2S_IDX(i++)] = I2S_S(b, 1);
+    buf[I2S_IDX(i++)] = I2S_S(b, 0);
+    buf[I2S_IDX(i++)] = I2S_S(b, 0);
+    return i;
+}
+
+static void IRAM_ATTR maple_i2s_desc_set(lldesc_t *desc, const uint16_t *buf, uint32_t len) {
+    desc->size = len;
+    desc->length = len;
+    desc->offset = 0;
+    desc->sosf = 0;
+    desc->eof = 0;
+    desc->owner = 1;
+    desc->buf = (uint8_t *)buf;
+    desc->qe.stqe_next = desc + 1;
+}
+
+static void maple_i2s_init(void) {
+    uint32_t i = 0;
+
+    i = maple_i2s_render(i2s_head, i, I2S_IDLE, I2S_LEAD_SAMPLES);
+    i = maple_i2s_render(i2s_head, i, I2S_S(0, 1), 5);
+    i = maple_i2s_render(i2s_head, i, I2S_S(0, 0), 5);
+    for (uint32_t j = 0; j < 3; j++) {
+        i = maple_i2s_render(i2s_head, i, I2S_S(0, 1), 5);
+        i = maple_i2s_render(i2s_head, i, I2S_S(0, 0), 5);
+    }
+    maple_i2s_render(i2s_head, i, I2S_S(0, 1), 2);
+
+    for (uint32_t j = 0; j < ARRAY_SIZE(i2s_nibble); j++) {
+        i = maple_i2s_render_pair(i2s_nibble[j], 0, 0, !!(j & 0x8), !!(j & 0x4));
+        maple_i2s_render_pair(i2s_nibble[j], i, 0, !!(j & 0x2), !!(j & 0x1));
+    }
+
+    i = maple_i2s_render(i2s_tail, 0, I2S_S(1, 0), 1);
+    i = maple_i2s_render(i2s_tail, i, I2S_S(1, 1), 5);
+    i = maple_i2s_render(i2s_tail, i, I2S_S(1, 0), 5);
+    i = maple_i2s_render(i2s_tail, i, I2S_S(0, 0), 5);
+    i = maple_i2s_render(i2s_tail, i, I2S_S(1, 0), 5);
+    i = maple_i2s_render(i2s_tail, i, I2S_S(0, 0), 5);
+    i = maple_i2s_render(i2s_tail, i, I2S_S(1, 0), 5);
+    maple_i2s_render(i2s_tail, i, I2S_IDLE, I2S_TAIL_SAMPLES + 1);
+
+    periph_module_enable(PERIPH_I2S1_MODULE);
+
+    I2S1.conf.tx_reset = 1;
+    I2S1.conf.tx_reset = 0;
+    I2S1.conf.tx_fifo_reset = 1;
+    I2S1.conf.tx_fifo_reset = 0;
+    I2S1.lc_conf.out_rst = 1;
+    I2S1.lc_conf.out_rst = 0;
+
+    I2S1.conf2.val = 0;
+    I2S1.conf2.lcd_en = 1;
+
+    /* 160 MHz PLL_D2 / 8 / 2 = 10 MHz */
+    I2S1.clkm_conf.val = 0;
+    I2S1.clkm_conf.clka_en = 0;
+    I2S1.clkm_conf.clkm_div_a = 1;
+    I2S1.clkm_conf.clkm_div_b = 0;
+    I2S1.clkm_conf.clkm_div_num = 8;
+    I2S1.sample_rate_conf.val = 0;
+    I2S1.sample_rate_conf.tx_bits_mod = 16;
+    I2S1.sample_rate_conf.tx_bck_div_num = 1;
+
+    I2S1.fifo_conf.val = 0;
+    I2S1.fifo_conf.tx_fifo_mod_force_en = 1;
+    I2S1.fifo_conf.tx_fifo_mod = 1;
+    I2S1.fifo_conf.tx_data_num = 32;
+    I2S1.fifo_conf.dscr_en = 1;
+
+    I2S1.conf1.val = 0;
+    I2S1.conf1.tx_stop_en = 0;
+    I2S1.conf1.tx_pcm_bypass = 1;
+    I2S1.conf_chan.val = 0;
+    I2S1.conf_chan.tx_chan_mod = 1;
+    I2S1.timing.val = 0;
+
+    I2S1.lc_conf.val = 0;
+    I2S1.lc_conf.out_eof_mode = 1;
+    I2S1.lc_conf.out_data_burst_en = 1;
+    I2S1.lc_conf.outdscr_burst_en = 1;
+}
+
+/* Stream bytes as is, CRC included */
+static void IRAM_ATTR maple_tx_raw(uint32_t port, uint32_t maple0, uint32_t maple1, const uint8_t *data, uint32_t len) {
+    uint32_t i = I2S_LEAD_SAMPLES + I2S_START_SAMPLES;
+    uint32_t timeout = I2S_TX_TIMEOUT_US(len) * CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ;
+    uint32_t start;
+    lldesc_t *desc = i2s_desc;
+
+    /* 1st pair follow start sequence which end with maple1 high */
+    i = maple_i2s_render_pair(i2s_head, i, 1, !!(data[0] & 0x80), !!(data[0] & 0x40));
+    i = maple_i2s_render_pair(i2s_head, i, 0, !!(data[0] & 0x20), !!(data[0] & 0x10));
+    i = maple_i2s_render_pair(i2s_head, i, 0, !!(data[0] & 0x08), !!(data[0] & 0x04));
+    maple_i2s_render_pair(i2s_head, i, 0, !!(data[0] & 0x02), !!(data[0] & 0x01));
+    maple_i2s_desc_set(desc++, i2s_head, sizeof(i2s_head));
+    for (uint32_t j = 1; j < len; j++) {
+        maple_i2s_desc_set(desc++, i2s_nibble[data[j] >> 4], sizeof(i2s_nibble[0]));
+        maple_i2s_desc_set(desc++, i2s_nibble[data[j] & 0xF], sizeof(i2s_nibble[0]));
+    }
+    maple_i2s_desc_set(desc, i2s_tail, sizeof(i2s_tail));
+    desc->eof = 1;
+    desc->qe.stqe_next = NULL;
+
+    ets_delay_us(55);
+
+    GPIO.out_w1ts = maple0 | maple1;
+    gpio_set_direction(gpio_pin[port][0], GPIO_MODE_OUTPUT);
+    gpio_set_direction(gpio_pin[port][1], GPIO_MODE_OUTPUT);
+
+    I2S1.conf.tx_fifo_reset = 1;
+    I2S1.conf.tx_fifo_reset = 0;
+    I2S1.lc_conf.out_rst = 1;
+    I2S1.lc_conf.out_rst = 0;
+    I2S1.int_clr.val = 0xFFFFFFFF;
+    I2S1.out_link.addr = (uintptr_t)i2s_desc;
+    I2S1.out_link.start = 1;
+    I2S1.conf.tx_start = 1;
+
+    /* Lines stay idle high while lead samples play */
+    gpio_matrix_out(gpio_pin[port][0], I2S1O_DATA_OUT0_IDX, 0, 0);
+    gpio_matrix_out(gpio_pin[port][1], I2S1O_DATA_OUT1_IDX, 0, 0);
+
+    start = xthal_get_ccount();
+    while (!I2S1.int_raw.out_total_eof) {
+        /* Don't hang ISR if DMA never complete */
+        if (xthal_get_ccount() - start > timeout) {
+            ets_printf("# %s: I2S TX timeout\n", __FUNCTION__);
+            break;
+        }
+    }
+    /* Let FIFO drain, only idle left in it */
+    ets_delay_us(13);
 
+    I2S1.conf.tx_start = 0;
+    I2S1.out_link.stop = 1;
+    gpio_matrix_out(gpio_pin[port][0], SIG_GPIO_OUT_IDX, 0, 0);
+    gpio_matrix_out(gpio_pin[port][1], SIG_GPIO_OUT_IDX, 0, 0);
+    gpio_set_direction(gpio_pin[port][0], GPIO_MODE_INPUT);
+    gpio_set_direction(gpio_pin[port][1], GPIO_MODE_INPUT);
+}
+#else
+/* Stream bytes as is, CRC included */
+static void IRAM_ATTR maple_tx_raw(uint32_t port, uint32_t maple0, uint32_t maple1, const uint8_t *data, uint32_t len) {
     ets_delay_us(55);
 
     GPIO.out_w1ts = maple0 | maple1;
@@ -206,7 +469,6 @@ static void IRAM_ATTR maple_tx(uint32_t port, uint32_t maple0, uint32_t maple1,
             wait_100ns();
             wait_100ns();
         }
-        *crc ^= *data;
     }
     GPIO.out_w1ts = maple0;
     wait_100ns();
@@ -254,7 +516,506 @@ static void IRAM_ATTR maple_tx(uint32_t port, uint32_t maple0, uint32_t maple1,
     /* Send start sequence */
 
 }
+#endif /* MAPLE_TX_I2S */
+
+static void IRAM_ATTR maple_tx(uint32_t port, uint32_t maple0, uint32_t maple1, uint8_t *data, uint32_t len) {
+    uint8_t *crc = data + (len - 1);
+
+    *crc = 0x00;
+    for (uint8_t *byte = data; byte < crc; ++byte) {
+        *crc ^= *byte;
+    }
+    maple_tx_raw(port, maple0, maple1, data, len);
+}
+
+static void maple_frame_encode(uint8_t wired_id, uint32_t idx) {
+    struct maple_cond_pkt *rsp;
+    uint8_t crc = 0;
+
+    if (wired_id < ARRAY_SIZE(cond_rsp)) {
+        rsp = &cond_rsp[wired_id][idx];
+        rsp->len = 3;
+        rsp->cmd = CMD_DATA_TX;
+        rsp->data32[0] = ID_CTRL;
+        memcpy((void *)&rsp->data32[1], wired_adapter.data[wired_id].frame[idx], sizeof(uint32_t) * 2);
+        for (uint8_t *byte = (uint8_t *)rsp; byte < &rsp->crc; ++byte) {
+            if (byte != &rsp->src && byte != &rsp->dst) {
+                crc ^= *byte;
+            }
+        }
+        cond_crc[wired_id][idx] = crc;
+    }
+}
+
+/* Entry stay BUSY until vmu_cache_put, VMU task won't evict it meanwhile */
+static struct vmu_blk *IRAM_ATTR vmu_cache_get(uint32_t port, uint32_t blk) {
+    for (uint32_t i = 0; i < VMU_CACHE_BLKS; i++) {
+        if (vmu_cache[i].port == port && vmu_cache[i].blk == blk && atomic_test_bit(&vmu_cache[i].flags, VMU_BLK_VALID)) {
+            atomic_set_bit(&vmu_cache[i].flags, VMU_BLK_BUSY);
+            /* Recheck, eviction may have started before BUSY was set */
+            if (atomic_test_bit(&vmu_cache[i].flags, VMU_BLK_VALID)
+                && vmu_cache[i].port == port && vmu_cache[i].blk == blk) {
+                vmu_cache[i].last_use = ++vmu_use_cnt;
+                return &vmu_cache[i];
+            }
+            atomic_clear_bit(&vmu_cache[i].flags, VMU_BLK_BUSY);
+            break;
+        }
+    }
+    /* Miss, ask VMU task to load it while console retry */
+    atomic_set_bit(vmu_fetch[port], blk);
+    vTaskNotifyGiveFromISR(vmu_task_hdl, NULL);
+    return NULL;
+}
+
+static void IRAM_ATTR vmu_cache_put(struct vmu_blk *entry) {
+    atomic_clear_bit(&entry->flags, VMU_BLK_BUSY);
+}
+
+/* Invalidate and wait for ISR to be done with the entry */
+static void vmu_cache_release(struct vmu_blk *entry) {
+    atomic_clear_bit(&entry->flags, VMU_BLK_VALID);
+    while (atomic_test_bit(&entry->flags, VMU_BLK_BUSY));
+}
 
+static void vmu_blk_store(FILE *file, struct vmu_blk *entry) {
+    uint32_t tmp[VMU_BLK_SIZE / 4];
+
+    atomic_clear_bit(&entry->flags, VMU_BLK_DIRTY);
+    for (uint32_t i = 0; i < ARRAY_SIZE(tmp); i++) {
+        tmp[i] = __builtin_bswap32(entry->data32[i]);
+    }
+    fseek(file, entry->blk * VMU_BLK_SIZE, SEEK_SET);
+    fwrite(tmp, VMU_BLK_SIZE, 1, file);
+}
+
+static FILE *vmu_open(uint32_t port, const char *mode) {
+    char filename[32];
+    FILE *file;
+
+    sprintf(filename, VMU_FILE, port, vmu_bank[port]);
+    file = fopen(filename, mode);
+    if (file == NULL) {
+        printf("# %s: failed to open %s\n", __FUNCTION__, filename);
+    }
+    return file;
+}
+
+static void vmu_flush(uint32_t port) {
+    FILE *file = NULL;
+
+    for (uint32_t i = 0; i < VMU_CACHE_BLKS; i++) {
+        if (vmu_cache[i].port == port && atomic_test_bit(&vmu_cache[i].flags, VMU_BLK_DIRTY)) {
+            if (file == NULL) {
+                file = vmu_open(port, "rb+");
+                if (file == NULL) {
+                    return;
+                }
+            }
+            vmu_blk_store(file, &vmu_cache[i]);
+        }
+    }
+    if (file) {
+        fclose(file);
+    }
+}
+
+static void vmu_fetch_blk(uint32_t port, uint32_t blk) {
+    uint32_t tmp[VMU_BLK_SIZE / 4];
+    struct vmu_blk *entry = NULL;
+    FILE *file;
+
+    for (uint32_t i = 0; i < VMU_CACHE_BLKS; i++) {
+        if (vmu_cache[i].port == port && vmu_cache[i].blk == blk && atomic_test_bit(&vmu_cache[i].flags, VMU_BLK_VALID)) {
+            /* Already loaded */
+            return;
+        }
+    }
+    for (uint32_t i = 0; i < VMU_CACHE_BLKS; i++) {
+        if (!atomic_test_bit(&vmu_cache[i].flags, VMU_BLK_VALID)) {
+            entry = &vmu_cache[i];
+            break;
+        }
+        if (entry == NULL || (int32_t)(vmu_cache[i].last_use - entry->last_use) < 0) {
+            entry = &vmu_cache[i];
+        }
+    }
+
+    /* Evict LRU block, ISR can't write it past this point */
+    vmu_cache_release(entry);
+    if (atomic_test_bit(&entry->flags, VMU_BLK_DIRTY)) {
+        file = vmu_open(entry->port, "rb+");
+        if (file == NULL) {
+            atomic_set_bit(&entry->flags, VMU_BLK_VALID);
+            return;
+        }
+        vmu_blk_store(file, entry);
+        fclose(file);
+    }
+
+    file = vmu_open(port, "rb");
+    if (file == NULL) {
+        return;
+    }
+    fseek(file, blk * VMU_BLK_SIZE, SEEK_SET);
+    fread(tmp, VMU_BLK_SIZE, 1, file);
+    fclose(file);
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(tmp); i++) {
+        entry->data32[i] = __builtin_bswap32(tmp[i]);
+    }
+    entry->port = port;
+    entry->blk = blk;
+    entry->last_use = vmu_use_cnt;
+    atomic_set_bit(&entry->flags, VMU_BLK_VALID);
+}
+
+static void vmu_bank_select(uint32_t port, int32_t bank) {
+    FILE *file;
+
+    for (uint32_t i = 0; i < VMU_CACHE_BLKS; i++) {
+        if (vmu_cache[i].port == port && atomic_test_bit(&vmu_cache[i].flags, VMU_BLK_VALID)) {
+            vmu_cache_release(&vmu_cache[i]);
+        }
+    }
+    if (vmu_bank[port] >= 0) {
+        vmu_flush(port);
+    }
+    vmu_bank[port] = bank;
+
+    file = vmu_open(port, "rb");
+    if (file) {
+        fclose(file);
+    }
+    else {
+        uint32_t blank[VMU_BLK_SIZE / 4] = {0};
+
+        printf("# %s: Creating port %d bank %d image\n", __FUNCTION__, port, bank);
+        file = vmu_open(port, "wb");
+        if (file) {
+            for (uint32_t i = 0; i < VMU_BLK_CNT; i++) {
+                fwrite(blank, VMU_BLK_SIZE, 1, file);
+            }
+            fclose(file);
+        }
+    }
+}
+
+/* Cache is only allocated once a port is configured with a VMU */
+static void vmu_cache_init(void) {
+    struct vmu_blk *cache;
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(vmu_bank); i++) {
+        if (config.out_cfg[i].acc_mode & ACC_MEM) {
+            cache = calloc(VMU_CACHE_BLKS, sizeof(*cache));
+            if (cache == NULL) {
+                printf("# %s: failed to alloc VMU cache\n", __FUNCTION__);
+            }
+            vmu_cache = cache;
+            return;
+        }
+    }
+}
+
+/* Own all VMU SD access: bank select, block fetch on ISR miss and write-back */
+static void vmu_task(void *arg) {
+    uint32_t save;
+
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, 1000 / portTICK_PERIOD_MS);
+        if (vmu_cache == NULL) {
+            vmu_cache_init();
+            if (vmu_cache == NULL) {
+                continue;
+            }
+        }
+        save = 0;
+        for (uint32_t i = 0; i < ARRAY_SIZE(vmu_bank); i++) {
+            if ((config.out_cfg[i].acc_mode & ACC_MEM) && vmu_bank[i] != config.mem_bank[i]) {
+                vmu_bank_select(i, config.mem_bank[i]);
+            }
+            if (vmu_bank[i] >= 0) {
+                for (uint32_t j = 0; j < VMU_BLK_CNT; j++) {
+                    if (atomic_test_and_clear_bit(vmu_fetch[i], j)) {
+                        vmu_fetch_blk(i, j);
+                    }
+                }
+            }
+            if (atomic_test_and_clear_bit(&wired_adapter.data[i].flags, WIRED_SAVE_MEM)) {
+                save = 1;
+            }
+        }
+        if (save) {
+            for (uint32_t i = 0; i < ARRAY_SIZE(vmu_bank); i++) {
+                if (vmu_bank[i] >= 0) {
+                    vmu_flush(i);
+                }
+            }
+        }
+    }
+}
+
+/* Realign frame if start bits were lost and validate CRC over whole frame */
+static uint32_t IRAM_ATTR maple_rx_frame(uint8_t *data, uint32_t bit_cnt) {
+    uint32_t len, size, shift;
+    uint32_t ret = MAPLE_RX_GOOD;
+    uint8_t crc = 0;
+
+    /* At least header and CRC minus up to 8 lost bits, plus end sequence bit */
+    if (bit_cnt < 33 || bit_cnt > sizeof(pkt) * 8 + 1) {
+        return MAPLE_RX_DROPPED;
+    }
+    len = ((bit_cnt - 1) / 32) - 1;
+    size = len * 4 + 5;
+    shift = (bit_cnt - 1) % 8;
+
+    /* Up to 7 bits loss */
+    if (shift) {
+        for (uint32_t i = size - 1; i; --i) {
+            data[i] = maple_fix_byte(shift, data[i - 1], data[i]);
+        }
+        data[0] = len;
+        ret = MAPLE_RX_REPAIRED;
+    }
+    /* 8 bits loss */
+    else if (data[0] != len) {
+        memmove(data + 1, data, size - 1);
+        data[0] = len;
+        ret = MAPLE_RX_REPAIRED;
+    }
+
+    for (uint32_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+    }
+    if (crc) {
+        return MAPLE_RX_DROPPED;
+    }
+    return ret;
+}
+
+/* Handle a captured frame, frames failing CRC get no response and console retry */
+static void IRAM_ATTR maple_rx_pkt(uint32_t port, uint32_t maple0, uint32_t maple1, uint32_t bit_cnt) {
+    uint8_t cmd, src, dst;
+
+    switch (maple_rx_frame(pkt.data, bit_cnt)) {
+        case MAPLE_RX_GOOD:
+            ++wired_adapter.rx_stats[port].good;
+            break;
+        case MAPLE_RX_REPAIRED:
+            ++wired_adapter.rx_stats[port].repaired;
+            break;
+        default:
+            ++wired_adapter.rx_stats[port].dropped;
+            return;
+    }
+    cmd = pkt.cmd;
+    src = pkt.dst;
+    dst = pkt.src;
+    switch(src & ADDR_MASK) {
+        case ADDR_CTRL:
+            pkt.src = src;
+            if (config.out_cfg[port].acc_mode & ACC_RUMBLE) {
+                pkt.src |= ADDR_RUMBLE;
+            }
+            if (vmu_cache && (config.out_cfg[port].acc_mode & ACC_MEM)) {
+                pkt.src |= ADDR_MEM;
+            }
+            pkt.dst = dst;
+            switch (cmd) {
+                case CMD_INFO_REQ:
+                    pkt.len = 28;
+                    pkt.cmd = CMD_INFO_RSP;
+                    pkt.data32[0] = ID_CTRL;
+                    pkt.data32[1] = DESC_CTRL_ALT;
+                    pkt.data32[2] = 0;
+                    pkt.data32[3] = 0;
+                    memcpy((void *)&pkt.data32[4], ctrl_area_dir_name, sizeof(ctrl_area_dir_name));
+                    memcpy((void *)&pkt.data32[12], brand, sizeof(brand));
+                    pkt.data32[27] = 0xF401;
+                    pkt.data32[27] |= 0xAE01 << 16;
+                    maple_tx(port, maple0, maple1, pkt.data, pkt.len * 4 + 5);
+                    break;
+                case CMD_GET_CONDITION:
+                {
+                    struct maple_cond_pkt rsp;
+                    uint8_t crc = 0;
+
+                    /* TX take longer than a publish, send a copy */
+                    for (uint32_t i = 0; i < WIRED_FRAME_READ_TRY; i++) {
+                        uint32_t seq = wired_frame_read_begin(&wired_adapter.data[port]);
+                        memcpy((void *)&rsp, (void *)&cond_rsp[port][seq & 0x1], sizeof(rsp));
+                        crc = cond_crc[port][seq & 0x1];
+                        if (!wired_frame_read_retry(&wired_adapter.data[port], seq)) {
+                            break;
+                        }
+                    }
+                    rsp.src = pkt.src;
+                    rsp.dst = pkt.dst;
+                    rsp.crc = crc ^ pkt.src ^ pkt.dst;
+                    maple_tx_raw(port, maple0, maple1, (uint8_t *)&rsp, sizeof(rsp));
+                    ++wired_adapter.data[port].frame_cnt;
+                    adapter_latency_record(port, esp_timer_get_time());
+
+                    ++poll_after_mem_wr[port];
+                    if (vmu_mem_change[port] && poll_after_mem_wr[port] > VMU_SAVE_POLL_DELAY) {
+                        atomic_set_bit(&wired_adapter.data[port].flags, WIRED_SAVE_MEM);
+                        vmu_mem_change[port] = 0;
+                        vTaskNotifyGiveFromISR(vmu_task_hdl, NULL);
+                    }
+                    break;
+                }
+                default:
+                    ets_printf("%02X: Unk cmd: 0x%02X\n", dst, cmd);
+                    break;
+            }
+            break;
+        case ADDR_MEM:
+            pkt.src = src;
+            pkt.dst = dst;
+            if (vmu_cache == NULL) {
+                break;
+            }
+            switch (cmd) {
+                case CMD_INFO_REQ:
+                    pkt.len = 28;
+                    pkt.cmd = CMD_INFO_RSP;
+                    pkt.data32[0] = ID_VMU_MEM;
+                    pkt.data32[1] = DESC_VMU_MEM;
+                    pkt.data32[2] = 0;
+                    pkt.data32[3] = 0;
+                    memcpy((void *)&pkt.data32[4], vmu_area_dir_name, sizeof(vmu_area_dir_name));
+                    memcpy((void *)&pkt.data32[12], brand, sizeof(brand));
+                    pkt.data32[27] = 0x8200;
+                    pkt.data32[27] |= 0x7C00 << 16;
+                    maple_tx(port, maple0, maple1, pkt.data, pkt.len * 4 + 5);
+                    break;
+                case CMD_MEM_INFO_REQ:
+                    pkt.len = 1 + ARRAY_SIZE(vmu_mem_info);
+                    pkt.cmd = CMD_DATA_TX;
+                    pkt.data32[0] = ID_VMU_MEM;
+                    memcpy((void *)&pkt.data32[1], vmu_mem_info, sizeof(vmu_mem_info));
+                    maple_tx(port, maple0, maple1, pkt.data, pkt.len * 4 + 5);
+                    break;
+                case CMD_BLOCK_READ:
+                {
+                    /* Location: partition, phase, block */
+                    uint32_t blk = pkt.data32[1] & 0xFFFF;
+                    struct vmu_blk *entry;
+
+                    if (blk >= VMU_BLK_CNT) {
+                        pkt.len = 0x00;
+                        pkt.cmd = CMD_FILE_ERR;
+                    }
+                    else if ((entry = vmu_cache_get(port, blk))) {
+                        pkt.len = 2 + ARRAY_SIZE(entry->data32);
+                        pkt.cmd = CMD_DATA_TX;
+                        pkt.data32[0] = ID_VMU_MEM;
+                        memcpy((void *)&pkt.data32[2], entry->data32, sizeof(entry->data32));
+                        vmu_cache_put(entry);
+                    }
+                    else {
+                        pkt.len = 0x00;
+                        pkt.cmd = CMD_REQ_RESEND;
+                    }
+                    maple_tx(port, maple0, maple1, pkt.data, pkt.len * 4 + 5);
+                    break;
+                }
+                case CMD_BLOCK_WRITE:
+                {
+                    uint32_t blk = pkt.data32[1] & 0xFFFF;
+                    uint32_t phase = (pkt.data32[1] >> 16) & 0xFF;
+                    struct vmu_blk *entry;
+
+                    if (blk >= VMU_BLK_CNT || phase >= VMU_BLK_SIZE / VMU_PHASE_SIZE) {
+                        pkt.cmd = CMD_FILE_ERR;
+                    }
+                    else if ((entry = vmu_cache_get(port, blk))) {
+                        memcpy((void *)entry->data32 + phase * VMU_PHASE_SIZE, (void *)&pkt.data32[2], VMU_PHASE_SIZE);
+                        atomic_set_bit(&entry->flags, VMU_BLK_DIRTY);
+                        vmu_cache_put(entry);
+                        poll_after_mem_wr[port] = 0;
+                        vmu_mem_change[port] = 1;
+                        pkt.cmd = CMD_ACK;
+                    }
+                    else {
+                        pkt.cmd = CMD_REQ_RESEND;
+                    }
+                    pkt.len = 0x00;
+                    maple_tx(port, maple0, maple1, pkt.data, pkt.len * 4 + 5);
+                    break;
+                }
+                case CMD_GET_LAST_ERR:
+                    pkt.len = 0x00;
+                    pkt.cmd = CMD_ACK;
+                    maple_tx(port, maple0, maple1, pkt.data, pkt.len * 4 + 5);
+                    break;
+                default:
+                    ets_printf("%02X: Unk cmd: 0x%02X\n", dst, cmd);
+                    break;
+            }
+            break;
+        case ADDR_RUMBLE:
+            pkt.src = src;
+            pkt.dst = dst;
+            switch (cmd) {
+                case CMD_INFO_REQ:
+                    pkt.len = 28;
+                    pkt.cmd = CMD_INFO_RSP;
+                    pkt.data32[0] = ID_RUMBLE;
+                    pkt.data32[1] = DESC_RUMBLE;
+                    pkt.data32[2] = 0;
+                    pkt.data32[3] = 0;
+                    memcpy((void *)&pkt.data32[4], rumble_area_dir_name, sizeof(rumble_area_dir_name));
+                    memcpy((void *)&pkt.data32[12], brand, sizeof(brand));
+                    pkt.data32[27] = 0x4006;
+                    pkt.data32[27] |= 0xC800 << 16;
+                    maple_tx(port, maple0, maple1, pkt.data, pkt.len * 4 + 5);
+                    break;
+                case CMD_GET_CONDITION:
+                case CMD_MEM_INFO_REQ:
+                    pkt.len = 0x02;
+                    pkt.cmd = CMD_DATA_TX;
+                    pkt.data32[0] = ID_RUMBLE;
+                    pkt.data32[1] = rumble_val;
+                    maple_tx(port, maple0, maple1, pkt.data, pkt.len * 4 + 5);
+                    break;
+                case CMD_BLOCK_READ:
+                    pkt.len = 0x03;
+                    pkt.cmd = CMD_DATA_TX;
+                    pkt.data32[0] = ID_RUMBLE;
+                    pkt.data32[1] = 0;
+                    pkt.data32[2] = rumble_max;
+                    maple_tx(port, maple0, maple1, pkt.data, pkt.len * 4 + 5);
+                    break;
+                case CMD_BLOCK_WRITE:
+                    pkt.len = 0x00;
+                    pkt.cmd = CMD_ACK;
+                    maple_tx(port, maple0, maple1, pkt.data, pkt.len * 4 + 5);
+                    rumble_max = pkt.data32[2];
+                    break;
+                case CMD_SET_CONDITION:
+                    pkt.len = 0x00;
+                    pkt.cmd = CMD_ACK;
+                    maple_tx(port, maple0, maple1, pkt.data, pkt.len * 4 + 5);
+                    rumble_val = pkt.data32[1];
+                    if (config.out_cfg[port].acc_mode & ACC_RUMBLE) {
+                        pkt.data[3] = port;
+                        *(uint32_t *)&pkt.data[4] = rumble_max;
+                        adapter_q_fb(pkt.data + 3, 9);
+                    }
+                    break;
+                default:
+                    ets_printf("%02X: Unk cmd: 0x%02X\n", dst, cmd);
+                    break;
+            }
+            break;
+    }
+}
+
+/* TODO Capture still polls GPIO.in with the other core stalled for the whole
+ * frame. Sample both lines into a DMA buffer (I2S0 RX or chunked RMT RX) and
+ * decode the edges afterward so the stall can go away.
+ */
 static void IRAM_ATTR maple_rx(void* arg)
 {
     const uint32_t maple0 = GPIO.acpu_int;
@@ -264,13 +1025,12 @@ static void IRAM_ATTR maple_rx(void* arg)
     uint8_t *data = pkt.data;
 #ifdef WIRED_TRACE
     uint32_t byte;
-#endif
-    uint32_t port;
     uint32_t bad_frame;
-    uint8_t len, cmd, src, dst, crc = 0;
+#endif
     uint32_t maple1;
 
     if (maple0) {
+        TRACE(TRACE_ISR_ENTRY, DC);
         DPORT_STALL_OTHER_CPU_START();
         maple1 = maple0_to_maple1[__builtin_ffs(maple0) - 1];
         while (1) {
@@ -299,16 +1059,13 @@ static void IRAM_ATTR maple_rx(void* arg)
                     *data &= ~mask;
                 }
             }
-            crc ^= *data;
             ++data;
         }
 maple_end:
         DPORT_STALL_OTHER_CPU_END();
 
-        port = pin_to_port[(__builtin_ffs(maple0) - 1)];
-        bad_frame = ((bit_cnt - 1) % 8);
-
 #ifdef WIRED_TRACE
+        bad_frame = ((bit_cnt - 1) % 8);
         ets_printf("%08X ", xthal_get_ccount());
         byte = ((bit_cnt - 1) / 8);
         if (bad_frame) {
@@ -324,122 +1081,11 @@ maple_end:
         }
         ets_printf("\n");
 #else
-        len = ((bit_cnt - 1) / 32) - 1;
-        /* Fix up to 7 bits loss */
-        if (bad_frame) {
-            cmd = maple_fix_byte(bad_frame, pkt.data[2], pkt.data[3]);
-            src = maple_fix_byte(bad_frame, pkt.data[1], pkt.data[2]);
-            dst = maple_fix_byte(bad_frame, pkt.data[0], pkt.data[1]);
-        }
-        /* Fix 8 bits loss */
-        else if (pkt.len != len) {
-            cmd = pkt.data[2];
-            src = pkt.data[1];
-            dst = pkt.data[0];
-            bad_frame = 1;
-        }
-        else {
-            cmd = pkt.cmd;
-            src = pkt.dst;
-            dst = pkt.src;
-        }
-        switch(src & ADDR_MASK) {
-            case ADDR_CTRL:
-                pkt.src = src;
-                if (config.out_cfg[port].acc_mode & ACC_RUMBLE) {
-                    pkt.src |= ADDR_RUMBLE;
-                }
-                pkt.dst = dst;
-                switch (cmd) {
-                    case CMD_INFO_REQ:
-                        pkt.len = 28;
-                        pkt.cmd = CMD_INFO_RSP;
-                        pkt.data32[0] = ID_CTRL;
-                        pkt.data32[1] = DESC_CTRL_ALT;
-                        pkt.data32[2] = 0;
-                        pkt.data32[3] = 0;
-                        memcpy((void *)&pkt.data32[4], ctrl_area_dir_name, sizeof(ctrl_area_dir_name));
-                        memcpy((void *)&pkt.data32[12], brand, sizeof(brand));
-                        pkt.data32[27] = 0xF401;
-                        pkt.data32[27] |= 0xAE01 << 16;
-                        maple_tx(port, maple0, maple1, pkt.data, pkt.len * 4 + 5);
-                        break;
-                    case CMD_GET_CONDITION:
-                        pkt.len = 3;
-                        pkt.cmd = CMD_DATA_TX;
-                        pkt.data32[0] = ID_CTRL;
-                        memcpy((void *)&pkt.data32[1], wired_adapter.data[port].output, sizeof(uint32_t) * 2);
-                        maple_tx(port, maple0, maple1, pkt.data, pkt.len * 4 + 5);
-                        ++wired_adapter.data[port].frame_cnt;
-                        break;
-                    default:
-                        ets_printf("%02X: Unk cmd: 0x%02X\n", dst, cmd);
-                        break;
-                }
-                break;
-            case ADDR_RUMBLE:
-                pkt.src = src;
-                pkt.dst = dst;
-                switch (cmd) {
-                    case CMD_INFO_REQ:
-                        pkt.len = 28;
-                        pkt.cmd = CMD_INFO_RSP;
-                        pkt.data32[0] = ID_RUMBLE;
-                        pkt.data32[1] = DESC_RUMBLE;
-                        pkt.data32[2] = 0;
-                        pkt.data32[3] = 0;
-                        memcpy((void *)&pkt.data32[4], rumble_area_dir_name, sizeof(rumble_area_dir_name));
-                        memcpy((void *)&pkt.data32[12], brand, sizeof(brand));
-                        pkt.data32[27] = 0x4006;
-                        pkt.data32[27] |= 0xC800 << 16;
-                        maple_tx(port, maple0, maple1, pkt.data, pkt.len * 4 + 5);
-                        break;
-                    case CMD_GET_CONDITION:
-                    case CMD_MEM_INFO_REQ:
-                        pkt.len = 0x02;
-                        pkt.cmd = CMD_DATA_TX;
-                        pkt.data32[0] = ID_RUMBLE;
-                        pkt.data32[1] = rumble_val;
-                        maple_tx(port, maple0, maple1, pkt.data, pkt.len * 4 + 5);
-                        break;
-                    case CMD_BLOCK_READ:
-                        pkt.len = 0x03;
-                        pkt.cmd = CMD_DATA_TX;
-                        pkt.data32[0] = ID_RUMBLE;
-                        pkt.data32[1] = 0;
-                        pkt.data32[2] = rumble_max;
-                        maple_tx(port, maple0, maple1, pkt.data, pkt.len * 4 + 5);
-                        break;
-                    case CMD_BLOCK_WRITE:
-                        pkt.len = 0x00;
-                        pkt.cmd = CMD_ACK;
-                        maple_tx(port, maple0, maple1, pkt.data, pkt.len * 4 + 5);
-                        if (!bad_frame) {
-                            rumble_max = pkt.data32[2];
-                        }
-                        break;
-                    case CMD_SET_CONDITION:
-                        pkt.len = 0x00;
-                        pkt.cmd = CMD_ACK;
-                        maple_tx(port, maple0, maple1, pkt.data, pkt.len * 4 + 5);
-                        if (!bad_frame) {
-                            rumble_val = pkt.data32[1];
-                            if (config.out_cfg[port].acc_mode & ACC_RUMBLE) {
-                                pkt.data[3] = port;
-                                *(uint32_t *)&pkt.data[4] = rumble_max;
-                                adapter_q_fb(pkt.data + 3, 9);
-                            }
-                        }
-                        break;
-                    default:
-                        ets_printf("%02X: Unk cmd: 0x%02X\n", dst, cmd);
-                        break;
-                }
-                break;
-        }
+        maple_rx_pkt(pin_to_port[(__builtin_ffs(maple0) - 1)], maple0, maple1, bit_cnt);
 #endif
 
         GPIO.status_w1tc = maple0;
+        TRACE(TRACE_ISR_EXIT, DC);
     }
 }
 
@@ -470,5 +1116,17 @@ void maple_init(void)
     GPIO.out_w1ts = DEBUG;
 #endif
 
+#ifdef MAPLE_TX_I2S
+    maple_i2s_init();
+#endif /* MAPLE_TX_I2S */
+
+    wired_adapter.frame_encode = maple_frame_encode;
+    for (uint32_t i = 0; i < ARRAY_SIZE(cond_rsp); i++) {
+        maple_frame_encode(i, 0);
+        maple_frame_encode(i, 1);
+    }
+
+    xTaskCreatePinnedToCore(vmu_task, "vmu_task", 4096, NULL, 5, &vmu_task_hdl, 0);
+
     esp_intr_alloc(ETS_GPIO_INTR_SOURCE, ESP_INTR_FLAG_LEVEL3, maple_rx, NULL, NULL);
 }
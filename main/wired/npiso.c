@@ -61,17 +61,18 @@ enum {
     DEV_SNES_XBAND_KB,
 };
 
-struct counters {
-    union {
-        uint32_t val;
-        struct {
-            uint8_t cnt[4];
-        };
-        struct {
-            uint16_t cnt_g0;
-            uint16_t cnt_g1;
-        };
-    };
+enum {
+    NPISO_SEL_HIGH = 0,
+    NPISO_SEL_LOW,
+    NPISO_SEL_MAX,
+};
+
+enum {
+    NPISO_MODE_FC_NES_2P = 0,
+    NPISO_MODE_FC_4P,
+    NPISO_MODE_NES_FS,
+    NPISO_MODE_SFC_SNES_2P,
+    NPISO_MODE_SFC_SNES_5P,
 };
 
 static const uint8_t gpio_pins[NPISO_PORT_MAX][NPISO_PIN_MAX] = {
@@ -88,244 +89,105 @@ static const uint32_t gpio_mask[NPISO_PORT_MAX][NPISO_PIN_MAX] = {
 
 static uint8_t dev_type[NPISO_PORT_MAX] = {0};
 static uint8_t mt_first_port[NPISO_PORT_MAX] = {0};
-static uint32_t cnt[2] = {0};
-static uint8_t mask[2] = {0x80, 0x80};
-static struct counters cnts = {0};
-static uint8_t *cnt0 = &cnts.cnt[0];
-static uint8_t *cnt1 = &cnts.cnt[1];
-static uint32_t idx0, idx1;
-
-static void IRAM_ATTR set_data(uint8_t port, uint8_t data_id, uint8_t value) {
-    uint8_t pin = gpio_pins[port][NPISO_D0 + data_id];
-
-    if (value) {
-        GPIO.out_w1ts = BIT(pin);
-    }
-    else {
-        GPIO.out_w1tc = BIT(pin);
-    }
+static uint8_t npiso_mode = NPISO_MODE_FC_NES_2P;
+/* D0/D1 GPIO mask driven by ISR, 0 if line unused in current mode */
+static uint32_t data_mask[NPISO_PORT_MAX][2] = {0};
+/* Serial words built by adapter core, MSB shifted out first */
+static uint32_t port_words[2][NPISO_PORT_MAX][NPISO_SEL_MAX][2] = {0};
+static atomic_t words_seq = ATOMIC_INIT(0);
+/* Words latched for current poll */
+static uint32_t shift_reg[NPISO_PORT_MAX][NPISO_SEL_MAX][2];
+static uint8_t sel_phase = NPISO_SEL_HIGH;
+
+static inline uint32_t npiso_snes_word(const uint8_t *frame) {
+    return ((uint32_t)frame[0] << 24) | ((uint32_t)frame[1] << 16);
 }
 
-static void IRAM_ATTR npiso_fc_nes_2p_isr(void* arg) {
-    const uint32_t low_io = GPIO.acpu_int;
-    const uint32_t high_io = GPIO.acpu_int1.intr;
+static void npiso_frame_encode(uint8_t wired_id, uint32_t idx) {
+    uint32_t seq = atomic_get(&words_seq) + 1;
+    uint32_t (*words)[NPISO_SEL_MAX][2] = port_words[seq & 0x1];
+    const uint8_t *dev[5];
 
-    /* reset bit counter, set first bit */
-    if (high_io & NPISO_LATCH_MASK) {
-        set_data(0, 0, wired_adapter.data[0].output[0] & 0x80);
-        set_data(1, 0, wired_adapter.data[1].output[0] & 0x80);
-        cnt[0] = 1;
-        cnt[1] = 1;
-        mask[0] = 0x40;
-        mask[1] = 0x40;
+    if (wired_id >= ARRAY_SIZE(dev)) {
+        return;
     }
 
-    /* Update port 0 */
-    if (low_io & P1_CLK_MASK) {
-        while (!(GPIO.in & P1_CLK_MASK)); /* Wait rising edge */
-        if (cnt[0] > 7) {
-            set_data(0, 0, 0);
-        }
-        else {
-            set_data(0, 0, wired_adapter.data[0].output[0] & mask[0]);
-        }
-        cnt[0]++;
-        mask[0] >>= 1;
+    for (uint32_t i = 0; i < ARRAY_SIZE(dev); i++) {
+        dev[i] = (i == wired_id) ? wired_adapter.data[i].frame[idx] : wired_frame(&wired_adapter.data[i]);
     }
 
-    /* Update port 1 */
-    if (low_io & P2_CLK_MASK) {
-        while (!(GPIO.in & P2_CLK_MASK)); /* Wait rising edge */
-        if (cnt[1] > 7) {
-            set_data(1, 0, 0);
-        }
-        else {
-            set_data(1, 0, wired_adapter.data[1].output[0] & mask[1]);
-        }
-        cnt[1]++;
-        mask[1] >>= 1;
+    memset(words, 0, sizeof(port_words[0]));
+    switch (npiso_mode) {
+        case NPISO_MODE_FC_NES_2P:
+            words[0][NPISO_SEL_HIGH][0] = (uint32_t)dev[0][0] << 24;
+            words[1][NPISO_SEL_HIGH][0] = (uint32_t)dev[1][0] << 24;
+            break;
+        case NPISO_MODE_FC_4P:
+            words[0][NPISO_SEL_HIGH][0] = (uint32_t)dev[0][0] << 24;
+            words[0][NPISO_SEL_HIGH][1] = (uint32_t)dev[2][0] << 24;
+            words[1][NPISO_SEL_HIGH][0] = (uint32_t)dev[1][0] << 24;
+            words[1][NPISO_SEL_HIGH][1] = (uint32_t)dev[3][0] << 24;
+            break;
+        case NPISO_MODE_NES_FS:
+            /* Four Score: 1st pad, 2nd pad, signature */
+            words[0][NPISO_SEL_HIGH][0] = ((uint32_t)dev[0][0] << 24) | ((uint32_t)dev[2][0] << 16) | (0xEF << 8);
+            words[1][NPISO_SEL_HIGH][0] = ((uint32_t)dev[1][0] << 24) | ((uint32_t)dev[3][0] << 16) | (0xDF << 8);
+            break;
+        case NPISO_MODE_SFC_SNES_2P:
+            words[0][NPISO_SEL_HIGH][0] = npiso_snes_word(dev[0]);
+            words[1][NPISO_SEL_HIGH][0] = npiso_snes_word(dev[1]);
+            break;
+        case NPISO_MODE_SFC_SNES_5P:
+            words[0][NPISO_SEL_HIGH][0] = npiso_snes_word(dev[0]);
+            /* 17th bit preload B of SEL low controllers for games reading too fast on SEL transition */
+            words[1][NPISO_SEL_HIGH][0] = npiso_snes_word(dev[1]) | ((dev[3][0] & 0x80) << 7);
+            words[1][NPISO_SEL_HIGH][1] = npiso_snes_word(dev[2]) | ((dev[4][0] & 0x80) << 7);
+            words[1][NPISO_SEL_LOW][0] = npiso_snes_word(dev[3]);
+            words[1][NPISO_SEL_LOW][1] = npiso_snes_word(dev[4]);
+            break;
     }
-
-    if (high_io) GPIO.status1_w1tc.intr_st = high_io;
-    if (low_io) GPIO.status_w1tc = low_io;
+    atomic_set(&words_seq, seq);
 }
 
-static void IRAM_ATTR npiso_fc_4p_isr(void* arg) {
-    const uint32_t low_io = GPIO.acpu_int;
-    const uint32_t high_io = GPIO.acpu_int1.intr;
-
-    /* reset bit counter, set first bit */
-    if (high_io & NPISO_LATCH_MASK) {
-        set_data(0, 0, wired_adapter.data[0].output[0] & 0x80);
-        set_data(1, 0, wired_adapter.data[1].output[0] & 0x80);
-        set_data(0, 1, wired_adapter.data[2].output[0] & 0x80);
-        set_data(1, 1, wired_adapter.data[3].output[0] & 0x80);
-        cnt[0] = 1;
-        cnt[1] = 1;
-        mask[0] = 0x40;
-        mask[1] = 0x40;
-    }
-
-    /* Update port 0 */
-    if (low_io & P1_CLK_MASK) {
-        while (!(GPIO.in & P1_CLK_MASK)); /* Wait rising edge */
-        if (cnt[0] > 7) {
-            set_data(0, 0, 0);
-            set_data(0, 1, 0);
-        }
-        else {
-            set_data(0, 0, wired_adapter.data[0].output[0] & mask[0]);
-            set_data(0, 1, wired_adapter.data[2].output[0] & mask[0]);
-        }
-        cnt[0]++;
-        mask[0] >>= 1;
-    }
-
-    /* Update port 1 */
-    if (low_io & P2_CLK_MASK) {
-        while (!(GPIO.in & P2_CLK_MASK)); /* Wait rising edge */
-        if (cnt[1] > 7) {
-            set_data(1, 0, 0);
-            set_data(1, 1, 0);
-        }
-        else {
-            set_data(1, 0, wired_adapter.data[1].output[0] & mask[1]);
-            set_data(1, 1, wired_adapter.data[3].output[0] & mask[1]);
-        }
-        cnt[1]++;
-        mask[1] >>= 1;
-    }
-
-    if (high_io) GPIO.status1_w1tc.intr_st = high_io;
-    if (low_io) GPIO.status_w1tc = low_io;
+static inline void IRAM_ATTR npiso_latch(void) {
+    memcpy(shift_reg, port_words[atomic_get(&words_seq) & 0x1], sizeof(shift_reg));
 }
 
-static void IRAM_ATTR npiso_nes_fs_isr(void* arg) {
-    const uint32_t low_io = GPIO.acpu_int;
-    const uint32_t high_io = GPIO.acpu_int1.intr;
-
-    /* reset bit counter, set first bit */
-    if (high_io & NPISO_LATCH_MASK) {
-        set_data(0, 0, wired_adapter.data[0].output[0] & 0x80);
-        set_data(1, 0, wired_adapter.data[1].output[0] & 0x80);
-        cnt[0] = 1;
-        cnt[1] = 1;
-        mask[0] = 0x40;
-        mask[1] = 0x40;
-    }
-
-    idx0 = cnt[0] >> 3;
-    idx1 = cnt[1] >> 3;
-
-    /* Update port 0 */
-    if (low_io & P1_CLK_MASK) {
-        while (!(GPIO.in & P1_CLK_MASK)); /* Wait rising edge */
-        switch (idx0) {
-            case 0:
-                set_data(0, 0, wired_adapter.data[0].output[0] & mask[0]);
-                break;
-            case 1:
-                set_data(0, 0, wired_adapter.data[2].output[0] & mask[0]);
-                break;
-            case 2:
-                set_data(0, 0, 0xEF & mask[0]);
-                break;
-            default:
-                set_data(0, 0, 0);
-                break;
-        }
-        cnt[0]++;
-        mask[0] >>= 1;
-        if (!mask[0]) {
-            mask[0] = 0x80;
-        }
-    }
+/* Return GPIO set mask for next bit of both data lines and shift */
+static inline uint32_t IRAM_ATTR npiso_next_bit(uint32_t port, uint32_t *sr) {
+    uint32_t set = (-(sr[0] >> 31) & data_mask[port][0]) | (-(sr[1] >> 31) & data_mask[port][1]);
 
-    /* Update port 1 */
-    if (low_io & P2_CLK_MASK) {
-        while (!(GPIO.in & P2_CLK_MASK)); /* Wait rising edge */
-        switch (idx1) {
-            case 0:
-                set_data(1, 0, wired_adapter.data[1].output[0] & mask[1]);
-                break;
-            case 1:
-                set_data(1, 0, wired_adapter.data[3].output[0] & mask[1]);
-                break;
-            case 2:
-                set_data(1, 0, 0xDF & mask[1]);
-                break;
-            default:
-                set_data(1, 0, 0);
-                break;
-        }
-        cnt[1]++;
-        mask[1] >>= 1;
-        if (!mask[1]) {
-            mask[1] = 0x80;
-        }
-    }
+    sr[0] <<= 1;
+    sr[1] <<= 1;
+    return set;
+}
 
-    if (high_io) GPIO.status1_w1tc.intr_st = high_io;
-    if (low_io) GPIO.status_w1tc = low_io;
+static inline void IRAM_ATTR npiso_set_data(uint32_t set, uint32_t mask) {
+    GPIO.out_w1ts = set;
+    GPIO.out_w1tc = set ^ mask;
 }
 
-static void IRAM_ATTR npiso_sfc_snes_2p_isr(void* arg) {
+static void IRAM_ATTR npiso_isr(void* arg) {
     const uint32_t low_io = GPIO.acpu_int;
     const uint32_t high_io = GPIO.acpu_int1.intr;
 
-    /* reset bit counter, set first bit */
+    /* Latch frame, set first bit */
     if (high_io & NPISO_LATCH_MASK) {
-        set_data(0, 0, wired_adapter.data[0].output[0] & 0x80);
-        set_data(1, 0, wired_adapter.data[1].output[0] & 0x80);
-        cnt[0] = 1;
-        cnt[1] = 1;
-        mask[0] = 0x40;
-        mask[1] = 0x40;
+        npiso_latch();
+        npiso_set_data(npiso_next_bit(0, shift_reg[0][NPISO_SEL_HIGH]) | npiso_next_bit(1, shift_reg[1][NPISO_SEL_HIGH]),
+            data_mask[0][0] | data_mask[0][1] | data_mask[1][0] | data_mask[1][1]);
     }
 
-    idx0 = cnt[0] >> 3;
-    idx1 = cnt[1] >> 3;
-
     /* Update port 0 */
     if (low_io & P1_CLK_MASK) {
         while (!(GPIO.in & P1_CLK_MASK)); /* Wait rising edge */
-        switch (idx0) {
-            case 0:
-                set_data(0, 0, wired_adapter.data[0].output[0] & mask[0]);
-                break;
-            case 1:
-                set_data(0, 0, wired_adapter.data[0].output[1] & mask[0]);
-                break;
-            default:
-                set_data(0, 0, 0);
-                break;
-        }
-        cnt[0]++;
-        mask[0] >>= 1;
-        if (!mask[0]) {
-            mask[0] = 0x80;
-        }
+        npiso_set_data(npiso_next_bit(0, shift_reg[0][NPISO_SEL_HIGH]), data_mask[0][0] | data_mask[0][1]);
     }
 
     /* Update port 1 */
     if (low_io & P2_CLK_MASK) {
         while (!(GPIO.in & P2_CLK_MASK)); /* Wait rising edge */
-        switch (idx1) {
-            case 0:
-                set_data(1, 0, wired_adapter.data[1].output[0] & mask[1]);
-                break;
-            case 1:
-                set_data(1, 0, wired_adapter.data[1].output[1] & mask[1]);
-                break;
-            default:
-                set_data(1, 0, 0);
-                break;
-        }
-        cnt[1]++;
-        mask[1] >>= 1;
-        if (!mask[1]) {
-            mask[1] = 0x80;
-        }
+        npiso_set_data(npiso_next_bit(1, shift_reg[1][NPISO_SEL_HIGH]), data_mask[1][0] | data_mask[1][1]);
     }
 
     if (high_io) GPIO.status1_w1tc.intr_st = high_io;
@@ -335,91 +197,44 @@ static void IRAM_ATTR npiso_sfc_snes_2p_isr(void* arg) {
 static void IRAM_ATTR npiso_sfc_snes_5p_isr(void* arg) {
     const uint32_t low_io = GPIO.acpu_int;
     const uint32_t high_io = GPIO.acpu_int1.intr;
+    const uint32_t p1_mask = data_mask[0][0];
+    const uint32_t p2_mask = data_mask[1][0] | data_mask[1][1];
 
-    /* reset bit counter, set first bit */
+    /* Latch frame, set first bit */
     if (high_io & NPISO_LATCH_MASK) {
+        uint32_t set, mask = p1_mask;
+
+        npiso_latch();
+        set = npiso_next_bit(0, shift_reg[0][NPISO_SEL_HIGH]);
         if (GPIO.in1.val & NPISO_LATCH_MASK) {
             if (GPIO.in & P2_SEL_MASK) {
-                //set_data(1, 0, 0);
-                set_data(1, 1, 0);
-            }
-        }
-        else {
-            if (GPIO.in & P2_SEL_MASK) {
-                set_data(1, 0, wired_adapter.data[1].output[0] & 0x80);
-                set_data(1, 1, wired_adapter.data[2].output[0] & 0x80);
-            }
-            else {
-                set_data(1, 0, wired_adapter.data[3].output[0] & 0x80);
-                set_data(1, 1, wired_adapter.data[4].output[0] & 0x80);
+                mask |= P2_D1_MASK;
             }
-            cnts.val = 0x01010101;
-            idx0 = 0;
-            idx1 = 0;
-            mask[0] = 0x40;
-            mask[1] = 0x40;
         }
+        /* Also help for games with very short latch that don't trigger falling edge intr */
         if (!(GPIO.in1.val & NPISO_LATCH_MASK)) {
-            /* Help for games with very short latch that don't trigger falling edge intr */
-            if (GPIO.in & P2_SEL_MASK) {
-                set_data(1, 0, wired_adapter.data[1].output[0] & 0x80);
-                set_data(1, 1, wired_adapter.data[2].output[0] & 0x80);
-            }
-            else {
-                set_data(1, 0, wired_adapter.data[3].output[0] & 0x80);
-                set_data(1, 1, wired_adapter.data[4].output[0] & 0x80);
-            }
-            cnts.val = 0x01010101;
-            idx0 = 0;
-            idx1 = 0;
-            mask[0] = 0x40;
-            mask[1] = 0x40;
+            sel_phase = (GPIO.in & P2_SEL_MASK) ? NPISO_SEL_HIGH : NPISO_SEL_LOW;
+            set |= npiso_next_bit(1, shift_reg[1][sel_phase]);
+            mask |= p2_mask;
         }
-        set_data(0, 0, wired_adapter.data[0].output[0] & 0x80);
+        npiso_set_data(set, mask);
     }
 
     if (low_io & P2_SEL_MASK) {
         if (GPIO.in & P2_SEL_MASK) {
-            //set_data(1, 0, wired_adapter.data[1].output[0] & 0x80);
-            //set_data(1, 1, wired_adapter.data[2].output[0] & 0x80);
-            cnt0 = &cnts.cnt[0];
-            cnt1 = &cnts.cnt[1];
+            sel_phase = NPISO_SEL_HIGH;
         }
         else {
-            set_data(1, 0, wired_adapter.data[3].output[0] & 0x80);
-            set_data(1, 1, wired_adapter.data[4].output[0] & 0x80);
-            cnt0 = &cnts.cnt[2];
-            cnt1 = &cnts.cnt[3];
+            sel_phase = NPISO_SEL_LOW;
+            npiso_set_data(npiso_next_bit(1, shift_reg[1][NPISO_SEL_LOW]), p2_mask);
         }
-        idx0 = *cnt0 >> 3;
-        idx1 = *cnt1 >> 3;
-        mask[0] = 0x40;
-        mask[1] = 0x40;
     }
 
     /* Update port 0 */
     if (!(GPIO.in1.val & NPISO_LATCH_MASK)) {
         if (low_io & P1_CLK_MASK) {
-            switch (idx0) {
-                case 0:
-                    while (!(GPIO.in & P1_CLK_MASK)); /* Wait rising edge */
-                    set_data(0, 0, wired_adapter.data[0].output[0] & mask[0]);
-                    break;
-                case 1:
-                    while (!(GPIO.in & P1_CLK_MASK)); /* Wait rising edge */
-                    set_data(0, 0, wired_adapter.data[0].output[1] & mask[0]);
-                    break;
-                default:
-                    while (!(GPIO.in & P1_CLK_MASK)); /* Wait rising edge */
-                    set_data(0, 0, 0);
-                    break;
-            }
-            (*cnt0)++;
-            idx0 = *cnt0 >> 3;
-            mask[0] >>= 1;
-            if (!mask[0]) {
-                mask[0] = 0x80;
-            }
+            while (!(GPIO.in & P1_CLK_MASK)); /* Wait rising edge */
+            npiso_set_data(npiso_next_bit(0, shift_reg[0][NPISO_SEL_HIGH]), p1_mask);
         }
     }
 
@@ -428,78 +243,18 @@ static void IRAM_ATTR npiso_sfc_snes_5p_isr(void* arg) {
         if (GPIO.in1.val & NPISO_LATCH_MASK) {
             /* P2-D0 load B when clocked while Latch is set. */
             while (!(GPIO.in & P2_CLK_MASK)); /* Wait rising edge */
-            set_data(1, 0, wired_adapter.data[1].output[0] & 0x80);
+            npiso_set_data(-(shift_reg[1][NPISO_SEL_HIGH][0] >> 31) & P2_D0_MASK, P2_D0_MASK);
         }
         else {
-            if (GPIO.in & P2_SEL_MASK) {
-                switch (idx1) {
-                    case 0:
-                        while (!(GPIO.in & P2_CLK_MASK)); /* Wait rising edge */
-                        set_data(1, 0, wired_adapter.data[1].output[0] & mask[1]);
-                        set_data(1, 1, wired_adapter.data[2].output[0] & mask[1]);
-                        break;
-                    case 1:
-                        while (!(GPIO.in & P2_CLK_MASK)); /* Wait rising edge */
-                        set_data(1, 0, wired_adapter.data[1].output[1] & mask[1]);
-                        set_data(1, 1, wired_adapter.data[2].output[1] & mask[1]);
-                        break;
-                    default:
-                        if (*cnt1 == 17) {
-                            /* Hack to help for games reading too fast on SEL transition */
-                            /* Set B following previous SEL controllers detection */
-                            while (!(GPIO.in & P2_CLK_MASK)); /* Wait rising edge */
-                            ets_delay_us(2);
-                            set_data(1, 0, wired_adapter.data[3].output[0] & 0x80);
-                            set_data(1, 1, wired_adapter.data[4].output[0] & 0x80);
-                        }
-                        else {
-                            while (!(GPIO.in & P2_CLK_MASK)); /* Wait rising edge */
-                            set_data(1, 0, 0);
-                            set_data(1, 1, 0);
-                        }
-                        break;
-                }
-            }
-            else {
-                switch (idx1) {
-                    case 0:
-                        while (!(GPIO.in & P2_CLK_MASK)); /* Wait rising edge */
-                        set_data(1, 0, wired_adapter.data[3].output[0] & mask[1]);
-                        set_data(1, 1, wired_adapter.data[4].output[0] & mask[1]);
-                        break;
-                    case 1:
-                        while (!(GPIO.in & P2_CLK_MASK)); /* Wait rising edge */
-                        set_data(1, 0, wired_adapter.data[3].output[1] & mask[1]);
-                        set_data(1, 1, wired_adapter.data[4].output[1] & mask[1]);
-                        break;
-                    default:
-                        //if (*cnt1 == 17) {
-                            /* Hack to help for games reading too fast on SEL transition */
-                            /* Set B following previous SEL controllers detection */
-                        //    set_data(1, 0, wired_adapter.data[1].output[0] & 0x80);
-                        //    set_data(1, 1, wired_adapter.data[2].output[0] & 0x80);
-                        //}
-                        //else {
-                            while (!(GPIO.in & P2_CLK_MASK)); /* Wait rising edge */
-                            set_data(1, 0, 0);
-                            set_data(1, 1, 0);
-                        //}
-                        break;
-                }
-            }
-            (*cnt1)++;
-            idx1 = *cnt1 >> 3;
-            mask[1] >>= 1;
-            if (!mask[1]) {
-                mask[1] = 0x80;
-            }
+            while (!(GPIO.in & P2_CLK_MASK)); /* Wait rising edge */
+            npiso_set_data(npiso_next_bit(1, shift_reg[1][sel_phase]), p2_mask);
         }
     }
 
     /* EA games Latch sometimes glitch and we can't detect 2nd rising */
     if (GPIO.in1.val & NPISO_LATCH_MASK) {
         if (GPIO.in & P2_SEL_MASK) {
-            set_data(1, 1, 0);
+            GPIO.out_w1tc = P2_D1_MASK;
         }
     }
 
@@ -626,25 +381,47 @@ void npiso_init(void)
             io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
             io_conf.pull_up_en = GPIO_PULLUP_ENABLE;
             gpio_config(&io_conf);
-            set_data(i, j &  0x1, 1);
+            GPIO.out_w1ts = BIT(gpio_pins[i][j]);
         }
     }
 
     if (dev_type[0] == DEV_FC_NES_MULTITAP) {
-        esp_intr_alloc(ETS_GPIO_INTR_SOURCE, ESP_INTR_FLAG_LEVEL3, npiso_nes_fs_isr, NULL, NULL);
+        npiso_mode = NPISO_MODE_NES_FS;
     }
     else if (dev_type[0] == DEV_FC_MULTITAP_ALT) {
-        esp_intr_alloc(ETS_GPIO_INTR_SOURCE, ESP_INTR_FLAG_LEVEL3, npiso_fc_4p_isr, NULL, NULL);
+        npiso_mode = NPISO_MODE_FC_4P;
     }
     else if (dev_type[0] == DEV_SFC_SNES_PAD && dev_type[1] == DEV_SFC_SNES_MULTITAP) {
+        npiso_mode = NPISO_MODE_SFC_SNES_5P;
+    }
+    else if (wired_adapter.system_id == NES) {
+        npiso_mode = NPISO_MODE_FC_NES_2P;
+    }
+    else {
+        npiso_mode = NPISO_MODE_SFC_SNES_2P;
+    }
+
+    for (uint32_t i = 0; i < NPISO_PORT_MAX; i++) {
+        data_mask[i][0] = BIT(gpio_pins[i][NPISO_D0]);
+    }
+    if (npiso_mode == NPISO_MODE_FC_4P) {
+        data_mask[0][1] = P1_D1_MASK;
+        data_mask[1][1] = P2_D1_MASK;
+    }
+    else if (npiso_mode == NPISO_MODE_SFC_SNES_5P) {
+        data_mask[1][1] = P2_D1_MASK;
+    }
+
+    /* Hook first so no frame published during init is missed */
+    wired_adapter.frame_encode = npiso_frame_encode;
+    for (uint32_t i = 0; i < 5; i++) {
+        npiso_frame_encode(i, atomic_get(&wired_adapter.data[i].frame_seq) & 0x1);
+    }
+
+    if (npiso_mode == NPISO_MODE_SFC_SNES_5P) {
         esp_intr_alloc(ETS_GPIO_INTR_SOURCE, ESP_INTR_FLAG_LEVEL3, npiso_sfc_snes_5p_isr, NULL, NULL);
     }
     else {
-        if (wired_adapter.system_id == NES) {
-            esp_intr_alloc(ETS_GPIO_INTR_SOURCE, ESP_INTR_FLAG_LEVEL3, npiso_fc_nes_2p_isr, NULL, NULL);
-        }
-        else {
-            esp_intr_alloc(ETS_GPIO_INTR_SOURCE, ESP_INTR_FLAG_LEVEL3, npiso_sfc_snes_2p_isr, NULL, NULL);
-        }
+        esp_intr_alloc(ETS_GPIO_INTR_SOURCE, ESP_INTR_FLAG_LEVEL3, npiso_isr, NULL, NULL);
     }
 }
@@ -3,9 +3,12 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
+#include <esp_timer.h>
 #include <driver/gpio.h>
 #include <driver/rmt.h>
 #include <driver/periph_ctrl.h>
@@ -15,6 +18,7 @@
 #include "../util.h"
 #include "../adapter/adapter.h"
 #include "../adapter/config.h"
+#include "../trace.h"
 #include "nsi.h"
 
 #define BIT_ZERO 0x80020006
@@ -23,6 +27,18 @@
 #define STOP_BIT_1US 0x80000002
 #define STOP_BIT_2US 0x80000004
 
+#define N64_FRAME_LEN 4
+#define GC_FRAME_LEN 8
+#define FRAME_ITEMS_MAX (GC_FRAME_LEN * 8 + 1)
+#define PAK_ITEMS ((32 + 1) * 8 + 1)
+
+#ifndef MEMPAK_FILE
+#define MEMPAK_FILE "/sd/mpk%d_%d.bin"
+#endif
+#define MEMPAK_SIZE (32 * 1024)
+#define MEMPAK_SECTOR_SIZE 512
+#define MEMPAK_SECTOR_CNT (MEMPAK_SIZE / MEMPAK_SECTOR_SIZE)
+
 #define N64_BIT_PERIOD_TICKS 8
 #define GC_BIT_PERIOD_TICKS 10
 
@@ -81,81 +97,246 @@ static const uint8_t gc_neutral[] = {
 };
 static volatile rmt_item32_t *rmt_items = RMTMEM.chan[0].data32;
 
-//uint8_t mempak[32 * 1024] = {0};
+/* Controller pak RAM image per port, NULL while not loaded */
+static uint8_t *mempak[4] = {0};
+static int32_t mempak_bank[4] = {-1, -1, -1, -1};
+static ATOMIC_DEFINE(mempak_dirty[4], MEMPAK_SECTOR_CNT);
+
+/* Responses pre-encoded outside the ISR, frame_items idx match wired frame idx */
+static uint32_t frame_items[4][2][FRAME_ITEMS_MAX] = {0};
+static uint32_t frame_len = N64_FRAME_LEN;
+static uint32_t gc_ident_items[sizeof(gc_ident) * 8 + 1] = {0};
+static uint32_t gc_neutral_items[sizeof(gc_neutral) * 8 + 1] = {0};
+static uint32_t rumble_ident_items[PAK_ITEMS] = {0};
+static uint32_t empty_items[PAK_ITEMS] = {0};
+
+/* RMT items for each nibble value, MSB first */
+static uint32_t nibble_items[16][4] = {0};
+/* CRC contribution of each nibble value for each nibble position in a 32 bytes block */
+static uint8_t nibble_crc[64][16] = {0};
 
 static atomic_t rmt_flags = 0;
 static uint8_t buf[128] = {0};
 static uint32_t poll_after_mem_wr = 0;
 static uint8_t last_rumble[4] = {0};
 
+
+static inline void IRAM_ATTR nsi_byte_to_items(volatile uint32_t *item_ptr, uint8_t byte) {
+    const uint32_t *hi = nibble_items[byte >> 4];
+    const uint32_t *lo = nibble_items[byte & 0xF];
+
+    item_ptr[0] = hi[0];
+    item_ptr[1] = hi[1];
+    item_ptr[2] = hi[2];
+    item_ptr[3] = hi[3];
+    item_ptr[4] = lo[0];
+    item_ptr[5] = lo[1];
+    item_ptr[6] = lo[2];
+    item_ptr[7] = lo[3];
+}
+
+static inline uint8_t IRAM_ATTR nsi_items_to_byte(volatile uint32_t *item_ptr) {
+    uint8_t byte = 0;
+
+    for (uint32_t i = 0; i < 8; i++) {
+        byte = (byte << 1) | ((item_ptr[i] & BIT_ONE_MASK) ? 1 : 0);
+    }
+    return byte;
+}
+
 static uint16_t IRAM_ATTR nsi_bytes_to_items_crc(uint32_t item, const uint8_t *data, uint32_t len, uint8_t *crc, uint32_t stop_bit) {
-    const uint8_t *crc_table = nsi_crc_table;
+    const uint8_t (*crc_table)[16] = nibble_crc;
     uint32_t bit_len = item + len * 8;
     volatile uint32_t *item_ptr = &rmt_items[item].val;
 
     *crc = 0xFF;
-    for (; item < bit_len; ++data) {
-        for (uint32_t mask = 0x80; mask; mask >>= 1) {
-            if (*data & mask) {
-                *crc ^= *crc_table;
-                *item_ptr = BIT_ONE;
-            }
-            else {
-                *item_ptr = BIT_ZERO;
-            }
-            ++crc_table;
-            ++item_ptr;
-            ++item;
-        }
+    for (; item < bit_len; ++data, crc_table += 2, item_ptr += 8, item += 8) {
+        nsi_byte_to_items(item_ptr, *data);
+        *crc ^= crc_table[0][*data >> 4] ^ crc_table[1][*data & 0xF];
     }
     *item_ptr = stop_bit;
     return item;
 }
 
+static uint32_t nsi_bytes_to_shadow_items(uint32_t *items, const uint8_t *data, uint32_t len, uint8_t *crc, uint32_t stop_bit) {
+    const uint8_t (*crc_table)[16] = nibble_crc;
+    uint32_t item = 0;
+
+    *crc = 0xFF;
+    for (; item < len * 8; ++data, crc_table += 2, item += 8) {
+        nsi_byte_to_items(items + item, *data);
+        *crc ^= crc_table[0][*data >> 4] ^ crc_table[1][*data & 0xF];
+    }
+    items[item] = stop_bit;
+    return item;
+}
+
+static void nsi_tables_init(void) {
+    for (uint32_t i = 0; i < 16; i++) {
+        for (uint32_t j = 0; j < 4; j++) {
+            nibble_items[i][j] = (i & (0x8 >> j)) ? BIT_ONE : BIT_ZERO;
+        }
+    }
+    for (uint32_t pos = 0; pos < ARRAY_SIZE(nibble_crc); pos++) {
+        for (uint32_t i = 0; i < 16; i++) {
+            nibble_crc[pos][i] = 0;
+            for (uint32_t j = 0; j < 4; j++) {
+                if (i & (0x8 >> j)) {
+                    nibble_crc[pos][i] ^= nsi_crc_table[pos * 4 + j];
+                }
+            }
+        }
+    }
+}
+
+static void nsi_pak_to_shadow_items(uint32_t *items, const uint8_t *data) {
+    uint8_t crc, tmp;
+    uint32_t item = nsi_bytes_to_shadow_items(items, data, 32, &crc, STOP_BIT_2US);
+
+    tmp = crc ^ 0xFF;
+    nsi_bytes_to_shadow_items(items + item, &tmp, 1, &crc, STOP_BIT_2US);
+}
+
+static void nsi_frame_encode(uint8_t wired_id, uint32_t idx) {
+    uint8_t crc;
+
+    if (wired_id < ARRAY_SIZE(gpio_pin)) {
+        nsi_bytes_to_shadow_items(frame_items[wired_id][idx], wired_adapter.data[wired_id].frame[idx], frame_len, &crc, STOP_BIT_2US);
+    }
+}
+
+static void IRAM_ATTR nsi_items_copy(uint32_t item, const uint32_t *items, uint32_t len) {
+    volatile uint32_t *item_ptr = &rmt_items[item].val;
+
+    for (const uint32_t *end = items + len; items < end; ++items, ++item_ptr) {
+        *item_ptr = *items;
+    }
+}
+
 static uint16_t IRAM_ATTR nsi_items_to_bytes(uint32_t item, uint8_t *data, uint32_t len) {
     uint32_t bit_len = item + len * 8;
     volatile uint32_t *item_ptr = &rmt_items[item].val;
 
-    for (; item < bit_len; ++data) {
-        do {
-            if (*item_ptr & BIT_ONE_MASK) {
-                *data = (*data << 1) + 1;
-            }
-            else {
-                *data <<= 1;
-            }
-            ++item_ptr;
-            ++item;
-        } while ((item % 8));
+    for (; item < bit_len; ++data, item_ptr += 8, item += 8) {
+        *data = nsi_items_to_byte(item_ptr);
     }
     return item;
 }
 
 static uint16_t IRAM_ATTR nsi_items_to_bytes_crc(uint32_t item, uint8_t *data, uint32_t len, uint8_t *crc) {
-    const uint8_t *crc_table = nsi_crc_table;
+    const uint8_t (*crc_table)[16] = nibble_crc;
     uint32_t bit_len = item + len * 8;
     volatile uint32_t *item_ptr = &rmt_items[item].val;
+    uint8_t byte;
 
     *crc = 0xFF;
-    for (; item < bit_len; ++data) {
-        do {
-            if (*item_ptr & BIT_ONE_MASK) {
-                *crc ^= *crc_table;
-            }
-            ++crc_table;
-            ++item_ptr;
-            ++item;
-        } while ((item % 8));
+    for (; item < bit_len; crc_table += 2, item_ptr += 8, item += 8) {
+        byte = nsi_items_to_byte(item_ptr);
+        *crc ^= crc_table[0][byte >> 4] ^ crc_table[1][byte & 0xF];
     }
     return item;
 }
 
+static void nsi_mempak_flush(uint32_t port) {
+    char filename[32];
+    FILE *file = NULL;
+
+    for (uint32_t i = 0; i < MEMPAK_SECTOR_CNT; i++) {
+        if (atomic_test_and_clear_bit(mempak_dirty[port], i)) {
+            if (file == NULL) {
+                sprintf(filename, MEMPAK_FILE, port, mempak_bank[port]);
+                file = fopen(filename, "rb+");
+                if (file == NULL) {
+                    printf("# %s: failed to open %s for writing\n", __FUNCTION__, filename);
+                    atomic_set_bit(mempak_dirty[port], i);
+                    return;
+                }
+            }
+            fseek(file, i * MEMPAK_SECTOR_SIZE, SEEK_SET);
+            fwrite(mempak[port] + i * MEMPAK_SECTOR_SIZE, MEMPAK_SECTOR_SIZE, 1, file);
+        }
+    }
+    if (file) {
+        fclose(file);
+    }
+}
+
+static void nsi_mempak_load(uint32_t port, int32_t bank) {
+    char filename[32];
+    uint8_t *pak = mempak[port];
+    FILE *file;
+
+    if (pak) {
+        nsi_mempak_flush(port);
+        /* Pak pulled while swapping bank */
+        mempak[port] = NULL;
+    }
+    else {
+        pak = malloc(MEMPAK_SIZE);
+        if (pak == NULL) {
+            printf("# %s: failed to alloc port %d pak\n", __FUNCTION__, port);
+            mempak_bank[port] = bank;
+            return;
+        }
+    }
+
+    sprintf(filename, MEMPAK_FILE, port, bank);
+    file = fopen(filename, "rb");
+    if (file == NULL) {
+        printf("# %s: No %s on SD. Creating...\n", __FUNCTION__, filename);
+        memset(pak, 0, MEMPAK_SIZE);
+        file = fopen(filename, "wb");
+        if (file == NULL) {
+            printf("# %s: failed to open %s for writing\n", __FUNCTION__, filename);
+        }
+        else {
+            fwrite(pak, MEMPAK_SIZE, 1, file);
+            fclose(file);
+        }
+    }
+    else {
+        fread(pak, MEMPAK_SIZE, 1, file);
+        fclose(file);
+    }
+
+    memset(mempak_dirty[port], 0, sizeof(mempak_dirty[port]));
+    mempak_bank[port] = bank;
+    mempak[port] = pak;
+}
+
+/* Load selected pak banks and write back dirty sectors once console stop writing */
+static void nsi_mempak_task(void *arg) {
+    uint32_t save;
+
+    while (1) {
+        save = 0;
+        for (uint32_t i = 0; i < ARRAY_SIZE(gpio_pin); i++) {
+            if (config.out_cfg[i].acc_mode == ACC_MEM && mempak_bank[i] != config.mem_bank[i]) {
+                nsi_mempak_load(i, config.mem_bank[i]);
+            }
+            if (atomic_test_and_clear_bit(&wired_adapter.data[i].flags, WIRED_SAVE_MEM)) {
+                save = 1;
+            }
+        }
+        if (save) {
+            for (uint32_t i = 0; i < ARRAY_SIZE(gpio_pin); i++) {
+                if (mempak[i]) {
+                    nsi_mempak_flush(i);
+                }
+            }
+        }
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
+    }
+}
+
 static void IRAM_ATTR n64_isr(void *arg) {
     const uint32_t intr_st = RMT.int_st.val;
     uint32_t status = intr_st;
     uint16_t item;
     uint8_t i, channel, crc;
 
+    TRACE(TRACE_ISR_ENTRY, N64);
+
     while (status) {
         i = __builtin_ffs(status) - 1;
         status &= ~(1 << i);
@@ -201,11 +382,17 @@ static void IRAM_ATTR n64_isr(void *arg) {
                         RMT.conf_ch[channel].conf1.tx_start = 1;
                         break;
                     case 0x01:
-                        memcpy(buf, wired_adapter.data[channel].output, 4);
-                        nsi_bytes_to_items_crc(channel * RMT_MEM_ITEM_NUM, buf, 4, &crc, STOP_BIT_2US);
+                        for (uint32_t i = 0; i < WIRED_FRAME_READ_TRY; i++) {
+                            uint32_t seq = wired_frame_read_begin(&wired_adapter.data[channel]);
+                            nsi_items_copy(channel * RMT_MEM_ITEM_NUM, frame_items[channel][seq & 0x1], N64_FRAME_LEN * 8 + 1);
+                            if (!wired_frame_read_retry(&wired_adapter.data[channel], seq)) {
+                                break;
+                            }
+                        }
                         RMT.conf_ch[channel].conf1.tx_start = 1;
 
                         ++wired_adapter.data[channel].frame_cnt;
+                        adapter_latency_record(channel, esp_timer_get_time());
                         ++poll_after_mem_wr;
                         if (atomic_test_bit(&rmt_flags, RMT_MEM_CHANGE) && poll_after_mem_wr > 3) {
                             if (!atomic_test_bit(&wired_adapter.data[channel].flags, WIRED_SAVE_MEM)) {
@@ -218,22 +405,30 @@ static void IRAM_ATTR n64_isr(void *arg) {
                         item = nsi_items_to_bytes(item, buf, 2);
                         if (buf[0] == 0x80 && buf[1] == 0x01) {
                             if (config.out_cfg[channel].acc_mode == ACC_RUMBLE) {
-                                item = nsi_bytes_to_items_crc(channel * RMT_MEM_ITEM_NUM, rumble_ident, 32, &crc, STOP_BIT_2US);
+                                nsi_items_copy(channel * RMT_MEM_ITEM_NUM, rumble_ident_items, PAK_ITEMS);
                             }
                             else {
-                                item = nsi_bytes_to_items_crc(channel * RMT_MEM_ITEM_NUM, empty, 32, &crc, STOP_BIT_2US);
+                                nsi_items_copy(channel * RMT_MEM_ITEM_NUM, empty_items, PAK_ITEMS);
                             }
                         }
                         else {
                             if (config.out_cfg[channel].acc_mode == ACC_RUMBLE) {
-                                item = nsi_bytes_to_items_crc(channel * RMT_MEM_ITEM_NUM, empty, 32, &crc, STOP_BIT_2US);
+                                nsi_items_copy(channel * RMT_MEM_ITEM_NUM, empty_items, PAK_ITEMS);
                             }
                             else {
-                                //item = nsi_bytes_to_items_crc(channel * RMT_MEM_ITEM_NUM, mempak + ((buf[0] << 8) | (buf[1] & 0xE0)), 32, &crc, STOP_BIT_2US);
+                                uint8_t *pak = mempak[channel];
+                                uint32_t addr = (buf[0] << 8) | (buf[1] & 0xE0);
+
+                                if (pak && addr < MEMPAK_SIZE) {
+                                    item = nsi_bytes_to_items_crc(channel * RMT_MEM_ITEM_NUM, pak + addr, 32, &crc, STOP_BIT_2US);
+                                    buf[0] = crc ^ 0xFF;
+                                    nsi_bytes_to_items_crc(item, buf, 1, &crc, STOP_BIT_2US);
+                                }
+                                else {
+                                    nsi_items_copy(channel * RMT_MEM_ITEM_NUM, empty_items, PAK_ITEMS);
+                                }
                             }
                         }
-                        buf[0] = crc ^ 0xFF;
-                        nsi_bytes_to_items_crc(item, buf, 1, &crc, STOP_BIT_2US);
                         RMT.conf_ch[channel].conf1.tx_start = 1;
                         break;
                     case 0x03:
@@ -252,9 +447,15 @@ static void IRAM_ATTR n64_isr(void *arg) {
                             }
                         }
                         else {
+                            uint8_t *pak = mempak[channel];
+                            uint32_t addr = (buf[0] << 8) | (buf[1] & 0xE0);
+
+                            if (pak && addr < MEMPAK_SIZE) {
+                                memcpy(pak + addr, buf + 2, 32);
+                                atomic_set_bit(mempak_dirty[channel], addr / MEMPAK_SECTOR_SIZE);
+                            }
                             poll_after_mem_wr = 0;
                             atomic_set_bit(&rmt_flags, RMT_MEM_CHANGE);
-                            //memcpy(mempak + ((buf[0] << 8) | (buf[1] & 0xE0)),  buf + 2, 32);
                         }
                         break;
                     default:
@@ -276,13 +477,17 @@ static void IRAM_ATTR n64_isr(void *arg) {
         }
     }
     RMT.int_clr.val = intr_st;
+    TRACE(TRACE_ISR_EXIT, N64);
 }
 
 static void IRAM_ATTR gc_isr(void *arg) {
     const uint32_t intr_st = RMT.int_st.val;
     uint32_t status = intr_st;
     uint16_t item;
-    uint8_t i, channel, port, crc;
+    uint32_t idx;
+    uint8_t i, channel, port;
+
+    TRACE(TRACE_ISR_ENTRY, GC);
 
     while (status) {
         i = __builtin_ffs(status) - 1;
@@ -309,12 +514,18 @@ static void IRAM_ATTR gc_isr(void *arg) {
                 switch (buf[0]) {
                     case 0x00:
                     case 0xFF:
-                        nsi_bytes_to_items_crc(channel * RMT_MEM_ITEM_NUM, gc_ident, sizeof(gc_ident), &crc, STOP_BIT_2US);
+                        nsi_items_copy(channel * RMT_MEM_ITEM_NUM, gc_ident_items, ARRAY_SIZE(gc_ident_items));
                         RMT.conf_ch[channel].conf1.tx_start = 1;
                         break;
                     case 0x40:
                         nsi_items_to_bytes(item, buf, 2);
-                        nsi_bytes_to_items_crc(channel * RMT_MEM_ITEM_NUM, wired_adapter.data[port].output, 8, &crc, STOP_BIT_2US);
+                        for (uint32_t i = 0; i < WIRED_FRAME_READ_TRY; i++) {
+                            uint32_t seq = wired_frame_read_begin(&wired_adapter.data[port]);
+                            nsi_items_copy(channel * RMT_MEM_ITEM_NUM, frame_items[port][seq & 0x1], GC_FRAME_LEN * 8 + 1);
+                            if (!wired_frame_read_retry(&wired_adapter.data[port], seq)) {
+                                break;
+                            }
+                        }
                         RMT.conf_ch[channel].conf1.tx_start = 1;
 
                         if (config.out_cfg[port].acc_mode == ACC_RUMBLE) {
@@ -328,12 +539,17 @@ static void IRAM_ATTR gc_isr(void *arg) {
                         }
 
                         ++wired_adapter.data[port].frame_cnt;
+                        adapter_latency_record(port, esp_timer_get_time());
                         break;
                     case 0x41:
                     case 0x42:
-                        nsi_bytes_to_items_crc(channel * RMT_MEM_ITEM_NUM, gc_neutral, sizeof(gc_neutral), &crc, STOP_BIT_2US);
+                        nsi_items_copy(channel * RMT_MEM_ITEM_NUM, gc_neutral_items, ARRAY_SIZE(gc_neutral_items));
                         RMT.conf_ch[channel].conf1.tx_start = 1;
-                        wired_adapter.data[port].output[0] &= ~0x20;
+                        idx = atomic_get(&wired_adapter.data[port].frame_seq) & 0x1;
+                        wired_adapter.data[port].frame[idx][0] &= ~0x20;
+                        /* Origin bit is 3rd bit sent */
+                        frame_items[port][idx][2] = BIT_ZERO;
+                        atomic_set_bit(&wired_adapter.data[port].flags, WIRED_ORIGIN_DONE);
                         break;
                     default:
                         /* Bad frame go back RX */
@@ -354,10 +570,26 @@ static void IRAM_ATTR gc_isr(void *arg) {
         }
     }
     RMT.int_clr.val = intr_st;
+    TRACE(TRACE_ISR_EXIT, GC);
 }
 
 void nsi_init(void) {
     uint32_t system = (wired_adapter.system_id == N64) ? 0 : 1;
+    uint8_t crc;
+
+    nsi_tables_init();
+    frame_len = (wired_adapter.system_id == N64) ? N64_FRAME_LEN : GC_FRAME_LEN;
+    nsi_bytes_to_shadow_items(gc_ident_items, gc_ident, sizeof(gc_ident), &crc, STOP_BIT_2US);
+    nsi_bytes_to_shadow_items(gc_neutral_items, gc_neutral, sizeof(gc_neutral), &crc, STOP_BIT_2US);
+    nsi_pak_to_shadow_items(rumble_ident_items, rumble_ident);
+    nsi_pak_to_shadow_items(empty_items, empty);
+
+    /* Hook first so no frame published during init is missed */
+    wired_adapter.frame_encode = nsi_frame_encode;
+    for (uint32_t i = 0; i < ARRAY_SIZE(gpio_pin); i++) {
+        nsi_frame_encode(i, 0);
+        nsi_frame_encode(i, 1);
+    }
 
     periph_module_enable(PERIPH_RMT_MODULE);
 
@@ -394,5 +626,10 @@ void nsi_init(void) {
     }
 
     rmt_isr_register(wired_adapter.system_id == N64 ? n64_isr : gc_isr, NULL, ESP_INTR_FLAG_LEVEL3, NULL);
+
+    if (wired_adapter.system_id == N64) {
+        xTaskCreatePinnedToCore(nsi_mempak_task, "nsi_mempak_task", 4096, NULL, 5, NULL, 0);
+    }
+
 }
 
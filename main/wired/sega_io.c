@@ -48,9 +48,26 @@
 #define ID2_SATURN_MOUSE 0xE
 #define ID2_NON_CONNECTION 0xF
 
-#define TWH_TIMEOUT 4096
 
 #define MT_PORT_MAX 6
+#define GEN_MT_PORT_MAX 4
+/* Multitap header and 6 analog pads */
+#define TWH_DATA_MAX (2 + MT_PORT_MAX * 7)
+/* 2 nibbles per byte, last upper nibble and ID0 1st nibble */
+#define TWH_NIBBLE_MAX (TWH_DATA_MAX * 2 + 2)
+#define TWH_TL 0x10
+
+#define TP_TYPE_3BTNS 0x0
+#define TP_TYPE_6BTNS 0x1
+#define TP_TYPE_MOUSE 0x2
+#define TP_TYPE_NONE 0xF
+
+#define EA_DETECT 0xFF
+
+#define MOUSE_X_SIGN BIT(0)
+#define MOUSE_Y_SIGN BIT(1)
+#define MOUSE_X_OVER BIT(2)
+#define MOUSE_Y_OVER BIT(3)
 enum {
     DEV_NONE = 0,
     DEV_GENESIS_3BTNS,
@@ -65,6 +82,29 @@ enum {
     DEV_EA_MULTITAP,
 };
 
+struct sio_masks {
+    uint32_t set;
+    uint32_t clr;
+    uint32_t set1;
+    uint32_t clr1;
+};
+
+/* Mouse motion nibbles patched when frame is latched */
+#define TWH_MOUSE_LEN 6
+struct twh_mouse {
+    uint8_t wired_id;
+    uint8_t ofs;
+    int32_t pos[2];
+};
+
+/* TH/TR/TL handshake nibbles with TL state in TWH_TL bit */
+struct twh_frame {
+    uint32_t len;
+    uint8_t nibbles[TWH_NIBBLE_MAX];
+    uint32_t mouse_cnt;
+    struct twh_mouse mice[GEN_MT_PORT_MAX];
+};
+
 static const uint8_t gpio_pin[2][7] = {
     {35, 27, 26, 23, 18,  5,  3},
     {36, 16, 33, 25, 22, 21, 19},
@@ -84,7 +124,27 @@ static uint8_t sel[2] = {0};
 static uint8_t dev_type[2] = {0};
 static uint8_t mt_dev_type[2][MT_PORT_MAX] = {0};
 static uint8_t mt_first_port[2] = {0};
-static uint8_t buffer[6*6];
+/* Output pins state per source wired_id & selection, idx match wired frame idx */
+static struct sio_masks sel_masks[GEN_MT_PORT_MAX + 1][2][ARRAY_SIZE(gen_cycle_mask)] = {0};
+/* EA 4-Way Play pad selected by port 2 TR & TL, EA_DETECT when TH high */
+static uint8_t ea_sel = 0;
+static struct sio_masks ea_detect_masks = {0};
+/* TL, R, L, D, U pins state per TWH nibble */
+static struct sio_masks twh_masks[2][32] = {0};
+static struct twh_frame twh_frames[2][2] = {0};
+static atomic_t twh_seq[2] = {0};
+/* Copy of published frame latched on TH falling, publishes can't touch it */
+static struct twh_frame twh_tx[2] = {0};
+/* Frame being sent, NULL when idle */
+static struct twh_frame *twh_tx_frame[2] = {0};
+static uint32_t twh_step[2] = {0};
+/* Next mouse of twh_tx to commit motion of */
+static uint32_t twh_mouse_next[2] = {0};
+/* Nibble set on TH falling and while TH high */
+static uint8_t twh_start[2] = {0};
+static uint8_t twh_idle[2] = {0};
+/* Mouse motion already sent to console, per wired_id */
+static int32_t mouse_sent[GEN_MT_PORT_MAX * 2][2] = {0};
 
 #if 0
 static uint8_t IRAM_ATTR get_id1(uint8_t val) {
@@ -106,13 +166,28 @@ static uint8_t IRAM_ATTR get_id1(uint8_t val) {
 }
 #endif
 
-static void IRAM_ATTR tx_nibble(uint8_t port, uint8_t data) {
-    for (uint8_t i = SIO_R, mask = 0x8; mask; mask >>= 1, i++) {
-        if (data & mask) {
-            GPIO.out_w1ts = BIT(gpio_pin[port][i]);
+/* Build GPIO set/clear masks for value MSB on first sio pin */
+static void sio_masks_build(struct sio_masks *masks, uint8_t port, uint8_t sio, uint8_t value, uint8_t mask) {
+    memset(masks, 0, sizeof(*masks));
+
+    for (; mask; mask >>= 1, sio++) {
+        uint8_t pin = gpio_pin[port][sio];
+
+        if (pin < 32) {
+            if (value & mask) {
+                masks->set |= BIT(pin);
+            }
+            else {
+                masks->clr |= BIT(pin);
+            }
         }
         else {
-            GPIO.out_w1tc = BIT(gpio_pin[port][i]);
+            if (value & mask) {
+                masks->set1 |= BIT(pin - 32);
+            }
+            else {
+                masks->clr1 |= BIT(pin - 32);
+            }
         }
     }
 }
@@ -138,139 +213,392 @@ static void IRAM_ATTR set_sio(uint8_t port, uint8_t sio, uint8_t value) {
     }
 }
 
-/* Genesis 3/6 buttons */
-static void IRAM_ATTR set_th_selection(uint8_t port) {
-    uint16_t input = *(uint16_t *)wired_adapter.data[port].output;
-    uint8_t value = 0;
+static const uint8_t *twh_src_frame(uint8_t src_port, uint8_t wired_id, uint32_t idx) {
+    if (src_port == wired_id) {
+        return wired_adapter.data[src_port].frame[idx];
+    }
+    return wired_frame(&wired_adapter.data[src_port]);
+}
+
+/* Saturn analog pad digital mode */
+static uint32_t twh_digital_pad(uint8_t *data, const uint8_t *frame) {
+    data[0] = (ID2_SATURN_PAD << 4) | 2;
+    memcpy(&data[1], frame, 2);
+    return 3;
+}
+
+/* Saturn analog pad */
+static uint32_t twh_analog_pad(uint8_t *data, const uint8_t *frame) {
+    data[0] = (ID2_SATURN_ANALOG_PAD << 4) | 6;
+    memcpy(&data[1], frame, 6);
+    return 7;
+}
+
+/* Saturn multitap */
+static uint32_t twh_saturn_multitap(uint8_t *buffer, uint8_t port, uint8_t wired_id, uint32_t idx) {
+    uint8_t *data = buffer;
+    *data++ = (ID2_SATURN_MULTITAP << 4) | 1;
+    *data++ = MT_PORT_MAX << 4;
 
-    for (uint8_t i = 0, mask = 0x01; i < ARRAY_SIZE(gen_cycle_mask[0]); i++, mask <<= 1) {
-        if ((gen_cycle_mask[sel[port]][i] & input) || gen_cycle_mask[sel[port]][i] == 0xFFFF) {
-            value |= mask;
+    for (uint32_t i = 0, j = mt_first_port[port]; i < MT_PORT_MAX; i++, j++) {
+        switch (mt_dev_type[port][i]) {
+            case DEV_SATURN_DIGITAL:
+            case DEV_SATURN_DIGITAL_TWH:
+                data += twh_digital_pad(data, twh_src_frame(j, wired_id, idx));
+                break;
+            case DEV_SATURN_ANALOG:
+                data += twh_analog_pad(data, twh_src_frame(j, wired_id, idx));
+                break;
         }
     }
+    return data - buffer;
+}
 
-    for (uint8_t i = SIO_TR, mask = 0x2; mask; mask >>= 1, i++) {
-        set_sio(port, i, value & mask);
+static uint32_t port_nb_dev(uint8_t port) {
+    switch (dev_type[port]) {
+        case DEV_SATURN_MULTITAP:
+            return MT_PORT_MAX;
+        case DEV_GENESIS_MULTITAP:
+        case DEV_EA_MULTITAP:
+            return GEN_MT_PORT_MAX;
+        default:
+            return 1;
     }
 }
 
-/* Saturn digital pad */
-static void IRAM_ATTR set_th_tr_selection(uint8_t port) {
-    uint8_t value = 0;
+/* Append nibble, TL low on even steps (TR falling) and high on odd ones (TR rising) */
+static void twh_put(struct twh_frame *frame, uint8_t nibble) {
+    frame->nibbles[frame->len] = ((frame->len & 0x1) ? TWH_TL : 0) | (nibble & 0xF);
+    frame->len++;
+}
 
-    switch (sel[port]) {
-        case 0x0:
-            value = wired_adapter.data[port].output[0] >> 4;
-            break;
-        case 0x1:
-            value = wired_adapter.data[port].output[0] & 0xF;
+/* Mega Mouse report, motion nibbles zeroed until frame is latched */
+static void twh_mouse(struct twh_frame *frame, uint8_t wired_id, const uint8_t *data) {
+    struct twh_mouse *mouse = &frame->mice[frame->mouse_cnt++];
+
+    mouse->wired_id = wired_id;
+    mouse->ofs = frame->len;
+    memcpy(mouse->pos, &data[1], sizeof(mouse->pos));
+
+    twh_put(frame, 0);
+    twh_put(frame, data[0]);
+    for (uint32_t i = 2; i < TWH_MOUSE_LEN; i++) {
+        twh_put(frame, 0);
+    }
+}
+
+/* Sega Team Player */
+static void twh_team_player(struct twh_frame *frame, uint8_t port, uint8_t wired_id, uint32_t idx) {
+    twh_put(frame, 0x0);
+    twh_put(frame, 0x0);
+
+    for (uint32_t i = 0; i < GEN_MT_PORT_MAX; i++) {
+        switch (mt_dev_type[port][i]) {
+            case DEV_GENESIS_3BTNS:
+                twh_put(frame, TP_TYPE_3BTNS);
+                break;
+            case DEV_GENESIS_6BTNS:
+                twh_put(frame, TP_TYPE_6BTNS);
+                break;
+            case DEV_GENESIS_MOUSE:
+                twh_put(frame, TP_TYPE_MOUSE);
+                break;
+            default:
+                twh_put(frame, TP_TYPE_NONE);
+                break;
+        }
+    }
+
+    for (uint32_t i = 0, j = mt_first_port[port]; i < GEN_MT_PORT_MAX; i++, j++) {
+        const uint8_t *data = twh_src_frame(j, wired_id, idx);
+        uint16_t input = *(uint16_t *)data;
+
+        switch (mt_dev_type[port][i]) {
+            case DEV_GENESIS_6BTNS:
+            case DEV_GENESIS_3BTNS:
+                /* R L D U, S A C B */
+                twh_put(frame, input >> 4);
+                twh_put(frame, input);
+                if (mt_dev_type[port][i] == DEV_GENESIS_6BTNS) {
+                    /* M X Y Z */
+                    twh_put(frame, input >> 12);
+                }
+                break;
+            case DEV_GENESIS_MOUSE:
+                twh_mouse(frame, j, data);
+                break;
+        }
+    }
+}
+
+static void twh_frame_encode(uint8_t port, uint8_t wired_id, uint32_t idx) {
+    uint32_t seq = atomic_get(&twh_seq[port]) + 1;
+    struct twh_frame *frame = &twh_frames[port][seq & 0x1];
+    uint8_t data[TWH_DATA_MAX];
+    uint32_t len = 0;
+
+    frame->len = 0;
+    frame->mouse_cnt = 0;
+
+    switch (dev_type[port]) {
+        case DEV_SATURN_DIGITAL_TWH:
+            len = twh_digital_pad(data, twh_src_frame(mt_first_port[port], wired_id, idx));
             break;
-        case 0x2:
-            value = wired_adapter.data[port].output[1] >> 4;
+        case DEV_SATURN_ANALOG:
+            len = twh_analog_pad(data, twh_src_frame(mt_first_port[port], wired_id, idx));
             break;
-        case 0x3:
-            value = (wired_adapter.data[port].output[1] & 0xF);
-            value &= 0xC;
+        case DEV_SATURN_MULTITAP:
+            len = twh_saturn_multitap(data, port, wired_id, idx);
             break;
+        case DEV_GENESIS_MULTITAP:
+            twh_team_player(frame, port, wired_id, idx);
+            goto end;
+        case DEV_GENESIS_MOUSE:
+            twh_put(frame, 0xF);
+            twh_put(frame, 0xF);
+            twh_mouse(frame, mt_first_port[port], twh_src_frame(mt_first_port[port], wired_id, idx));
+            goto end;
+        default:
+            return;
     }
-    tx_nibble(port, value);
-}
 
-/* Three-Wire Handshake */
-static void IRAM_ATTR twh_tx(uint8_t port, uint8_t id0, uint8_t *data, uint32_t len) {
-    uint32_t timeout = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        twh_put(frame, data[i] >> 4);
+        twh_put(frame, data[i]);
+    }
+    /* last upper nibble always 0 */
+    twh_put(frame, 0);
+    /* Set ID0 1st nibble */
+    twh_put(frame, ID0_SATURN_THREEWIRE_HANDSHAKE >> 4);
 
-    /* Set ID0 2nd nibble */
-    tx_nibble(port, id0 & 0xF);
+end:
+    atomic_set(&twh_seq[port], seq);
+}
 
-    /* TX data */
-    for (uint32_t i = 0; i < len; i++) {
-        timeout = 0;
-        while (GPIO.in & BIT(gpio_pin[port][SIO_TR]))
+static void sel_frame_encode(uint8_t port, uint8_t wired_id, uint32_t idx) {
+    const uint8_t *frame = wired_adapter.data[wired_id].frame[idx];
+    struct sio_masks *masks = sel_masks[wired_id][idx];
+
+    switch (dev_type[port]) {
+        /* Genesis 3/6 buttons */
+        case DEV_GENESIS_3BTNS:
+        case DEV_GENESIS_6BTNS:
+        case DEV_EA_MULTITAP:
         {
-            if (GPIO.in1.val & BIT(gpio_pin[port][SIO_TH] - 32) || timeout > TWH_TIMEOUT) {
-                goto end;
+            uint16_t input = *(uint16_t *)frame;
+
+            for (uint32_t j = 0; j < ARRAY_SIZE(gen_cycle_mask); j++) {
+                uint8_t value = 0;
+
+                for (uint8_t i = 0, mask = 0x01; i < ARRAY_SIZE(gen_cycle_mask[0]); i++, mask <<= 1) {
+                    if ((gen_cycle_mask[j][i] & input) || gen_cycle_mask[j][i] == 0xFFFF) {
+                        value |= mask;
+                    }
+                }
+                sio_masks_build(&masks[j], port, SIO_TR, value, 0x20);
             }
-            timeout++;
+            break;
         }
-        tx_nibble(port, data[i] >> 4);
-        set_sio(port, SIO_TL, 0);
+        /* Saturn digital pad */
+        case DEV_SATURN_DIGITAL:
+            sio_masks_build(&masks[0x0], port, SIO_R, frame[0] >> 4, 0x8);
+            sio_masks_build(&masks[0x1], port, SIO_R, frame[0] & 0xF, 0x8);
+            sio_masks_build(&masks[0x2], port, SIO_R, frame[1] >> 4, 0x8);
+            sio_masks_build(&masks[0x3], port, SIO_R, frame[1] & 0xC, 0x8);
+            break;
+    }
+}
 
-        timeout = 0;
-        while (!(GPIO.in & BIT(gpio_pin[port][SIO_TR])))
-        {
-            if (GPIO.in1.val & BIT(gpio_pin[port][SIO_TH] - 32) || timeout > TWH_TIMEOUT) {
-                goto end;
+static void sega_io_frame_encode(uint8_t wired_id, uint32_t idx) {
+    for (uint32_t i = 0; i < ARRAY_SIZE(gpio_pin); i++) {
+        if (wired_id >= mt_first_port[i] && wired_id < mt_first_port[i] + port_nb_dev(i)) {
+            switch (dev_type[i]) {
+                case DEV_GENESIS_3BTNS:
+                case DEV_GENESIS_6BTNS:
+                case DEV_SATURN_DIGITAL:
+                case DEV_EA_MULTITAP:
+                    /* EA 4-Way Play port 2 is select input only */
+                    if (i == 1 && dev_type[i] == DEV_EA_MULTITAP) {
+                        break;
+                    }
+                    if (wired_id < ARRAY_SIZE(sel_masks)) {
+                        sel_frame_encode(i, wired_id, idx);
+                    }
+                    break;
+                default:
+                    twh_frame_encode(i, wired_id, idx);
+                    break;
             }
-            timeout++;
         }
-        tx_nibble(port, data[i] & 0xF);
-        set_sio(port, SIO_TL, 1);
     }
+}
 
-    /* last upper nibble always 0 */
-    timeout = 0;
-    while (GPIO.in & BIT(gpio_pin[port][SIO_TR]))
-    {
-        if (GPIO.in1.val & BIT(gpio_pin[port][SIO_TH] - 32) || timeout > TWH_TIMEOUT) {
-            goto end;
-        }
-        timeout++;
+/* Genesis 3/6 buttons TH & Saturn digital pad TH/TR selection */
+static void IRAM_ATTR set_selection(uint8_t port) {
+    const struct sio_masks *masks = &ea_detect_masks;
+    uint32_t src = mt_first_port[port];
+
+    if (dev_type[port] == DEV_EA_MULTITAP) {
+        src = ea_sel;
+    }
+    if (src != EA_DETECT) {
+        masks = &sel_masks[src][atomic_get(&wired_adapter.data[src].frame_seq) & 0x1][sel[port]];
     }
-    tx_nibble(port, 0);
-    set_sio(port, SIO_TL, 0);
 
-    /* Set ID0 1st nibble */
-    timeout = 0;
-    while (!(GPIO.in & BIT(gpio_pin[port][SIO_TR])))
-    {
-        if (GPIO.in1.val & BIT(gpio_pin[port][SIO_TH] - 32) || timeout > TWH_TIMEOUT) {
-            goto end;
+    GPIO.out_w1ts = masks->set;
+    GPIO.out_w1tc = masks->clr;
+    if (masks->set1 | masks->clr1) {
+        GPIO.out1_w1ts.val = masks->set1;
+        GPIO.out1_w1tc.val = masks->clr1;
+    }
+}
+
+static void IRAM_ATTR twh_set(uint8_t port, uint8_t nibble) {
+    const struct sio_masks *masks = &twh_masks[port][nibble];
+
+    GPIO.out_w1ts = masks->set;
+    GPIO.out_w1tc = masks->clr;
+    if (masks->set1 | masks->clr1) {
+        GPIO.out1_w1ts.val = masks->set1;
+        GPIO.out1_w1tc.val = masks->clr1;
+    }
+}
+
+/* Latch published frame in port TX copy, retry if a publish moved seq */
+static void IRAM_ATTR twh_frame_copy(uint8_t port) {
+    struct twh_frame *tx = &twh_tx[port];
+
+    for (uint32_t i = 0; i < WIRED_FRAME_READ_TRY; i++) {
+        uint32_t seq = atomic_get(&twh_seq[port]);
+        const struct twh_frame *frame = &twh_frames[port][seq & 0x1];
+
+        tx->len = frame->len;
+        tx->mouse_cnt = frame->mouse_cnt;
+        memcpy(tx->nibbles, frame->nibbles, tx->len);
+        memcpy(tx->mice, frame->mice, tx->mouse_cnt * sizeof(tx->mice[0]));
+        if (atomic_get(&twh_seq[port]) == seq) {
+            break;
         }
-        timeout++;
     }
-end:
-    tx_nibble(port, id0 >> 4);
-    set_sio(port, SIO_TL, 1);
 }
 
-/* Saturn analog pad digital mode */
-static void IRAM_ATTR set_analog_digital_pad(uint8_t port, uint8_t src_port) {
-    buffer[0] = (ID2_SATURN_PAD << 4) | 2;
-    memcpy(&buffer[1], wired_adapter.data[src_port].output, 2);
-    twh_tx(port, ID0_SATURN_THREEWIRE_HANDSHAKE, buffer, 3);
+/* Set motion since last sent in latched frame, positions wrap so only
+ * differences are used. Position become the new base once read.
+ */
+static void IRAM_ATTR twh_mouse_latch(struct twh_frame *frame) {
+    for (uint32_t i = 0; i < frame->mouse_cnt; i++) {
+        struct twh_mouse *mouse = &frame->mice[i];
+        int32_t *sent = mouse_sent[mouse->wired_id];
+        uint8_t *nibble = &frame->nibbles[mouse->ofs];
+        uint8_t flags = 0;
+        int32_t delta[2];
+
+        for (uint32_t j = 0; j < 2; j++) {
+            delta[j] = (int32_t)((uint32_t)mouse->pos[j] - (uint32_t)sent[j]);
+            if (delta[j] > 255) {
+                delta[j] = 255;
+                flags |= MOUSE_X_OVER << j;
+            }
+            else if (delta[j] < -256) {
+                delta[j] = -256;
+                flags |= MOUSE_X_OVER << j;
+            }
+            if (delta[j] < 0) {
+                flags |= MOUSE_X_SIGN << j;
+            }
+        }
+
+        /* Keep TL bit, ofs + 1 is buttons */
+        nibble[0] = (nibble[0] & TWH_TL) | flags;
+        nibble[2] = (nibble[2] & TWH_TL) | ((delta[0] >> 4) & 0xF);
+        nibble[3] = (nibble[3] & TWH_TL) | (delta[0] & 0xF);
+        nibble[4] = (nibble[4] & TWH_TL) | ((delta[1] >> 4) & 0xF);
+        nibble[5] = (nibble[5] & TWH_TL) | (delta[1] & 0xF);
+    }
 }
 
-/* Saturn analog pad */
-static void IRAM_ATTR set_analog_pad(uint8_t port, uint8_t src_port) {
-    buffer[0] = (ID2_SATURN_ANALOG_PAD << 4) | 6;
-    memcpy(&buffer[1], wired_adapter.data[src_port].output, 6);
-    twh_tx(port, ID0_SATURN_THREEWIRE_HANDSHAKE, buffer, 7);
+/* Mouse motion is read once host ask the nibble after it or end a full
+ * read, commit mice ending before nibble end. Aborted reads send it again.
+ * Motion past overflow is dropped like on a real mouse.
+ */
+static void IRAM_ATTR twh_mouse_commit(uint8_t port, uint32_t end) {
+    struct twh_frame *frame = &twh_tx[port];
+
+    for (; twh_mouse_next[port] < frame->mouse_cnt; twh_mouse_next[port]++) {
+        struct twh_mouse *mouse = &frame->mice[twh_mouse_next[port]];
+
+        if (mouse->ofs + TWH_MOUSE_LEN > end) {
+            break;
+        }
+        mouse_sent[mouse->wired_id][0] = mouse->pos[0];
+        mouse_sent[mouse->wired_id][1] = mouse->pos[1];
+    }
 }
 
-/* Saturn multitap */
-static void IRAM_ATTR set_saturn_multitap(uint8_t port, uint8_t first_port, uint8_t nb_port) {
-    uint8_t *data = buffer;
-    *data++ = (ID2_SATURN_MULTITAP << 4) | 1;
-    *data++ = nb_port << 4;
+/* TH/TR/TL handshake, one nibble per TH or TR edge */
+static void IRAM_ATTR twh_edge(uint8_t port, uint32_t th_edge) {
+    struct twh_frame *frame;
+    uint32_t tr;
 
-    for (uint32_t i = 0, j = first_port; i < nb_port; i++, j++) {
-        switch (mt_dev_type[port][i]) {
-            case DEV_SATURN_DIGITAL:
-            case DEV_SATURN_DIGITAL_TWH:
-                *data++ = (ID2_SATURN_PAD << 4) | 2;
-                memcpy(data, wired_adapter.data[j].output, 2);
-                data += 2;
-                break;
-            case DEV_SATURN_ANALOG:
-                *data++ = (ID2_SATURN_ANALOG_PAD << 4) | 6;
-                memcpy(data, wired_adapter.data[j].output, 6);
-                data += 6;
-                break;
+    if (GPIO.in1.val & BIT(gpio_pin[port][SIO_TH] - 32)) {
+        /* Transfer ended or aborted by host */
+        if (twh_step[port] >= twh_tx[port].len) {
+            twh_mouse_commit(port, twh_tx[port].len);
         }
+        twh_tx_frame[port] = NULL;
+        twh_set(port, twh_idle[port]);
+        return;
+    }
+
+    if (th_edge) {
+        twh_set(port, twh_start[port]);
+        twh_frame_copy(port);
+        twh_mouse_latch(&twh_tx[port]);
+        twh_tx_frame[port] = &twh_tx[port];
+        twh_step[port] = 0;
+        twh_mouse_next[port] = 0;
     }
 
-    twh_tx(port, ID0_SATURN_THREEWIRE_HANDSHAKE, buffer, data - buffer);
+    frame = twh_tx_frame[port];
+    if (frame) {
+        /* Even steps wait TR low, odd ones TR high */
+        tr = (GPIO.in & BIT(gpio_pin[port][SIO_TR])) ? 1 : 0;
+        if (tr == (twh_step[port] & 0x1)) {
+            twh_set(port, frame->nibbles[twh_step[port]]);
+            twh_mouse_commit(port, twh_step[port]);
+            if (++twh_step[port] >= frame->len) {
+                twh_tx_frame[port] = NULL;
+            }
+        }
+    }
+}
+
+/* EA 4-Way Play, port 2 TH, TR & TL select pad reported on port 1 */
+static void IRAM_ATTR ea_select(void) {
+    if (GPIO.in1.val & BIT(gpio_pin[1][SIO_TH] - 32)) {
+        ea_sel = EA_DETECT;
+    }
+    else {
+        ea_sel = ((GPIO.in & BIT(gpio_pin[1][SIO_TR])) ? 0x2 : 0x0)
+            | ((GPIO.in1.val & BIT(gpio_pin[1][SIO_TL] - 32)) ? 0x1 : 0x0);
+    }
+    set_selection(0);
+}
+
+/* Genesis 3/6 buttons TH selection */
+static void IRAM_ATTR th_select(uint8_t port, uint8_t type, uint32_t cur, uint32_t last) {
+    if (type == DEV_GENESIS_6BTNS && sel[port] > 0 && ((cur - last)/CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ < 100)) {
+        if (sel[port] < ARRAY_SIZE(gen_cycle_mask) - 1) {
+            sel[port]++;
+        }
+    }
+    else if (GPIO.in1.val & BIT(gpio_pin[port][SIO_TH] - 32)) {
+        sel[port] = 1;
+    }
+    else {
+        sel[port] = 0;
+    }
+    set_selection(port);
 }
 
 static void IRAM_ATTR sega_io_isr(void* arg) {
@@ -278,79 +606,54 @@ static void IRAM_ATTR sega_io_isr(void* arg) {
     uint32_t cur = xthal_get_ccount();
     const uint32_t low_io = GPIO.acpu_int;
     const uint32_t high_io = GPIO.acpu_int1.intr;
-    uint8_t port = 0;
 
-    if (high_io & BIT(gpio_pin[0][SIO_TH] - 32)) {
-        port = 0;
-    }
-    else if (high_io & BIT(gpio_pin[1][SIO_TH] - 32)) {
-        port = 1;
-    }
-    else if (low_io & BIT(gpio_pin[0][SIO_TR])) {
-        port = 0;
-    }
-    else if (low_io & BIT(gpio_pin[1][SIO_TR])) {
-        port = 1;
-    }
+    for (uint8_t port = 0; port < ARRAY_SIZE(gpio_pin); port++) {
+        const uint32_t th_edge = high_io & BIT(gpio_pin[port][SIO_TH] - 32);
+        uint32_t edge = th_edge | (low_io & BIT(gpio_pin[port][SIO_TR]));
 
-    switch (dev_type[port]) {
-        case DEV_GENESIS_3BTNS:
-            if (GPIO.in1.val & BIT(gpio_pin[port][SIO_TH] - 32)) {
-                sel[port] = 1;
-            }
-            else {
-                sel[port] = 0;
-            }
-            set_th_selection(port);
-            break;
-        case DEV_GENESIS_6BTNS:
-            if (sel[port] > 0 && ((cur - last)/CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ < 100)) {
-                sel[port]++;
-            }
-            else if (GPIO.in1.val & BIT(gpio_pin[port][SIO_TH] - 32)) {
-                sel[port] = 1;
-            }
-            else {
-                sel[port] = 0;
-            }
-            set_th_selection(port);
-            break;
-        case DEV_GENESIS_MULTITAP:
-            break;
-        case DEV_GENESIS_MOUSE:
-            break;
-        case DEV_SATURN_DIGITAL:
-        {
-            uint8_t tmp = 0;
-            if (GPIO.in1.val & BIT(gpio_pin[port][SIO_TH] - 32)) {
-                tmp |= 0x1;
-            }
-            if (GPIO.in & BIT(gpio_pin[port][SIO_TR])) {
-                tmp |= 0x2;
-            }
-            sel[port] = tmp;
-            set_th_tr_selection(port);
-            break;
+        if (port == 1 && dev_type[port] == DEV_EA_MULTITAP) {
+            edge |= high_io & BIT(gpio_pin[port][SIO_TL] - 32);
         }
-        case DEV_SATURN_DIGITAL_TWH:
-            if (!(GPIO.in1.val & BIT(gpio_pin[port][SIO_TH] - 32))) {
-                set_analog_digital_pad(port, mt_first_port[port]);
-            }
-            break;
-        case DEV_SATURN_ANALOG:
-            if (!(GPIO.in1.val & BIT(gpio_pin[port][SIO_TH] - 32))) {
-                set_analog_pad(port, mt_first_port[port]);
-            }
-            break;
-        case DEV_SATURN_MULTITAP:
-            if (!(GPIO.in1.val & BIT(gpio_pin[port][SIO_TH] - 32))) {
-                set_saturn_multitap(port, mt_first_port[port], MT_PORT_MAX);
+        if (!edge) {
+            continue;
+        }
+
+        switch (dev_type[port]) {
+            case DEV_GENESIS_3BTNS:
+            case DEV_GENESIS_6BTNS:
+                th_select(port, dev_type[port], cur, last);
+                break;
+            case DEV_SATURN_DIGITAL:
+            {
+                uint8_t tmp = 0;
+                if (GPIO.in1.val & BIT(gpio_pin[port][SIO_TH] - 32)) {
+                    tmp |= 0x1;
+                }
+                if (GPIO.in & BIT(gpio_pin[port][SIO_TR])) {
+                    tmp |= 0x2;
+                }
+                sel[port] = tmp;
+                set_selection(port);
+                break;
             }
-            break;
-        case DEV_SATURN_KB:
-            break;
-        case DEV_EA_MULTITAP:
-            break;
+            case DEV_GENESIS_MULTITAP:
+            case DEV_GENESIS_MOUSE:
+            case DEV_SATURN_DIGITAL_TWH:
+            case DEV_SATURN_ANALOG:
+            case DEV_SATURN_MULTITAP:
+                twh_edge(port, th_edge);
+                break;
+            case DEV_SATURN_KB:
+                break;
+            case DEV_EA_MULTITAP:
+                if (port) {
+                    ea_select();
+                }
+                else {
+                    th_select(port, (ea_sel == EA_DETECT) ? DEV_GENESIS_3BTNS : mt_dev_type[0][ea_sel], cur, last);
+                }
+                break;
+        }
     }
 
     last = cur;
@@ -365,10 +668,10 @@ static void selection_refresh_task(void *arg) {
             switch (dev_type[port]) {
                 case DEV_GENESIS_3BTNS:
                 case DEV_GENESIS_6BTNS:
-                    set_th_selection(port);
+                    set_selection(port);
                     break;
                 case DEV_SATURN_DIGITAL:
-                    set_th_tr_selection(port);
+                    set_selection(port);
                     break;
             }
         }
@@ -444,23 +747,45 @@ void sega_io_init(void)
         switch (config.global_cfg.multitap_cfg) {
             case MT_SLOT_1:
                 dev_type[0] = DEV_GENESIS_MULTITAP;
+                mt_first_port[1] = GEN_MT_PORT_MAX;
                 break;
             case MT_SLOT_2:
                 dev_type[1] = DEV_GENESIS_MULTITAP;
+                mt_first_port[1] = 1;
                 break;
             case MT_DUAL:
                 dev_type[0] = DEV_GENESIS_MULTITAP;
                 dev_type[1] = DEV_GENESIS_MULTITAP;
+                mt_first_port[1] = GEN_MT_PORT_MAX;
                 break;
             case MT_ALT:
                 dev_type[0] = DEV_EA_MULTITAP;
                 dev_type[1] = DEV_EA_MULTITAP;
                 break;
+            default:
+                mt_first_port[1] = 1;
         }
 
         for (uint32_t i = 0; i < ARRAY_SIZE(gpio_pin); i++) {
-            if (dev_type[i] == DEV_NONE) {
-                switch (config.out_cfg[i].dev_mode) {
+            uint32_t j = 0;
+            if (dev_type[i] == DEV_GENESIS_MULTITAP || (dev_type[i] == DEV_EA_MULTITAP && i == 0)) {
+                for (; j < GEN_MT_PORT_MAX; j++) {
+                    switch (config.out_cfg[port_cnt++].dev_mode) {
+                        case DEV_PAD:
+                            mt_dev_type[i][j] = DEV_GENESIS_3BTNS;
+                            break;
+                        case DEV_PAD_ALT:
+                            mt_dev_type[i][j] = DEV_GENESIS_6BTNS;
+                            break;
+                        case DEV_MOUSE:
+                            /* No mouse behind EA 4-Way Play */
+                            mt_dev_type[i][j] = (dev_type[i] == DEV_EA_MULTITAP) ? DEV_GENESIS_3BTNS : DEV_GENESIS_MOUSE;
+                            break;
+                    }
+                }
+            }
+            else if (dev_type[i] == DEV_NONE) {
+                switch (config.out_cfg[port_cnt++].dev_mode) {
                     case DEV_PAD:
                         dev_type[i] = DEV_GENESIS_3BTNS;
                         break;
@@ -473,17 +798,29 @@ void sega_io_init(void)
                 }
             }
         }
+    }
 
+    for (uint32_t i = 0; i < ARRAY_SIZE(gpio_pin); i++) {
+        switch (dev_type[i]) {
+            case DEV_GENESIS_MULTITAP:
+                twh_start[i] = TWH_TL | 0xF;
+                twh_idle[i] = TWH_TL | 0x3;
+                break;
+            case DEV_GENESIS_MOUSE:
+                twh_start[i] = TWH_TL | 0xB;
+                twh_idle[i] = TWH_TL | 0x0;
+                break;
+            default:
+                /* Saturn ID0 2nd & 1st nibble */
+                twh_start[i] = TWH_TL | (ID0_SATURN_THREEWIRE_HANDSHAKE & 0xF);
+                twh_idle[i] = TWH_TL | (ID0_SATURN_THREEWIRE_HANDSHAKE >> 4);
+                break;
+        }
     }
 
     /* TH */
     for (uint32_t i = 0; i < ARRAY_SIZE(gpio_pin); i++) {
-        if (dev_type[i] == DEV_SATURN_ANALOG) {
-            io_conf.intr_type = GPIO_PIN_INTR_NEGEDGE;
-        }
-        else {
-            io_conf.intr_type = GPIO_PIN_INTR_ANYEDGE;
-        }
+        io_conf.intr_type = GPIO_PIN_INTR_ANYEDGE;
         io_conf.pin_bit_mask = 1ULL << gpio_pin[i][SIO_TH];
         io_conf.mode = GPIO_MODE_INPUT;
         io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
@@ -493,23 +830,36 @@ void sega_io_init(void)
 
     /* TR */
     for (uint32_t i = 0; i < ARRAY_SIZE(gpio_pin); i++) {
-        if (dev_type[i] == DEV_SATURN_DIGITAL) {
-            io_conf.intr_type = GPIO_PIN_INTR_ANYEDGE;
-        }
-        else {
-            io_conf.intr_type = GPIO_PIN_INTR_DISABLE;
+        switch (dev_type[i]) {
+            case DEV_SATURN_DIGITAL:
+            case DEV_SATURN_DIGITAL_TWH:
+            case DEV_SATURN_ANALOG:
+            case DEV_SATURN_MULTITAP:
+            case DEV_GENESIS_MULTITAP:
+            case DEV_GENESIS_MOUSE:
+                io_conf.intr_type = GPIO_PIN_INTR_ANYEDGE;
+                io_conf.mode = GPIO_MODE_INPUT;
+                break;
+            case DEV_EA_MULTITAP:
+                /* Port 2 TR select pad */
+                io_conf.intr_type = i ? GPIO_PIN_INTR_ANYEDGE : GPIO_PIN_INTR_DISABLE;
+                io_conf.mode = i ? GPIO_MODE_INPUT : GPIO_MODE_OUTPUT;
+                break;
+            case DEV_GENESIS_3BTNS:
+            case DEV_GENESIS_6BTNS:
+                io_conf.intr_type = GPIO_PIN_INTR_DISABLE;
+                io_conf.mode = GPIO_MODE_OUTPUT;
+                break;
+            default:
+                io_conf.intr_type = GPIO_PIN_INTR_DISABLE;
+                io_conf.mode = GPIO_MODE_INPUT;
+                break;
         }
         io_conf.pin_bit_mask = 1ULL << gpio_pin[i][SIO_TR];
-        if (dev_type[i] == DEV_GENESIS_3BTNS || dev_type[i] == DEV_GENESIS_6BTNS) {
-            io_conf.mode = GPIO_MODE_OUTPUT;
-        }
-        else {
-            io_conf.mode = GPIO_MODE_INPUT;
-        }
         io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
         io_conf.pull_up_en = GPIO_PULLUP_ENABLE;
         gpio_config(&io_conf);
-        if (dev_type[i] == DEV_GENESIS_3BTNS || dev_type[i] == DEV_GENESIS_6BTNS) {
+        if (io_conf.mode == GPIO_MODE_OUTPUT) {
             set_sio(i, SIO_TR, 1);
         }
     }
@@ -517,16 +867,42 @@ void sega_io_init(void)
     /* TL, R, L, D, U */
     for (uint32_t i = 0; i < ARRAY_SIZE(gpio_pin); i++) {
         for (uint32_t j = SIO_TL; j <= SIO_U; j++) {
-            io_conf.intr_type = GPIO_PIN_INTR_DISABLE;
             io_conf.pin_bit_mask = 1ULL << gpio_pin[i][j];
-            io_conf.mode = GPIO_MODE_OUTPUT;
             io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
             io_conf.pull_up_en = GPIO_PULLUP_ENABLE;
-            gpio_config(&io_conf);
-            set_sio(i, j, 1);
+            if (i == 1 && j == SIO_TL && dev_type[i] == DEV_EA_MULTITAP) {
+                /* Port 2 TL select pad */
+                io_conf.intr_type = GPIO_PIN_INTR_ANYEDGE;
+                io_conf.mode = GPIO_MODE_INPUT;
+                gpio_config(&io_conf);
+            }
+            else {
+                io_conf.intr_type = GPIO_PIN_INTR_DISABLE;
+                io_conf.mode = GPIO_MODE_OUTPUT;
+                gpio_config(&io_conf);
+                set_sio(i, j, 1);
+            }
         }
     }
 
+    for (uint32_t i = 0; i < ARRAY_SIZE(gpio_pin); i++) {
+        for (uint32_t j = 0; j < ARRAY_SIZE(twh_masks[0]); j++) {
+            sio_masks_build(&twh_masks[i][j], i, SIO_TL, j, TWH_TL);
+        }
+    }
+    /* U & D low */
+    sio_masks_build(&ea_detect_masks, 0, SIO_TR, 0x3C, 0x20);
+
+    /* Hook first so no frame published during init is missed */
+    wired_adapter.frame_encode = sega_io_frame_encode;
+    for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
+        uint32_t idx = atomic_get(&wired_adapter.data[i].frame_seq) & 0x1;
+
+        /* Current frame last so handshake frames are built from it */
+        sega_io_frame_encode(i, idx ^ 0x1);
+        sega_io_frame_encode(i, idx);
+    }
+
     /* Init half ID0 */
     for (uint32_t i = 0; i < ARRAY_SIZE(gpio_pin); i++) {
         switch (dev_type[i]) {
@@ -538,13 +914,9 @@ void sega_io_init(void)
                 else {
                     sel[i] = 0;
                 }
-                set_th_selection(i);
+                set_selection(i);
                 start_task = 1;
                 break;
-            case DEV_GENESIS_MULTITAP:
-                break;
-            case DEV_GENESIS_MOUSE:
-                break;
             case DEV_SATURN_DIGITAL:
             {
                 uint8_t tmp = 0;
@@ -555,17 +927,23 @@ void sega_io_init(void)
                     tmp |= 0x2;
                 }
                 sel[i] = tmp;
-                set_th_tr_selection(i);
+                set_selection(i);
                 start_task = 1;
                 break;
             }
+            case DEV_GENESIS_MULTITAP:
+            case DEV_GENESIS_MOUSE:
             case DEV_SATURN_DIGITAL_TWH:
             case DEV_SATURN_ANALOG:
             case DEV_SATURN_MULTITAP:
             case DEV_SATURN_KB:
-                tx_nibble(i, ID0_SATURN_THREEWIRE_HANDSHAKE >> 4);
+                twh_set(i, twh_idle[i]);
                 break;
             case DEV_EA_MULTITAP:
+                if (i == 0) {
+                    ea_select();
+                    start_task = 1;
+                }
                 break;
         }
     }
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "adapter.h"
+#include "config.h"
+#include "reports.h"
+#include "test.h"
+
+/* Feed every BT device type recorded reports through adapter_bridge()
+ * into every wired system and report the average cost per report.
+ * All BT_MAX_DEV slots are in use, each one mapped to its own output.
+ */
+
+static const char *wired_names[WIRED_MAX] = {
+    "WIRED_AUTO", "PARALLEL_1P", "PARALLEL_2P", "NES", "PCE", "GENESIS", "SNES",
+    "CDI", "CD32", "REAL_3DO", "JAGUAR", "PSX", "SATURN", "PCFX", "JVS", "N64",
+    "DC", "PS2", "GC", "WII_EXT", "EXP_BOARD",
+};
+
+static uint32_t bench_run(int32_t system_id, const struct host_report_set *set, uint32_t iter) {
+    uint64_t start, end;
+
+    wired_adapter.system_id = system_id;
+    for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
+        adapter_init_buffer(i);
+    }
+    for (uint32_t i = 0; i < BT_MAX_DEV; i++) {
+        host_report_dev_init(set, i);
+        /* 1st report calibrate axes */
+        host_report_bridge(set, i, 0);
+    }
+
+    start = test_ns();
+    for (uint32_t i = 0; i < iter; i++) {
+        host_report_bridge(set, i % BT_MAX_DEV, 1 + i / BT_MAX_DEV);
+    }
+    end = test_ns();
+
+    return (uint32_t)((end - start) / iter);
+}
+
+int main(int argc, char **argv) {
+    uint32_t iter = (argc > 1) ? strtoul(argv[1], NULL, 0) : 100000;
+
+    if (iter == 0) {
+        iter = 1;
+    }
+
+    adapter_init();
+    config_init();
+    /* Get HID descriptors parsing logs out of the way */
+    for (uint32_t j = 0; j < BT_MAX; j++) {
+        host_report_dev_init(&host_report_sets[j], 0);
+    }
+
+    printf("ns/report, %u reports per cell\n%-12s", iter, "");
+    for (uint32_t j = 0; j < BT_MAX; j++) {
+        printf(" %13s", host_report_sets[j].name);
+    }
+    printf("\n");
+
+    for (int32_t i = 0; i < WIRED_MAX; i++) {
+        printf("%-12s", wired_names[i]);
+        for (uint32_t j = 0; j < BT_MAX; j++) {
+            printf(" %13u", bench_run(i, &host_report_sets[j], iter));
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,287 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+/* Built with host.c to reach the TX scheduler and the VHCI callbacks */
+#include "../../main/bluetooth/host.c"
+#include "config.h"
+#include "host.h"
+#include "test.h"
+
+/* Replay a controller session dumped by H4_TRACE, or a btsnoop capture,
+ * through the BT host. RX packets go to the VHCI receive callback and
+ * the TX scheduler run after each one like bt_tx_task once notified.
+ * The fake VHCI check every packet the host send against the next TX
+ * packet of the dump, and TX packets dumped before a RX one must all be
+ * sent by then.
+ */
+
+#define BT_REPLAY_PKT_MAX 4096
+/* Dumps carry no usable time, space RX packets so TX queue waits end */
+#define BT_REPLAY_RX_GAP_US 1000
+
+#define BTSNOOP_DATALINK_H1 1001
+#define BTSNOOP_DATALINK_H4 1002
+#define BTSNOOP_FLAGS_RX BIT(0)
+#define BTSNOOP_FLAGS_CMD_EVT BIT(1)
+/* 2020-01-01 in us since year 0 */
+#define BTSNOOP_TS_BASE 0x00E278BBD129C000ULL
+
+struct bt_replay_pkt {
+    uint32_t dir;
+    uint32_t len;
+    uint8_t *data;
+};
+
+static struct bt_replay_pkt bt_replay_pkts[BT_REPLAY_PKT_MAX];
+static uint32_t bt_replay_cnt;
+static uint32_t bt_replay_tx_pos;
+static uint32_t bt_replay_tx_cnt;
+static const esp_vhci_host_callback_t *bt_replay_vhci_cb;
+
+static void bt_replay_add(uint32_t dir, uint8_t *data, uint32_t len) {
+    struct bt_replay_pkt *pkt = &bt_replay_pkts[bt_replay_cnt];
+
+    if (len == 0 || bt_replay_cnt >= BT_REPLAY_PKT_MAX) {
+        return;
+    }
+    pkt->dir = dir;
+    pkt->len = len;
+    pkt->data = malloc(len);
+    memcpy(pkt->data, data, len);
+    bt_replay_cnt++;
+}
+
+static void bt_replay_print(const char *name, uint8_t *data, uint32_t len) {
+    printf("# %s:", name);
+    for (uint32_t i = 0; i < len; i++) {
+        printf(" %02X", data[i]);
+    }
+    printf("\n");
+}
+
+static uint32_t be32(uint8_t *data) {
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+static void be32_set(uint8_t *data, uint32_t val) {
+    data[0] = val >> 24;
+    data[1] = val >> 16;
+    data[2] = val >> 8;
+    data[3] = val;
+}
+
+/* H4_TRACE text dump, other console lines are skipped */
+static void bt_replay_load_h4(FILE *file) {
+    static char line[128];
+    static uint8_t pkt[sizeof(struct bt_hci_pkt)];
+    uint32_t len = 0, dir = BT_TX;
+
+    while (fgets(line, sizeof(line), file)) {
+        char *ptr = line;
+        uint32_t offset;
+
+        if ((line[0] == 'I' || line[0] == 'O') && line[1] == ' ' && isxdigit((unsigned char)line[2])) {
+            bt_replay_add(dir, pkt, len);
+            dir = (line[0] == 'I') ? BT_RX : BT_TX;
+            len = 0;
+            ptr += 2;
+        }
+        else if (!isxdigit((unsigned char)line[0])) {
+            continue;
+        }
+        offset = strtoul(ptr, &ptr, 16);
+        if (offset != len) {
+            continue;
+        }
+        while (*ptr == ' ' && len < sizeof(pkt)) {
+            pkt[len++] = strtoul(ptr, &ptr, 16);
+        }
+    }
+    bt_replay_add(dir, pkt, len);
+}
+
+static void bt_replay_load_btsnoop(FILE *file, uint32_t datalink) {
+    static uint8_t pkt[sizeof(struct bt_hci_pkt)];
+    uint8_t hdr[24];
+
+    while (fread(hdr, sizeof(hdr), 1, file) == 1) {
+        uint32_t len = be32(&hdr[4]);
+        uint32_t flags = be32(&hdr[8]);
+        uint32_t dir = (flags & BTSNOOP_FLAGS_RX) ? BT_RX : BT_TX;
+        uint32_t ofs = 0;
+
+        /* H1 got no packet type, find it from direction & flags */
+        if (datalink == BTSNOOP_DATALINK_H1) {
+            if (flags & BTSNOOP_FLAGS_CMD_EVT) {
+                pkt[0] = (dir == BT_RX) ? BT_HCI_H4_TYPE_EVT : BT_HCI_H4_TYPE_CMD;
+            }
+            else {
+                pkt[0] = BT_HCI_H4_TYPE_ACL;
+            }
+            ofs = 1;
+        }
+        if (len + ofs > sizeof(pkt) || fread(pkt + ofs, len, 1, file) != 1) {
+            printf("# %s: bad record %u\n", __FUNCTION__, bt_replay_cnt);
+            break;
+        }
+        bt_replay_add(dir, pkt, len + ofs);
+    }
+}
+
+static uint32_t bt_replay_load(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    uint8_t hdr[16];
+
+    if (file == NULL) {
+        printf("# %s: failed to open %s\n", __FUNCTION__, filename);
+        return 0;
+    }
+    if (fread(hdr, sizeof(hdr), 1, file) == 1 && memcmp(hdr, "btsnoop", 8) == 0) {
+        uint32_t datalink = be32(&hdr[12]);
+
+        if (datalink == BTSNOOP_DATALINK_H1 || datalink == BTSNOOP_DATALINK_H4) {
+            bt_replay_load_btsnoop(file, datalink);
+        }
+        else {
+            printf("# %s: unsupported datalink %u\n", __FUNCTION__, datalink);
+        }
+    }
+    else {
+        rewind(file);
+        bt_replay_load_h4(file);
+    }
+    fclose(file);
+    return bt_replay_cnt;
+}
+
+/* Same session as a H4 btsnoop capture */
+static int32_t bt_replay_save_btsnoop(const char *filename) {
+    FILE *file = fopen(filename, "wb");
+    uint8_t hdr[24] = {'b', 't', 's', 'n', 'o', 'o', 'p', 0};
+
+    if (file == NULL) {
+        printf("# %s: failed to open %s\n", __FUNCTION__, filename);
+        return -1;
+    }
+    be32_set(&hdr[8], 1);
+    be32_set(&hdr[12], BTSNOOP_DATALINK_H4);
+    fwrite(hdr, 16, 1, file);
+    for (uint32_t i = 0; i < bt_replay_cnt; i++) {
+        struct bt_replay_pkt *pkt = &bt_replay_pkts[i];
+        uint64_t ts = BTSNOOP_TS_BASE + (uint64_t)i * BT_REPLAY_RX_GAP_US;
+        uint32_t flags = (pkt->dir == BT_RX) ? BTSNOOP_FLAGS_RX : 0;
+
+        if (pkt->data[0] == BT_HCI_H4_TYPE_CMD || pkt->data[0] == BT_HCI_H4_TYPE_EVT) {
+            flags |= BTSNOOP_FLAGS_CMD_EVT;
+        }
+        be32_set(&hdr[0], pkt->len);
+        be32_set(&hdr[4], pkt->len);
+        be32_set(&hdr[8], flags);
+        be32_set(&hdr[12], 0);
+        be32_set(&hdr[16], ts >> 32);
+        be32_set(&hdr[20], ts);
+        fwrite(hdr, sizeof(hdr), 1, file);
+        fwrite(pkt->data, pkt->len, 1, file);
+    }
+    fclose(file);
+    return 0;
+}
+
+/* Fake VHCI, the controller accept each packet right away */
+esp_err_t esp_vhci_host_register_callback(const esp_vhci_host_callback_t *callback) {
+    bt_replay_vhci_cb = callback;
+    return ESP_OK;
+}
+
+void esp_vhci_host_send_packet(uint8_t *data, uint16_t len) {
+    while (bt_replay_tx_pos < bt_replay_cnt && bt_replay_pkts[bt_replay_tx_pos].dir != BT_TX) {
+        bt_replay_tx_pos++;
+    }
+    if (bt_replay_tx_pos < bt_replay_cnt) {
+        struct bt_replay_pkt *exp = &bt_replay_pkts[bt_replay_tx_pos++];
+
+        if (exp->len != len || memcmp(exp->data, data, len)) {
+            TEST_CHECK(0, "TX pkt %u differ from dump pkt %u", bt_replay_tx_cnt, bt_replay_tx_pos - 1);
+            bt_replay_print("exp", exp->data, exp->len);
+            bt_replay_print("got", data, len);
+        }
+    }
+    else {
+        TEST_CHECK(0, "TX pkt %u not in dump", bt_replay_tx_cnt);
+        bt_replay_print("got", data, len);
+    }
+    bt_replay_tx_cnt++;
+    bt_replay_vhci_cb->notify_host_send_available();
+}
+
+int main(int argc, char **argv) {
+    uint32_t rx_cnt = 0, tx_exp_cnt = 0;
+    uint64_t ns = 0, ns_max = 0;
+
+    if (argc < 2) {
+        printf("Usage: %s trace.txt|trace.btsnoop [out.btsnoop]\n", argv[0]);
+        return 1;
+    }
+    if (bt_replay_load(argv[1]) == 0) {
+        printf("# %s: no packet in %s\n", __FUNCTION__, argv[1]);
+        return 1;
+    }
+    if (argc > 2 && bt_replay_save_btsnoop(argv[2])) {
+        return 1;
+    }
+
+    /* Session start without pairing */
+    remove(LINK_KEYS_FILE);
+    adapter_init();
+    config_init();
+    bt_host_init();
+    TEST_CHECK(bt_replay_vhci_cb != NULL, "VHCI callback not registered");
+    if (bt_replay_vhci_cb == NULL) {
+        return TEST_RESULT();
+    }
+    bt_host_tx_sched();
+
+    for (uint32_t i = 0; i < bt_replay_cnt; i++) {
+        struct bt_replay_pkt *pkt = &bt_replay_pkts[i];
+
+        if (pkt->dir == BT_RX) {
+            uint64_t start, end;
+
+            TEST_CHECK(bt_replay_tx_cnt == tx_exp_cnt, "dump pkt %u: host sent %u TX pkts, dump got %u before it",
+                i, bt_replay_tx_cnt, tx_exp_cnt);
+            host_time_us += BT_REPLAY_RX_GAP_US;
+            start = test_ns();
+            bt_replay_vhci_cb->notify_host_recv(pkt->data, pkt->len);
+            end = test_ns();
+            ns += end - start;
+            if (end - start > ns_max) {
+                ns_max = end - start;
+            }
+            rx_cnt++;
+            bt_host_tx_sched();
+        }
+        else {
+            tx_exp_cnt++;
+        }
+    }
+    /* Let queue waits end */
+    host_time_us += 1000000;
+    bt_host_tx_sched();
+
+    printf("# RX %u pkts in %lu us, %lu pkts/s\n", rx_cnt, (unsigned long)(ns / 1000),
+        ns ? (unsigned long)((uint64_t)rx_cnt * 1000000000 / ns) : 0);
+    if (rx_cnt) {
+        printf("# per pkt avg %lu ns max %lu ns\n", (unsigned long)(ns / rx_cnt), (unsigned long)ns_max);
+    }
+    printf("# TX %u pkts, %u in dump\n", bt_replay_tx_cnt, tx_exp_cnt);
+    TEST_CHECK(rx_cnt > 0, "no RX pkt in dump");
+    TEST_CHECK(bt_replay_tx_cnt == tx_exp_cnt, "TX %u pkts, dump got %u", bt_replay_tx_cnt, tx_exp_cnt);
+
+    return TEST_RESULT();
+}
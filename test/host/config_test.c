@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Count config writes back to the file */
+static uint32_t store_cnt;
+
+static FILE *test_fopen(const char *path, const char *mode) {
+    if (mode[0] == 'w') {
+        store_cnt++;
+    }
+    return fopen(path, mode);
+}
+
+#define fopen test_fopen
+/* Built with config.c to reach the file loader */
+#include "../../main/adapter/config.c"
+#undef fopen
+#include "test.h"
+
+/* Config files of every size and magic: only a valid config from before
+ * pak banks is migrated, anything else is reset before being written back.
+ */
+
+static void test_file_write(const void *data, size_t size) {
+    FILE *file = fopen(CONFIG_FILE, "wb");
+
+    fwrite(data, 1, size, file);
+    fclose(file);
+}
+
+static size_t test_file_read(struct config *data) {
+    FILE *file = fopen(CONFIG_FILE, "rb");
+    size_t size;
+
+    memset((void *)data, 0, sizeof(*data));
+    size = fread((void *)data, 1, sizeof(*data), file);
+    fclose(file);
+    return size;
+}
+
+static void test_load(const char *name, const void *file, size_t size, const struct config *exp, uint32_t exp_store) {
+    struct config data;
+
+    remove(CONFIG_FILE);
+    if (file) {
+        test_file_write(file, size);
+    }
+    memset((void *)&config, 0xFF, sizeof(config));
+    store_cnt = 0;
+    config_load_from_file(&config);
+
+    TEST_CHECK(memcmp((void *)&config, (void *)exp, sizeof(config)) == 0, "%s: loaded config differ", name);
+    TEST_CHECK(store_cnt == exp_store, "%s: %u writes, expected %u", name, store_cnt, exp_store);
+    TEST_CHECK(test_file_read(&data) == sizeof(data) && memcmp((void *)&data, (void *)exp, sizeof(data)) == 0,
+        "%s: file content differ", name);
+}
+
+int main(int argc, char **argv) {
+    struct config def, user, migrated, foreign, foreign_reset;
+
+    /* Maps past KBM_MAX are left as is by reset */
+    memset((void *)&def, 0xFF, sizeof(def));
+    config_init_struct(&def);
+    user = def;
+    user.global_cfg.system_cfg = 0x03;
+    user.out_cfg[1].dev_mode = 0x02;
+    user.in_cfg[0].map_cfg[4].dst_btn = 9;
+    memset(user.mem_bank, 0x03, sizeof(user.mem_bank));
+    migrated = user;
+    memset(migrated.mem_bank, 0, sizeof(migrated.mem_bank));
+    memset((void *)&foreign, 0x5A, sizeof(foreign));
+    foreign_reset = foreign;
+    config_init_struct(&foreign_reset);
+
+    test_load("no file", NULL, 0, &def, 1);
+    test_load("current", &user, sizeof(user), &user, 0);
+    test_load("before pak banks", &user, offsetof(struct config, mem_bank), &migrated, 1);
+    test_load("foreign", &foreign, sizeof(foreign), &foreign_reset, 1);
+    /* Must be reset, not written back as is before the magic check */
+    test_load("foreign short", &foreign, offsetof(struct config, mem_bank), &foreign_reset, 1);
+    test_load("truncated", &user, offsetof(struct config, in_cfg), &def, 1);
+    test_load("empty", &user, 0, &def, 1);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "zephyr/types.h"
+#include "util.h"
+#include "adapter.h"
+#include "config.h"
+#include "reports.h"
+#include "test.h"
+
+/* Sweep a 16 bits XB1 stick through every response curve into a 16 bits
+ * JVS axis and check each curve is monotonic, zero at the deadzone edge,
+ * full scale at the stick edge and close to its reference shape.
+ */
+
+#define CURVE_DEADZONE 135 /* 1.35% */
+
+extern struct generic_ctrl ctrl_output[WIRED_MAX_DEV];
+
+static const char *curve_names[] = {
+    "LINEAR", "AGGRESSIVE", "RELAXED", "WIDE", "S_CURVE", "PASSTHROUGH",
+};
+
+static double curve_ref(uint32_t algo, double x) {
+    switch (algo) {
+        case AGGRESSIVE:
+            return 1.0 - (1.0 - x) * (1.0 - x);
+        case RELAXED:
+            return x * x;
+        case WIDE:
+            return x * x * x;
+        case S_CURVE:
+            return x * x * (3.0 - 2.0 * x);
+        default:
+            return x;
+    }
+}
+
+static void curve_cfg(uint32_t algo) {
+    struct in_cfg *in_cfg = &config.in_cfg[0];
+    const uint8_t srcs[] = {PAD_LX_LEFT, PAD_LX_RIGHT};
+
+    in_cfg->map_size = ARRAY_SIZE(srcs);
+    for (uint32_t i = 0; i < ARRAY_SIZE(srcs); i++) {
+        struct map_cfg *map_cfg = &in_cfg->map_cfg[i];
+
+        map_cfg->src_btn = srcs[i];
+        map_cfg->dst_btn = srcs[i];
+        map_cfg->dst_id = 0;
+        map_cfg->perc_max = 100;
+        map_cfg->perc_threshold = 50;
+        map_cfg->perc_deadzone = CURVE_DEADZONE;
+        map_cfg->turbo = 0;
+        map_cfg->algo = algo;
+    }
+    adapter_config_changed();
+}
+
+static int32_t curve_out(const struct host_report_set *set, int32_t lx) {
+    struct host_report report = set->reports[0];
+    struct host_report_set one = *set;
+    uint16_t raw = (uint16_t)(lx + 0x8000);
+
+    report.data[0] = raw & 0xFF;
+    report.data[1] = raw >> 8;
+    one.cnt = 1;
+    one.reports = &report;
+    host_report_bridge(&one, 0, 0);
+
+    return ctrl_output[0].axes[AXIS_LX].value;
+}
+
+static void curve_check(const struct host_report_set *set, uint32_t algo, int32_t sign) {
+    const int32_t in_max = 0x8000, out_max = 0x8000;
+    const int32_t deadzone = (int32_t)((float)CURVE_DEADZONE / 10000 * in_max);
+    const int32_t range = in_max - deadzone;
+    /* Fixed point table interpolation and Q15 rounding */
+    const double tolerance = out_max / 500.0;
+    int32_t prev = 0;
+
+    for (int32_t in = 0; in <= in_max; in++) {
+        int32_t lx = (sign > 0) ? ((in == in_max) ? in_max - 1 : in) : -in;
+        int32_t abs_in = abs(lx);
+        int32_t out = sign * curve_out(set, lx);
+
+        TEST_CHECK(out >= 0, "%s: input %d output %d has wrong sign", curve_names[algo], lx, out);
+        TEST_CHECK(out >= prev, "%s: not monotonic at input %d, %d < %d", curve_names[algo], lx, out, prev);
+        prev = out;
+
+        if (abs_in <= deadzone) {
+            TEST_CHECK(out == 0, "%s: input %d in deadzone gave %d", curve_names[algo], lx, out);
+        }
+        else if (algo == PASSTHROUGH) {
+            TEST_CHECK(out == abs_in - deadzone, "%s: input %d gave %d", curve_names[algo], lx, out);
+        }
+        else {
+            double ref = curve_ref(algo, (double)(abs_in - deadzone) / range) * out_max;
+
+            TEST_CHECK(fabs(out - ref) <= tolerance, "%s: input %d gave %d expected %.1f",
+                curve_names[algo], lx, out, ref);
+        }
+    }
+    /* Stick only reach full range on the negative side */
+    if (sign < 0 && algo != PASSTHROUGH) {
+        TEST_CHECK(prev == out_max, "%s: end point %d expected %d", curve_names[algo], prev, out_max);
+    }
+}
+
+int main(void) {
+    const struct host_report_set *set = &host_report_sets[XB1_S];
+
+    adapter_init();
+    config_init();
+    wired_adapter.system_id = JVS;
+    for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
+        adapter_init_buffer(i);
+    }
+    host_report_dev_init(set, 0);
+
+    for (uint32_t algo = LINEAR; algo <= PASSTHROUGH; algo++) {
+        uint32_t fail = test_fail_cnt;
+
+        curve_cfg(algo);
+        /* Calibrate at rest */
+        host_report_bridge(set, 0, 0);
+        curve_check(set, algo, 1);
+        curve_check(set, algo, -1);
+        printf("%-12s %s\n", curve_names[algo], (fail == test_fail_cnt) ? "ok" : "FAIL");
+    }
+    return TEST_RESULT();
+}
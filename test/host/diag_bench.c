@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Built with adapter.c so the stick shaping stage can be timed alone */
+#include "adapter.c"
+#include "test.h"
+
+#define DIAG_POS_MAX 256
+#define DIAG_RADIUS 0x4000
+
+static const char *diag_names[DIAG_MAX] = {
+    "DIAG_PASSTHROUGH", "CIRCLE_SQUARE", "CIRCLE_HEX", "SQUARE_CIRCLE", "SQUARE_HEX", "CIRCLE_OCTAGON",
+};
+
+static struct ctrl diag_pos[DIAG_POS_MAX][2];
+
+static void diag_shape(uint32_t mode, int32_t x, int32_t y, int32_t *out_x, int32_t *out_y) {
+    struct ctrl x_axis = {.value = x}, y_axis = {.value = y};
+
+    if (mode != DIAG_PASSTHROUGH) {
+        adapter_diag_stick(diag_lut[mode], &x_axis, &y_axis);
+    }
+    *out_x = x_axis.value;
+    *out_y = y_axis.value;
+}
+
+static void diag_expect(uint32_t mode, int32_t x, int32_t y, int32_t exp_x, int32_t exp_y) {
+    /* Q14 gain, interpolated in a 32 points table */
+    int32_t tolerance = DIAG_RADIUS / 100;
+    int32_t out_x, out_y;
+
+    diag_shape(mode, x, y, &out_x, &out_y);
+    TEST_CHECK(abs(out_x - exp_x) <= tolerance && abs(out_y - exp_y) <= tolerance,
+        "%s: (%d, %d) gave (%d, %d) expected (%d, %d)", diag_names[mode], x, y, out_x, out_y, exp_x, exp_y);
+}
+
+static void diag_check(void) {
+    const int32_t r = DIAG_RADIUS;
+    const int32_t d = (int32_t)(r * M_SQRT1_2);
+    const int32_t n64_d = (int32_t)(r * ADAPTER_N64_GATE_DIAG);
+
+    for (uint32_t mode = 0; mode < DIAG_MAX; mode++) {
+        /* Centre and X cardinal are never changed */
+        diag_expect(mode, r, 0, r, 0);
+        diag_expect(mode, -r, 0, -r, 0);
+        diag_expect(mode, 0, 0, 0, 0);
+        /* Y cardinal lands on a hexagon flat side */
+        if (mode != CIRCLE_HEX && mode != SQUARE_HEX) {
+            diag_expect(mode, 0, -r, 0, -r);
+        }
+    }
+    diag_expect(CIRCLE_HEX, 0, r, 0, (int32_t)(r * cos(M_PI / 6)));
+    diag_expect(DIAG_PASSTHROUGH, d, d, d, d);
+    /* Circle diagonal to square corner and back */
+    diag_expect(CIRCLE_SQUARE, d, -d, r, -r);
+    diag_expect(CIRCLE_SQUARE, -d / 2, -d / 2, -r / 2, -r / 2);
+    diag_expect(SQUARE_CIRCLE, -r, r, -d, d);
+    /* Hexagon flat side at 30 deg, square edge there is 1 / cos(30) away */
+    diag_expect(CIRCLE_HEX, (int32_t)(r * cos(M_PI / 6)), r / 2,
+        (int32_t)(r * 0.75), (int32_t)(r * cos(M_PI / 6) / 2));
+    diag_expect(SQUARE_HEX, r, (int32_t)(r * tan(M_PI / 6)),
+        (int32_t)(r * 0.75), (int32_t)(r * tan(M_PI / 6) * 0.75));
+    /* N64 octagon diagonal notch */
+    diag_expect(CIRCLE_OCTAGON, d, d, n64_d, n64_d);
+    diag_expect(CIRCLE_OCTAGON, -d, d, -n64_d, n64_d);
+
+    /* Shaping never cross an axis and keep every quadrant symmetric */
+    for (uint32_t mode = 0; mode < DIAG_MAX; mode++) {
+        for (uint32_t i = 0; i < DIAG_POS_MAX; i++) {
+            int32_t x = diag_pos[i][0].value, y = diag_pos[i][1].value;
+            int32_t out_x, out_y, neg_x, neg_y;
+
+            diag_shape(mode, x, y, &out_x, &out_y);
+            diag_shape(mode, -x, -y, &neg_x, &neg_y);
+            TEST_CHECK((int64_t)out_x * x >= 0 && (int64_t)out_y * y >= 0,
+                "%s: (%d, %d) changed quadrant (%d, %d)", diag_names[mode], x, y, out_x, out_y);
+            TEST_CHECK(neg_x == -out_x && neg_y == -out_y,
+                "%s: (%d, %d) not symmetric (%d, %d) vs (%d, %d)", diag_names[mode], x, y, out_x, out_y, neg_x, neg_y);
+        }
+    }
+}
+
+static void diag_bench(uint32_t iter) {
+    printf("ns/call, %u calls per mode\n", iter * DIAG_POS_MAX);
+    for (uint32_t mode = 1; mode < DIAG_MAX; mode++) {
+        const uint16_t *lut = diag_lut[mode];
+        volatile int32_t sink = 0;
+        uint64_t start, end;
+
+        start = test_ns();
+        for (uint32_t n = 0; n < iter; n++) {
+            for (uint32_t i = 0; i < DIAG_POS_MAX; i++) {
+                struct ctrl x_axis = diag_pos[i][0], y_axis = diag_pos[i][1];
+
+                adapter_diag_stick(lut, &x_axis, &y_axis);
+                sink += x_axis.value + y_axis.value;
+            }
+        }
+        end = test_ns();
+        printf("%-16s %6.2f\n", diag_names[mode], (double)(end - start) / ((double)iter * DIAG_POS_MAX));
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t iter = (argc > 1) ? strtoul(argv[1], NULL, 0) : 10000;
+
+    if (iter == 0) {
+        iter = 1;
+    }
+
+    adapter_init();
+
+    /* Spiral covering every direction and radius */
+    for (uint32_t i = 0; i < DIAG_POS_MAX; i++) {
+        double angle = 2 * M_PI * i / 64;
+        double radius = DIAG_RADIUS * (double)(i + 1) / DIAG_POS_MAX;
+
+        diag_pos[i][0].value = (int32_t)(radius * cos(angle));
+        diag_pos[i][1].value = (int32_t)(radius * sin(angle));
+    }
+
+    diag_check();
+    diag_bench(iter);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "adapter.h"
+#include "test.h"
+
+/* Hammer frame publish from one thread while another copy frames like a
+ * wired ISR do, every copy accepted by the seqlock must be from one frame.
+ */
+
+#define FRAME_LEN sizeof(((struct wired_data *)0)->output)
+
+/* Stand-in for a driver pre-encoded frame, kept per frame slot */
+static uint8_t frame_enc[2][FRAME_LEN];
+static volatile uint32_t writer_done;
+
+static void frame_encode(uint8_t wired_id, uint32_t idx) {
+    for (uint32_t i = 0; i < FRAME_LEN; i++) {
+        frame_enc[idx][i] = wired_adapter.data[wired_id].frame[idx][i] ^ 0x5A;
+    }
+}
+
+static void *frame_writer(void *arg) {
+    uint32_t iter = *(uint32_t *)arg;
+    struct wired_data *wired_data = &wired_adapter.data[0];
+
+    for (uint32_t n = 1; n <= iter; n++) {
+        memset(wired_data->output, (uint8_t)n, FRAME_LEN);
+        adapter_test_publish(0, NULL);
+    }
+    writer_done = 1;
+    return NULL;
+}
+
+static uint32_t frame_torn(const uint8_t *frame) {
+    for (uint32_t i = 1; i < FRAME_LEN; i++) {
+        if (frame[i] != frame[0]) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void frame_copy(uint8_t *dst, const uint8_t *src) {
+    /* Byte per byte to widen the race window */
+    for (uint32_t i = 0; i < FRAME_LEN; i++) {
+        ((volatile uint8_t *)dst)[i] = ((volatile uint8_t *)src)[i];
+    }
+}
+
+int main(int argc, char **argv) {
+    uint32_t iter = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1000000;
+    struct wired_data *wired_data = &wired_adapter.data[0];
+    uint32_t reads = 0, gave_up = 0, torn = 0, naive_torn = 0;
+    uint8_t copy[FRAME_LEN];
+    pthread_t writer;
+
+    wired_adapter.frame_encode = frame_encode;
+    frame_encode(0, 0);
+    frame_encode(0, 1);
+
+    pthread_create(&writer, NULL, frame_writer, &iter);
+    while (!writer_done) {
+        uint32_t seq = 0, ok = 0;
+
+        /* Reader as used in wired ISR */
+        for (uint32_t i = 0; i < WIRED_FRAME_READ_TRY; i++) {
+            seq = wired_frame_read_begin(wired_data);
+            frame_copy(copy, frame_enc[seq & 0x1]);
+            if (!wired_frame_read_retry(wired_data, seq)) {
+                ok = 1;
+                break;
+            }
+        }
+        reads++;
+        if (!ok) {
+            gave_up++;
+        }
+        else if (frame_torn(copy)) {
+            torn++;
+        }
+
+        /* Same copy without the seq check, for reference */
+        frame_copy(copy, frame_enc[atomic_get(&wired_data->frame_seq) & 0x1]);
+        naive_torn += frame_torn(copy);
+    }
+    pthread_join(writer, NULL);
+
+    printf("%u publishes, %u reads, %u retries exhausted, %u torn, %u torn without seq check\n",
+        iter, reads, gave_up, torn, naive_torn);
+    TEST_CHECK(torn == 0, "%u torn frames accepted", torn);
+    TEST_CHECK(atomic_get(&wired_data->frame_seq) == iter, "frame_seq %u after %u publishes",
+        (uint32_t)atomic_get(&wired_data->frame_seq), iter);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+/* Built with jvs.c to reach the reply cache and the parser */
+#include "../../main/wired/jvs.c"
+#include "host.h"
+#include "test.h"
+
+/* Requests are escaped into the UART RX FIFO and the ISR run like on a
+ * RX timeout, replies are read back from the TX FIFO. Input polls from
+ * the cache must match the parser reply for the same frames.
+ */
+
+#define JVS_TEST_POLLS 20000
+
+struct jvs_test_req {
+    uint8_t req[16];
+    uint32_t req_len;
+    const char *rsp;
+    uint8_t speed;
+};
+
+/* Node setup then one of each command, frames set by jvs_test_protocol() */
+static const struct jvs_test_req jvs_test_seq[] = {
+    {{0xFF, 0x03, 0xF0, 0xD9}, 4, "", JVS_SPEED_115200},
+    {{0xFF, 0x03, 0xF1, 0x01}, 4, "E0000301 0105", JVS_SPEED_115200},
+    {{0x01, 0x02, 0x10}, 3, "E0001901 01426C75 65526574 726F3B4A 56533B76 6572312E 30200014", JVS_SPEED_115200},
+    {{0x01, 0x02, 0x11}, 3, "E0000401 011319", JVS_SPEED_115200},
+    {{0x01, 0x02, 0x12}, 3, "E0000401 013036", JVS_SPEED_115200},
+    {{0x01, 0x02, 0x13}, 3, "E0000401 011016", JVS_SPEED_115200},
+    {{0x01, 0x02, 0x14}, 3, "E0001001 01010C10 00020C00 00031810 000068", JVS_SPEED_115200},
+    {{0x01, 0x03, 0x15, 'a', 0x00}, 5, "E0000301 0105", JVS_SPEED_115200},
+    {{0x01, 0x07, 0x20, 0x02, 0x02, 0x21, 0x02, 0x22, 0x08}, 9,
+        "E0001E01 0188C6F1 EB9601D0 CFDBF5D0 DF01FCE7 929D818C B7A2A651 5C474B76 616C02", JVS_SPEED_115200},
+    {{0x01, 0x02, 0x2F}, 3,
+        "E0001E01 0188C6F1 EB9601D0 CFDBF5D0 DF01FCE7 929D818C B7A2A651 5C474B76 616C02", JVS_SPEED_115200},
+    {{0x01, 0x04, 0x20, 0x04, 0x03}, 5, "E0001001 0188C6F1 FCEB9681 B0BBA655 404B40", JVS_SPEED_115200},
+    /* No reply, new speed right away */
+    {{0xFF, 0x03, 0xF2, 0x01}, 4, "", JVS_SPEED_1M},
+    {{0x01, 0x04, 0x20, 0x02, 0x02}, 5, "E0000801 0188C6F1 EB96CA", JVS_SPEED_1M},
+    {{0xFF, 0x03, 0xF2, 0x02}, 4, "", JVS_SPEED_3M},
+    {{0x01, 0x04, 0x20, 0x02, 0x02}, 5, "E0000801 0188C6F1 EB96CA", JVS_SPEED_3M},
+    {{0x01, 0x03, 0x21, 0x02}, 4, "E0000701 01D0CFDB F5D0DF89", JVS_SPEED_3M},
+    /* Reset drop address and speed */
+    {{0xFF, 0x03, 0xF0, 0xD9}, 4, "", JVS_SPEED_115200},
+    {{0x01, 0x02, 0x10}, 3, "", JVS_SPEED_115200},
+};
+
+/* Input polls seen on real boards */
+static const struct {
+    const char *name;
+    uint8_t req[2][16];
+    uint32_t req_len[2];
+} jvs_test_polls[] = {
+    {"NAOMI 2 players", {{0x01, 0x08, 0x20, 0x02, 0x02, 0x21, 0x02, 0x22, 0x08}}, {9}},
+    {"Triforce 2 players", {{0x01, 0x06, 0x20, 0x02, 0x02, 0x21, 0x02}}, {7}},
+    {"4 players", {{0x01, 0x06, 0x20, 0x04, 0x02, 0x21, 0x04}}, {7}},
+    {"12 players", {{0x01, 0x08, 0x20, 0x0C, 0x02, 0x21, 0x0C, 0x22, 0x18}}, {9}},
+    {"mixed shapes", {{0x01, 0x04, 0x20, 0x02, 0x02}, {0x01, 0x03, 0x22, 0x04}}, {5, 4}},
+};
+
+/* Asking for more players, channels or reply data than we have */
+static const struct jvs_test_req jvs_test_oversized[] = {
+    {{0x01, 0x04, 0x20, 0x0D, 0x02}, 5},
+    {{0x01, 0x04, 0x20, 0x0C, 0x0B}, 5},
+    {{0x01, 0x04, 0x20, 0x01, 0xFF}, 5},
+    {{0x01, 0x03, 0x21, 0x0D}, 4},
+    {{0x01, 0x03, 0x22, 0x19}, 4},
+    {{0x01, 0x08, 0x20, 0x0C, 0x08, 0x21, 0x0C, 0x22, 0x18}, 9},
+    {{0x01, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10}, 9},
+};
+
+static void jvs_test_put(uint8_t byte) {
+    if (byte == SYNC || byte == MARK) {
+        host_uart_rx[host_uart_rx_len++] = MARK;
+        host_uart_rx[host_uart_rx_len++] = byte - 1;
+    }
+    else {
+        host_uart_rx[host_uart_rx_len++] = byte;
+    }
+}
+
+/* Request to RX FIFO then RX timeout, TX done once reply is out */
+static uint64_t jvs_test_req(const uint8_t *req, uint32_t len, uint8_t *rsp) {
+    uint64_t cycles;
+    uint8_t sum = 0;
+
+    host_uart_rx_len = 0;
+    host_uart_rx_pos = 0;
+    host_uart_tx_len = 0;
+    host_uart_rx[host_uart_rx_len++] = SYNC;
+    for (uint32_t i = 0; i < len; i++) {
+        jvs_test_put(req[i]);
+        sum += req[i];
+    }
+    jvs_test_put(sum);
+
+    UART1.int_st.val = UART_INTR_RXFIFO_TOUT;
+    cycles = test_cycles();
+    uart_rx(NULL);
+    cycles = test_cycles() - cycles;
+    memcpy(rsp, host_uart_tx, host_uart_tx_len);
+
+    UART1.int_st.val = UART_INTR_TX_DONE;
+    uart_rx(NULL);
+    return cycles;
+}
+
+static uint32_t jvs_test_hex(const char *str, uint8_t *data) {
+    uint32_t len = 0;
+
+    while (*str) {
+        if (*str == ' ') {
+            str++;
+            continue;
+        }
+        sscanf(str, "%2hhx", &data[len++]);
+        str += 2;
+    }
+    return len;
+}
+
+static void jvs_test_publish(uint32_t wired_id) {
+    for (uint32_t i = 0; i < 9; i++) {
+        wired_adapter.data[wired_id].output[i] = rand();
+    }
+    adapter_test_publish(wired_id, NULL);
+}
+
+static void jvs_test_protocol(void) {
+    uint8_t rsp[HOST_UART_FIFO_SIZE];
+    uint8_t exp[HOST_UART_FIFO_SIZE];
+
+    for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
+        for (uint32_t j = 0; j < 2; j++) {
+            for (uint32_t k = 0; k < sizeof(wired_adapter.data[0].frame[0]); k++) {
+                wired_adapter.data[i].frame[j][k] = (i * 37 + k * 11) ^ 0xD0;
+            }
+        }
+    }
+    jvs_init();
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(jvs_test_seq); i++) {
+        const struct jvs_test_req *seq = &jvs_test_seq[i];
+        uint32_t exp_len = jvs_test_hex(seq->rsp, exp);
+
+        jvs_test_req(seq->req, seq->req_len, rsp);
+        TEST_CHECK(host_uart_tx_len == exp_len && memcmp(rsp, exp, exp_len) == 0,
+            "req %u cmd 0x%02X: %u bytes reply, expected %u", i, seq->req[2], host_uart_tx_len, exp_len);
+        TEST_CHECK(UART1.clk_div.val == clk_div[seq->speed], "req %u: clk_div 0x%08X", i, UART1.clk_div.val);
+    }
+
+    /* Back at 115200 and get an address */
+    jvs_test_req(jvs_test_seq[1].req, jvs_test_seq[1].req_len, rsp);
+}
+
+/* Rejected with an overflow status, from the cache and the parser */
+static void jvs_test_oversized_check(void) {
+    static const uint8_t overflow[] = {SYNC, 0x00, 0x02, 0x04, 0x06};
+    uint8_t rsp[HOST_UART_FIFO_SIZE];
+
+    for (uint32_t i = 0; i < ARRAY_SIZE(jvs_test_oversized); i++) {
+        for (uint32_t full = 0; full < 2; full++) {
+            const struct jvs_test_req *req = &jvs_test_oversized[i];
+
+            atomic_set(&cache_cnt, full ? JVS_CACHE_MAX : 0);
+            jvs_test_req(req->req, req->req_len, rsp);
+            TEST_CHECK(host_uart_tx_len == sizeof(overflow) && memcmp(rsp, overflow, sizeof(overflow)) == 0,
+                "oversized req %u cache %s: %u bytes reply", i, full ? "full" : "empty", host_uart_tx_len);
+            TEST_CHECK(full || atomic_get(&cache_cnt) == 0, "oversized req %u: cached", i);
+        }
+    }
+    atomic_set(&cache_cnt, 0);
+}
+
+/* Cached replies against the parser, cache is filled with shapes never
+ * polled to force the parser path.
+ */
+static void jvs_test_polls_check(uint32_t set) {
+    static struct jvs_cache cache_bak[JVS_CACHE_MAX];
+    uint8_t rsp[HOST_UART_FIFO_SIZE];
+    uint8_t ref[HOST_UART_FIFO_SIZE];
+    uint64_t cached = 0, parsed = 0;
+    uint32_t cnt = 0;
+
+    /* Each set starts with an empty cache */
+    atomic_set(&cache_cnt, 0);
+    for (uint32_t poll = 0; poll < JVS_TEST_POLLS && !test_fail_cnt; poll++) {
+        uint32_t shape = (jvs_test_polls[set].req_len[1] && (poll & 0x1)) ? 1 : 0;
+        const uint8_t *req = jvs_test_polls[set].req[shape];
+        uint32_t req_len = jvs_test_polls[set].req_len[shape];
+        uint32_t cache_cnt_bak = atomic_get(&cache_cnt);
+        uint32_t ref_len;
+
+        for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
+            if (rand() % 3 == 0) {
+                jvs_test_publish(i);
+            }
+        }
+
+        memcpy(cache_bak, cache, sizeof(cache));
+        for (uint32_t i = 0; i < JVS_CACHE_MAX; i++) {
+            cache[i].req_len = ~0;
+        }
+        atomic_set(&cache_cnt, JVS_CACHE_MAX);
+        parsed += jvs_test_req(req, req_len, ref);
+        ref_len = host_uart_tx_len;
+        memcpy(cache, cache_bak, sizeof(cache));
+        atomic_set(&cache_cnt, cache_cnt_bak);
+
+        cached += jvs_test_req(req, req_len, rsp);
+        TEST_CHECK(host_uart_tx_len == ref_len && memcmp(rsp, ref, ref_len) == 0,
+            "%s poll %u: cached reply differ from parser", jvs_test_polls[set].name, poll);
+
+        /* Retransmit the cached reply */
+        if (poll % 7 == 0) {
+            jvs_test_req((const uint8_t []){0x01, 0x02, 0x2F}, 3, ref);
+            TEST_CHECK(host_uart_tx_len == ref_len && memcmp(rsp, ref, ref_len) == 0,
+                "%s poll %u: retransmit differ", jvs_test_polls[set].name, poll);
+        }
+        cnt++;
+    }
+    if (cnt) {
+        printf("# %s: %s, cached %llu parser %llu cycles/poll\n", __FUNCTION__, jvs_test_polls[set].name,
+            (unsigned long long)(cached / cnt), (unsigned long long)(parsed / cnt));
+    }
+}
+
+int main(int argc, char **argv) {
+    jvs_test_protocol();
+    jvs_test_oversized_check();
+
+    srand(5);
+    for (uint32_t i = 0; i < ARRAY_SIZE(jvs_test_polls); i++) {
+        jvs_test_polls_check(i);
+    }
+    TEST_CHECK(atomic_get(&cache_cnt) == 2, "%u shapes cached", (uint32_t)atomic_get(&cache_cnt));
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,36 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "adapter.h"
+#include "test.h"
+
+int main(int argc, char **argv) {
+    struct adapter_latency_stats stats;
+    struct bt_data bt_data = {0};
+
+    /* Frames not built from a BT report are never accounted */
+    adapter_test_publish(0, NULL);
+    adapter_latency_record(0, 1000);
+    adapter_latency_get(0, &stats);
+    TEST_CHECK(stats.cnt == 0, "%u samples from a non BT frame", stats.cnt);
+
+    /* BT RX time of 0 is a valid sample */
+    bt_data.timestamp = 0;
+    adapter_test_publish(0, &bt_data);
+    adapter_latency_record(0, 100);
+    /* Same frame served again */
+    adapter_latency_record(0, 200);
+    adapter_latency_get(0, &stats);
+    TEST_CHECK(stats.cnt == 1 && stats.min == 100, "cnt %u min %u, expected 1 sample of 100 us", stats.cnt, stats.min);
+
+    /* Age across the 32 bits us wrap */
+    bt_data.timestamp = 0xFFFFFF00;
+    adapter_test_publish(0, &bt_data);
+    adapter_latency_record(0, 0x100);
+    adapter_latency_get(0, &stats);
+    TEST_CHECK(stats.cnt == 2 && stats.max == 0x200, "cnt %u max %u, expected 2 samples max 512 us", stats.cnt, stats.max);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Built with maple.c to reach the I2S TX */
+#include "../../main/wired/maple.c"
+#include "host.h"
+#include "test.h"
+
+/* I2S TX waveform checked sample exact against the bit-banged TX timing,
+ * one sample per wait_100ns(), then decoded back like maple_rx does.
+ */
+
+#define I2S_TEST_RUNS 2000
+#define I2S_TEST_SAMPLES 32768
+
+static uint16_t dma_out[I2S_TEST_SAMPLES];
+static uint32_t dma_cnt;
+static uint32_t dma_stalled;
+static uint16_t ref_out[I2S_TEST_SAMPLES];
+static uint32_t ref_cnt;
+static uint16_t ref_state;
+
+/* Play descriptor chain once lines are routed to I2S */
+static void i2s_test_dma(uint32_t gpio, uint32_t signal_idx) {
+    const lldesc_t *desc = (const lldesc_t *)I2S1.out_link.addr;
+
+    if (signal_idx != I2S1O_DATA_OUT1_IDX || !I2S1.conf.tx_start || dma_stalled) {
+        return;
+    }
+    dma_cnt = 0;
+    for (; desc; desc = desc->qe.stqe_next) {
+        const uint16_t *buf = (const uint16_t *)desc->buf;
+
+        for (uint32_t i = 0; i < desc->length / 2 && dma_cnt < I2S_TEST_SAMPLES; i++) {
+            dma_out[dma_cnt++] = buf[I2S_IDX(i)];
+        }
+        if (desc->eof) {
+            break;
+        }
+    }
+    I2S1.int_raw.out_total_eof = 1;
+}
+
+static void ref_set(uint16_t mask, uint32_t level, uint32_t samples) {
+    if (level) {
+        ref_state |= mask;
+    }
+    else {
+        ref_state &= ~mask;
+    }
+    while (samples--) {
+        ref_out[ref_cnt++] = ref_state;
+    }
+}
+
+/* Bit-banged maple_tx_raw, m0 is bit 0 and m1 bit 1 */
+static void ref_tx(const uint8_t *data, uint32_t len) {
+    ref_cnt = 0;
+    ref_state = I2S_IDLE;
+
+    ref_set(1, 0, 5);
+    for (uint32_t i = 0; i < 4; i++) {
+        ref_set(2, 0, 5);
+        ref_set(2, 1, (i < 3) ? 5 : 2);
+    }
+    for (uint32_t bit = 0; bit < len * 8; bit += 2) {
+        uint32_t a = data[bit / 8] & (0x80 >> (bit % 8));
+        uint32_t b = data[bit / 8] & (0x40 >> (bit % 8));
+
+        ref_set(1, 1, 2);
+        ref_set(2, a, 1);
+        ref_set(1, 0, 2);
+        ref_set(2, 1, 2);
+        ref_set(1, b, 1);
+        ref_set(2, 0, 2);
+    }
+    ref_set(1, 1, 1);
+    ref_set(2, 1, 5);
+    ref_set(2, 0, 5);
+    ref_set(1, 0, 5);
+    ref_set(1, 1, 5);
+    ref_set(1, 0, 5);
+    ref_set(1, 1, 5);
+}
+
+/* Sample lines like maple_rx, m0 fall clock bit on m1 then m1 fall clock m0 */
+static uint32_t i2s_test_decode(const uint16_t *smp, uint32_t cnt, uint8_t *data, uint32_t max_len) {
+    uint32_t k = I2S_LEAD_SAMPLES + I2S_START_SAMPLES;
+    uint32_t bits = 0;
+
+    memset(data, 0, max_len);
+    while (bits < max_len * 8) {
+        uint32_t high = 0;
+
+        while (k < cnt && !(smp[k] & 1)) k++;
+        while (k < cnt && (smp[k] & 1)) k++;
+        if (k >= cnt) {
+            break;
+        }
+        if (smp[k] & 2) {
+            data[bits / 8] |= 0x80 >> (bits % 8);
+        }
+        bits++;
+        while (k < cnt && !(smp[k] & 2)) k++;
+        while (k < cnt && (smp[k] & 2)) {
+            k++;
+            /* m1 held high, end sequence */
+            if (++high > TIMEOUT) {
+                return bits - 1;
+            }
+        }
+        if (smp[k] & 1) {
+            data[bits / 8] |= 0x80 >> (bits % 8);
+        }
+        bits++;
+    }
+    return bits;
+}
+
+static void i2s_test_check(uint32_t run, const uint8_t *data, uint32_t len) {
+    uint8_t rx[sizeof(struct maple_pkt)];
+    uint32_t bits;
+
+    ref_tx(data, len);
+    dma_cnt = 0;
+    maple_tx_raw(0, BIT(gpio_pin[0][0]), BIT(gpio_pin[0][1]), data, len);
+
+    TEST_CHECK(dma_cnt >= I2S_LEAD_SAMPLES + ref_cnt, "run %u: %u samples", run, dma_cnt);
+    if (dma_cnt < I2S_LEAD_SAMPLES + ref_cnt) {
+        return;
+    }
+    for (uint32_t i = 0; i < I2S_LEAD_SAMPLES; i++) {
+        TEST_CHECK(dma_out[i] == I2S_IDLE, "run %u: lead sample %u not idle", run, i);
+    }
+    TEST_CHECK(memcmp(dma_out + I2S_LEAD_SAMPLES, ref_out, ref_cnt * sizeof(ref_out[0])) == 0,
+        "run %u len %u: waveform differ from bit-bang", run, len);
+    for (uint32_t i = I2S_LEAD_SAMPLES + ref_cnt; i < dma_cnt; i++) {
+        TEST_CHECK(dma_out[i] == I2S_IDLE, "run %u: tail sample %u not idle", run, i);
+    }
+    bits = i2s_test_decode(dma_out, dma_cnt, rx, sizeof(rx));
+    TEST_CHECK(bits == len * 8 && memcmp(rx, data, len) == 0, "run %u len %u: decoded %u bits", run, len, bits);
+}
+
+int main(int argc, char **argv) {
+    struct maple_pkt tx;
+    uint8_t crc = 0;
+    uint32_t start, cycles;
+
+    maple_i2s_init();
+    host_gpio_matrix_out_hook = i2s_test_dma;
+
+    srand(1);
+    for (uint32_t run = 0; run < I2S_TEST_RUNS; run++) {
+        uint32_t len = 1 + rand() % sizeof(tx);
+
+        for (uint32_t i = 0; i < len; i++) {
+            tx.data[i] = rand();
+        }
+        /* Every 1st byte value, rendered in head buffer */
+        if (run < 256) {
+            len = 17;
+            tx.data[0] = run;
+        }
+        i2s_test_check(run, tx.data, len);
+    }
+
+    /* CRC appended by maple_tx */
+    tx.len = 1;
+    tx.cmd = CMD_ACK;
+    tx.src = ADDR_CTRL;
+    tx.dst = 0x00;
+    tx.data32[0] = 0x12345678;
+    maple_tx(0, BIT(gpio_pin[0][0]), BIT(gpio_pin[0][1]), tx.data, tx.len * 4 + 5);
+    {
+        uint8_t rx[9];
+
+        i2s_test_decode(dma_out, dma_cnt, rx, sizeof(rx));
+        for (uint32_t i = 0; i < sizeof(rx); i++) {
+            crc ^= rx[i];
+        }
+        TEST_CHECK(memcmp(rx, tx.data, 8) == 0 && crc == 0, "maple_tx: bad CRC 0x%02X", crc);
+    }
+
+    /* DMA never done, TX must give up */
+    dma_stalled = 1;
+    I2S1.int_raw.out_total_eof = 0;
+    start = xthal_get_ccount();
+    maple_tx_raw(0, BIT(gpio_pin[0][0]), BIT(gpio_pin[0][1]), tx.data, 17);
+    cycles = xthal_get_ccount() - start;
+    TEST_CHECK(cycles <= I2S_TX_TIMEOUT_US(17) * CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ + 16,
+        "stalled DMA: TX spun %u cycles", cycles);
+    TEST_CHECK(!I2S1.conf.tx_start, "stalled DMA: I2S still started");
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Built with maple.c to see responses in the I2S descriptors */
+#include "../../main/wired/maple.c"
+#include "host.h"
+#include "test.h"
+
+/* Frames captured like maple_rx, with 0 to 8 leading bits lost, are fed to
+ * maple_rx_frame & maple_rx_pkt. Responses are read back from the I2S
+ * descriptor chain, frames failing CRC must get none.
+ */
+
+static uint8_t tx_data[sizeof(struct maple_pkt)];
+static uint32_t tx_len;
+
+/* Byte 0 is rendered in head buffer, others map to nibble buffers */
+static void rx_test_dma(uint32_t gpio, uint32_t signal_idx) {
+    const lldesc_t *desc = (const lldesc_t *)I2S1.out_link.addr;
+
+    if (signal_idx != I2S1O_DATA_OUT1_IDX || !I2S1.conf.tx_start) {
+        return;
+    }
+    tx_len = 1;
+    for (desc = desc->qe.stqe_next; desc && !desc->eof; desc = desc->qe.stqe_next->qe.stqe_next) {
+        uint32_t hi = ((const uint16_t (*)[2 * I2S_PAIR_SAMPLES])desc->buf) - i2s_nibble;
+        uint32_t lo = ((const uint16_t (*)[2 * I2S_PAIR_SAMPLES])desc->qe.stqe_next->buf) - i2s_nibble;
+
+        tx_data[tx_len++] = (hi << 4) | lo;
+    }
+    tx_data[0] = (tx_len - 5) / 4;
+    I2S1.int_raw.out_total_eof = 1;
+}
+
+static uint32_t rx_test_frame(uint8_t *frame, uint8_t len, uint8_t dst, uint8_t cmd) {
+    uint32_t size = len * 4 + 5;
+    uint8_t crc = 0;
+
+    frame[0] = len;
+    /* 8 bits loss detected by len byte mismatch */
+    frame[1] = len ^ 0xFF;
+    frame[2] = dst;
+    frame[3] = cmd;
+    for (uint32_t i = 4; i < size - 1; i++) {
+        frame[i] = rand();
+    }
+    for (uint32_t i = 0; i < size - 1; i++) {
+        crc ^= frame[i];
+    }
+    frame[size - 1] = crc;
+    return size;
+}
+
+/* Bits as maple_rx store them, lost bits never sampled and end sequence add one */
+static uint32_t rx_test_capture(uint8_t *data, const uint8_t *frame, uint32_t size, uint32_t lost) {
+    uint32_t bit_cnt = 0;
+
+    memset(data, 0xA5, sizeof(pkt.data));
+    for (uint32_t bit = lost; bit < size * 8; bit++, bit_cnt++) {
+        uint8_t mask = 0x80 >> (bit_cnt % 8);
+
+        if (frame[bit / 8] & (0x80 >> (bit % 8))) {
+            data[bit_cnt / 8] |= mask;
+        }
+        else {
+            data[bit_cnt / 8] &= ~mask;
+        }
+    }
+    if (bit_cnt / 8 < sizeof(pkt.data)) {
+        data[bit_cnt / 8] |= 0x80 >> (bit_cnt % 8);
+    }
+    return bit_cnt + 1;
+}
+
+static void rx_test_tx_check(const char *name, uint32_t lost, uint32_t rsp_len, uint8_t rsp_cmd) {
+    uint8_t crc = 0;
+
+    TEST_CHECK(tx_len == rsp_len * 4 + 5, "%s lost %u: %u bytes TX", name, lost, tx_len);
+    if (tx_len != rsp_len * 4 + 5) {
+        return;
+    }
+    for (uint32_t i = 0; i < tx_len; i++) {
+        crc ^= tx_data[i];
+    }
+    TEST_CHECK(tx_data[3] == rsp_cmd && crc == 0, "%s lost %u: cmd 0x%02X crc 0x%02X", name, lost, tx_data[3], crc);
+}
+
+int main(int argc, char **argv) {
+    const uint32_t maple0 = BIT(gpio_pin[0][0]);
+    const uint32_t maple1 = BIT(gpio_pin[0][1]);
+    uint8_t frame[sizeof(struct maple_pkt)];
+    uint32_t size, bit_cnt, ret;
+    struct wired_rx_stats exp = {0};
+
+    maple_i2s_init();
+    maple_frame_encode(0, 0);
+    maple_frame_encode(0, 1);
+    host_gpio_matrix_out_hook = rx_test_dma;
+    srand(1);
+
+    /* Realign every loss on every frame size */
+    for (uint32_t len = 0; len < 136; len++) {
+        for (uint32_t lost = 0; lost <= 8; lost++) {
+            size = rx_test_frame(frame, len, ADDR_CTRL, CMD_GET_CONDITION);
+            bit_cnt = rx_test_capture(pkt.data, frame, size, lost);
+            ret = maple_rx_frame(pkt.data, bit_cnt);
+            TEST_CHECK(ret == (lost ? MAPLE_RX_REPAIRED : MAPLE_RX_GOOD), "len %u lost %u: ret %u", len, lost, ret);
+            TEST_CHECK(memcmp(pkt.data, frame, size) == 0, "len %u lost %u: frame not realigned", len, lost);
+        }
+    }
+
+    /* Any bit flip fail CRC, len byte is rebuilt from bit count when bits are lost */
+    for (uint32_t bit = 0; bit < 13 * 8; bit++) {
+        size = rx_test_frame(frame, 2, ADDR_CTRL, CMD_GET_CONDITION);
+        frame[bit / 8] ^= 0x80 >> (bit % 8);
+        bit_cnt = rx_test_capture(pkt.data, frame, size, (bit < 8) ? 0 : bit % 8);
+        ret = maple_rx_frame(pkt.data, bit_cnt);
+        TEST_CHECK(ret == MAPLE_RX_DROPPED, "bit %u flipped: ret %u", bit, ret);
+    }
+
+    /* Too short or too long */
+    TEST_CHECK(maple_rx_frame(pkt.data, 32) == MAPLE_RX_DROPPED, "32 bits frame not dropped");
+    TEST_CHECK(maple_rx_frame(pkt.data, sizeof(pkt) * 8 + 2) == MAPLE_RX_DROPPED, "overflow frame not dropped");
+
+    /* Good & repaired frames get response */
+    for (uint32_t lost = 0; lost <= 8; lost++) {
+        size = rx_test_frame(frame, 0, ADDR_CTRL, CMD_INFO_REQ);
+        bit_cnt = rx_test_capture(pkt.data, frame, size, lost);
+        tx_len = 0;
+        maple_rx_pkt(0, maple0, maple1, bit_cnt);
+        rx_test_tx_check("info", lost, 28, CMD_INFO_RSP);
+        if (lost) {
+            ++exp.repaired;
+        }
+        else {
+            ++exp.good;
+        }
+
+        size = rx_test_frame(frame, 1, ADDR_CTRL, CMD_GET_CONDITION);
+        bit_cnt = rx_test_capture(pkt.data, frame, size, lost);
+        tx_len = 0;
+        maple_rx_pkt(0, maple0, maple1, bit_cnt);
+        rx_test_tx_check("condition", lost, 3, CMD_DATA_TX);
+        if (lost) {
+            ++exp.repaired;
+        }
+        else {
+            ++exp.good;
+        }
+    }
+
+    /* Bad CRC frames are not handled */
+    for (uint32_t lost = 0; lost <= 8; lost++) {
+        uint32_t frame_cnt = wired_adapter.data[0].frame_cnt;
+
+        size = rx_test_frame(frame, 1, ADDR_CTRL, CMD_GET_CONDITION);
+        frame[size - 1] ^= 0x01;
+        bit_cnt = rx_test_capture(pkt.data, frame, size, lost);
+        tx_len = 0;
+        maple_rx_pkt(0, maple0, maple1, bit_cnt);
+        TEST_CHECK(tx_len == 0, "bad CRC lost %u: %u bytes TX", lost, tx_len);
+        TEST_CHECK(wired_adapter.data[0].frame_cnt == frame_cnt, "bad CRC lost %u: poll counted", lost);
+        ++exp.dropped;
+
+        /* Rumble setting left untouched */
+        size = rx_test_frame(frame, 2, ADDR_RUMBLE, CMD_SET_CONDITION);
+        frame[size - 1] ^= 0x01;
+        bit_cnt = rx_test_capture(pkt.data, frame, size, lost);
+        tx_len = 0;
+        maple_rx_pkt(0, maple0, maple1, bit_cnt);
+        TEST_CHECK(tx_len == 0 && rumble_val == 0x10E0073B, "bad CRC lost %u: rumble set 0x%08X", lost, rumble_val);
+        ++exp.dropped;
+    }
+
+    /* Same rumble frame with good CRC is applied */
+    size = rx_test_frame(frame, 2, ADDR_RUMBLE, CMD_SET_CONDITION);
+    bit_cnt = rx_test_capture(pkt.data, frame, size, 3);
+    maple_rx_pkt(0, maple0, maple1, bit_cnt);
+    TEST_CHECK(rumble_val == *(uint32_t *)&frame[8], "rumble 0x%08X not set", rumble_val);
+    ++exp.repaired;
+
+    TEST_CHECK(wired_adapter.rx_stats[0].good == exp.good && wired_adapter.rx_stats[0].repaired == exp.repaired && wired_adapter.rx_stats[0].dropped == exp.dropped,
+        "stats good %u/%u repaired %u/%u dropped %u/%u", wired_adapter.rx_stats[0].good, exp.good,
+        wired_adapter.rx_stats[0].repaired, exp.repaired, wired_adapter.rx_stats[0].dropped, exp.dropped);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Built with maple.c to reach the VMU cache */
+#include "../../main/wired/maple.c"
+#include <pthread.h>
+#include <unistd.h>
+#include "test.h"
+
+/* VMU block cache run from test thread as VMU task and ISR */
+
+static void vmu_test_fill(uint32_t port) {
+    for (uint32_t i = 0; i < VMU_CACHE_BLKS; i++) {
+        vmu_fetch_blk(port, i);
+    }
+}
+
+static void *vmu_test_evict(void *arg) {
+    vmu_fetch_blk(0, (uintptr_t)arg);
+    return NULL;
+}
+
+static void vmu_alloc_check(void) {
+    config.out_cfg[0].acc_mode = ACC_RUMBLE;
+    vmu_cache_init();
+    TEST_CHECK(vmu_cache == NULL, "cache allocated without VMU");
+
+    config.out_cfg[0].acc_mode = ACC_MEM;
+    vmu_cache_init();
+    TEST_CHECK(vmu_cache != NULL, "cache not allocated with VMU");
+}
+
+static void vmu_hit_check(void) {
+    struct vmu_blk *entry;
+    uint32_t valid = 0;
+
+    vmu_bank_select(0, 0);
+    vmu_test_fill(0);
+
+    /* Free entry in front of the hit must not get a 2nd copy */
+    vmu_cache_release(&vmu_cache[0]);
+    vmu_fetch_blk(0, 10);
+    for (uint32_t i = 0; i < VMU_CACHE_BLKS; i++) {
+        if (atomic_test_bit(&vmu_cache[i].flags, VMU_BLK_VALID) && vmu_cache[i].port == 0 && vmu_cache[i].blk == 10) {
+            valid++;
+        }
+    }
+    TEST_CHECK(valid == 1, "block 10 cached %u times", valid);
+    TEST_CHECK(!atomic_test_bit(&vmu_cache[0].flags, VMU_BLK_VALID), "free entry used on hit");
+
+    entry = vmu_cache_get(0, 10);
+    TEST_CHECK(entry == &vmu_cache[10], "block 10 not found");
+    if (entry) {
+        vmu_cache_put(entry);
+    }
+}
+
+/* Eviction must wait on ISR using the entry and not lose its write */
+static void vmu_race_check(void) {
+    struct vmu_blk *entry;
+    pthread_t thread;
+    uint32_t data[VMU_BLK_SIZE / 4];
+    FILE *file;
+
+    vmu_bank_select(0, 1);
+    vmu_test_fill(0);
+
+    /* ISR hold block 0 for a write, other blocks used after so it's LRU */
+    entry = vmu_cache_get(0, 0);
+    TEST_CHECK(entry, "block 0 not cached");
+    if (entry == NULL) {
+        return;
+    }
+    for (uint32_t i = 1; i < VMU_CACHE_BLKS; i++) {
+        vmu_cache_put(vmu_cache_get(0, i));
+    }
+    pthread_create(&thread, NULL, vmu_test_evict, (void *)(uintptr_t)200);
+    usleep(20000);
+    TEST_CHECK(entry->blk == 0, "block 0 replaced while in use");
+    for (uint32_t i = 0; i < ARRAY_SIZE(entry->data32); i++) {
+        entry->data32[i] = 0xA5000000 | i;
+    }
+    atomic_set_bit(&entry->flags, VMU_BLK_DIRTY);
+    vmu_cache_put(entry);
+    pthread_join(thread, NULL);
+
+    TEST_CHECK(vmu_cache_get(0, 0) == NULL, "block 0 still cached");
+    entry = vmu_cache_get(0, 200);
+    TEST_CHECK(entry, "block 200 not cached");
+    if (entry) {
+        vmu_cache_put(entry);
+    }
+
+    /* Write done while eviction waited is on SD */
+    file = vmu_open(0, "rb");
+    TEST_CHECK(file, "no bank 1 image");
+    if (file) {
+        TEST_CHECK(fread(data, sizeof(data), 1, file) == 1, "short bank 1 image");
+        fclose(file);
+        TEST_CHECK(__builtin_bswap32(data[7]) == (0xA5000000 | 7), "write lost on eviction 0x%08X", data[7]);
+    }
+}
+
+int main(int argc, char **argv) {
+    for (uint32_t bank = 0; bank < 2; bank++) {
+        char filename[32];
+
+        sprintf(filename, VMU_FILE, 0, bank);
+        remove(filename);
+    }
+    vmu_alloc_check();
+    if (vmu_cache) {
+        vmu_hit_check();
+        vmu_race_check();
+    }
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "adapter.h"
+#include "config.h"
+#include "n64.h"
+#include "reports.h"
+#include "test.h"
+
+/* Two devices in a different dev mode feeding their own N64 output must
+ * keep their own output meta, and repeated reports must still be skipped.
+ */
+
+#define META_ROUNDS 16
+
+extern struct generic_ctrl ctrl_output[WIRED_MAX_DEV];
+
+static struct generic_ctrl meta_ref[2][WIRED_MAX_DEV];
+
+static void meta_check(uint32_t wired_id, int32_t dev_mode) {
+    struct generic_ctrl *ref = &meta_ref[dev_mode == DEV_MOUSE][wired_id];
+
+    TEST_CHECK(ctrl_output[wired_id].mask == ref->mask && ctrl_output[wired_id].desc == ref->desc,
+        "output %u doesn't have dev mode %d meta", wired_id, dev_mode);
+}
+
+int main(int argc, char **argv) {
+    const struct host_report_set *set = &host_report_sets[PS4_DS4];
+    uint32_t skip;
+
+    adapter_init();
+    config_init();
+    n64_meta_init(DEV_PAD, meta_ref[0]);
+    n64_meta_init(DEV_MOUSE, meta_ref[1]);
+
+    config.out_cfg[0].dev_mode = DEV_PAD;
+    config.out_cfg[1].dev_mode = DEV_MOUSE;
+    wired_adapter.system_id = N64;
+    for (uint32_t i = 0; i < 2; i++) {
+        adapter_init_buffer(i);
+        host_report_dev_init(set, i);
+        host_report_bridge(set, i, 0);
+    }
+
+    /* 1st round get both devices state, every following one is a repeat */
+    skip = adapter_stats.input_skip[PS4_DS4];
+    for (uint32_t i = 0; i < META_ROUNDS; i++) {
+        host_report_bridge(set, 0, 1);
+        host_report_bridge(set, 1, 1);
+    }
+    skip = adapter_stats.input_skip[PS4_DS4] - skip;
+    TEST_CHECK(skip == 2 * (META_ROUNDS - 1), "%u repeated reports skipped, expected %u", skip, 2 * (META_ROUNDS - 1));
+    meta_check(0, DEV_PAD);
+    meta_check(1, DEV_MOUSE);
+
+    /* A dev mode change only rebuild that device output */
+    config.out_cfg[1].dev_mode = DEV_PAD;
+    adapter_config_changed();
+    host_report_bridge(set, 1, 2);
+    meta_check(0, DEV_PAD);
+    meta_check(1, DEV_PAD);
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Built with nsi.c to reach its encoders */
+#include "../../main/wired/nsi.c"
+#include "test.h"
+
+/* Per byte table encoder checked bit exact against the previous bit by bit
+ * encoder for every byte value at every position of a pak block.
+ */
+
+#define NSI_ENC_RUNS 20000
+
+/* Previous encoder, one item and one CRC table entry per bit */
+static uint32_t nsi_ref_bytes_to_items(uint32_t *items, const uint8_t *data, uint32_t len, uint8_t *crc, uint32_t stop_bit) {
+    const uint8_t *crc_table = nsi_crc_table;
+    uint32_t item = 0;
+
+    *crc = 0xFF;
+    for (; item < len * 8; ++data) {
+        for (uint32_t mask = 0x80; mask; mask >>= 1) {
+            if (*data & mask) {
+                *crc ^= *crc_table;
+                items[item] = BIT_ONE;
+            }
+            else {
+                items[item] = BIT_ZERO;
+            }
+            ++crc_table;
+            ++item;
+        }
+    }
+    items[item] = stop_bit;
+    return item;
+}
+
+/* Previous decoder CRC */
+static uint8_t nsi_ref_items_crc(const uint32_t *items, uint32_t len) {
+    const uint8_t *crc_table = nsi_crc_table;
+    uint8_t crc = 0xFF;
+
+    for (uint32_t i = 0; i < len * 8; i++, crc_table++) {
+        if (items[i] & BIT_ONE_MASK) {
+            crc ^= *crc_table;
+        }
+    }
+    return crc;
+}
+
+static void nsi_enc_check(void) {
+    uint32_t ref[PAK_ITEMS], shadow[PAK_ITEMS];
+    volatile uint32_t *rmt = &rmt_items[0].val;
+    uint8_t block[32], crc_ref, crc;
+
+    for (uint32_t i = 0; i < sizeof(block); i++) {
+        block[i] = i * 73 + 5;
+    }
+    for (uint32_t pos = 0; pos < sizeof(block); pos++) {
+        uint8_t save = block[pos];
+
+        for (uint32_t val = 0; val < 256; val++) {
+            uint32_t item_ref, item_shadow, item_rmt;
+
+            block[pos] = val;
+            item_ref = nsi_ref_bytes_to_items(ref, block, sizeof(block), &crc_ref, STOP_BIT_2US);
+
+            item_shadow = nsi_bytes_to_shadow_items(shadow, block, sizeof(block), &crc, STOP_BIT_2US);
+            TEST_CHECK(item_shadow == item_ref && crc == crc_ref && !memcmp(shadow, ref, (item_ref + 1) * 4),
+                "shadow pos %u val 0x%02X crc 0x%02X expected 0x%02X", pos, val, crc, crc_ref);
+
+            item_rmt = nsi_bytes_to_items_crc(0, block, sizeof(block), &crc, STOP_BIT_2US);
+            for (uint32_t i = 0; i <= item_ref; i++) {
+                if (rmt[i] != ref[i]) {
+                    item_rmt = ~0;
+                }
+            }
+            TEST_CHECK(item_rmt == item_ref && crc == crc_ref,
+                "rmt pos %u val 0x%02X crc 0x%02X expected 0x%02X", pos, val, crc, crc_ref);
+
+            /* Decode CRC from the reference items */
+            for (uint32_t i = 0; i <= item_ref; i++) {
+                rmt[i] = ref[i];
+            }
+            nsi_items_to_bytes_crc(0, block, sizeof(block), &crc);
+            TEST_CHECK(crc == nsi_ref_items_crc(ref, sizeof(block)),
+                "decode pos %u val 0x%02X crc 0x%02X expected 0x%02X", pos, val, crc, crc_ref);
+        }
+        block[pos] = save;
+    }
+}
+
+static void nsi_enc_bench(void) {
+    uint32_t items[PAK_ITEMS];
+    uint8_t block[32], crc;
+    uint64_t start, ref_cycles, rmt_cycles, shadow_cycles;
+
+    for (uint32_t i = 0; i < sizeof(block); i++) {
+        block[i] = i * 91 + 3;
+    }
+
+    start = test_cycles();
+    for (uint32_t i = 0; i < NSI_ENC_RUNS; i++) {
+        block[i & 0x1F] = i;
+        nsi_ref_bytes_to_items(items, block, sizeof(block), &crc, STOP_BIT_2US);
+        __asm__ volatile("" : : "r"(items), "r"(crc) : "memory");
+    }
+    ref_cycles = test_cycles() - start;
+
+    start = test_cycles();
+    for (uint32_t i = 0; i < NSI_ENC_RUNS; i++) {
+        block[i & 0x1F] = i;
+        nsi_bytes_to_shadow_items(items, block, sizeof(block), &crc, STOP_BIT_2US);
+        __asm__ volatile("" : : "r"(items), "r"(crc) : "memory");
+    }
+    shadow_cycles = test_cycles() - start;
+
+    start = test_cycles();
+    for (uint32_t i = 0; i < NSI_ENC_RUNS; i++) {
+        block[i & 0x1F] = i;
+        nsi_bytes_to_items_crc(0, block, sizeof(block), &crc, STOP_BIT_2US);
+        __asm__ volatile("" : : "r"(crc) : "memory");
+    }
+    rmt_cycles = test_cycles() - start;
+
+    printf("32 bytes block encode, host cycles\n");
+    printf("bitwise          %8u\n", (uint32_t)(ref_cycles / NSI_ENC_RUNS));
+    printf("per byte shadow  %8u\n", (uint32_t)(shadow_cycles / NSI_ENC_RUNS));
+    printf("per byte rmt     %8u\n", (uint32_t)(rmt_cycles / NSI_ENC_RUNS));
+}
+
+int main(int argc, char **argv) {
+    nsi_tables_init();
+    nsi_enc_check();
+    nsi_enc_bench();
+
+    return TEST_RESULT();
+}
@@ -0,0 +1,358 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Built with nsi.c to drive its ISR */
+#include "../../main/wired/nsi.c"
+#include <freertos/ringbuf.h>
+#include "test.h"
+
+/* RMT simulation of the N64 and GC ISR. Console commands are written as
+ * RX items in the channel RMT memory then the RX end interrupt is raised.
+ * TX items the ISR leave in RMT memory are decoded back to bytes and
+ * checked against a bit serial reference of the reply and its CRC.
+ */
+
+#define NSI_SIM_RUNS 1000
+
+enum {
+    NSI_SIM_N64 = 0,
+    NSI_SIM_GC,
+};
+
+struct nsi_sim_cmd {
+    const char *name;
+    uint32_t system;
+    uint32_t len;
+    uint8_t cmd[36];
+};
+
+static uint8_t pak_ref[MEMPAK_SIZE];
+
+/* Reference N64 pak data CRC, bit serial with polynomial 0x85 */
+static uint8_t nsi_ref_crc(const uint8_t *data, uint32_t len) {
+    uint8_t crc = 0;
+
+    for (uint32_t i = 0; i <= len; i++) {
+        for (int32_t j = 7; j >= 0; j--) {
+            uint8_t xor = (crc & 0x80) ? 0x85 : 0x00;
+
+            crc <<= 1;
+            if (i < len && (data[i] & BIT(j))) {
+                crc |= 0x1;
+            }
+            crc ^= xor;
+        }
+    }
+    return crc;
+}
+
+static void nsi_sim_publish(uint8_t wired_id, const uint8_t *data, uint32_t len) {
+    memcpy(wired_adapter.data[wired_id].output, data, len);
+    adapter_test_publish(wired_id, NULL);
+}
+
+static uint32_t nsi_sim_channel(uint32_t system, uint32_t port) {
+    return rmt_ch[port][system];
+}
+
+/* Console drive the line, RMT record one item per bit */
+static void nsi_sim_rx(uint32_t channel, const uint8_t *data, uint32_t len) {
+    volatile uint32_t *item = &RMTMEM.chan[channel].data32[0].val;
+
+    for (uint32_t i = 0; i < len; i++) {
+        for (int32_t j = 7; j >= 0; j--) {
+            *item++ = (data[i] & BIT(j)) ? BIT_ONE : BIT_ZERO;
+        }
+    }
+    /* Console stop bit then idle */
+    *item = STOP_BIT_1US;
+}
+
+static void nsi_sim_isr(uint32_t system, uint32_t channel) {
+    RMT.conf_ch[channel].conf1.tx_start = 0;
+    RMT.int_st.val = BIT(channel * 3 + 1);
+    if (system == NSI_SIM_N64) {
+        n64_isr(NULL);
+    }
+    else {
+        gc_isr(NULL);
+    }
+}
+
+/* Decode reply, every bit item must be exact and followed by the stop bit */
+static int32_t nsi_sim_tx(uint32_t channel, uint8_t *data, uint32_t max_len) {
+    volatile uint32_t *item = &RMTMEM.chan[channel].data32[0].val;
+    uint32_t bits = 0;
+
+    if (!RMT.conf_ch[channel].conf1.tx_start) {
+        return -1;
+    }
+    memset(data, 0, max_len);
+    for (; bits < max_len * 8; bits++, item++) {
+        if (*item == BIT_ONE) {
+            data[bits / 8] |= BIT(7 - (bits & 0x7));
+        }
+        else if (*item != BIT_ZERO) {
+            break;
+        }
+    }
+    if (*item != STOP_BIT_2US || (bits & 0x7)) {
+        return -2;
+    }
+    return bits / 8;
+}
+
+static void nsi_check_reply(const char *name, uint32_t channel, const uint8_t *exp, uint32_t exp_len) {
+    uint8_t data[40];
+    int32_t len = nsi_sim_tx(channel, data, sizeof(data));
+
+    TEST_CHECK(len == (int32_t)exp_len, "%s: reply len %d expected %u", name, len, exp_len);
+    if (len == (int32_t)exp_len) {
+        for (uint32_t i = 0; i < exp_len; i++) {
+            TEST_CHECK(data[i] == exp[i], "%s: reply byte %u 0x%02X expected 0x%02X", name, i, data[i], exp[i]);
+        }
+    }
+}
+
+static void nsi_n64_check(void) {
+    uint32_t ch = nsi_sim_channel(NSI_SIM_N64, 1);
+    uint8_t cmd[36], exp[33];
+    uint32_t addr = 0x1240;
+
+    /* Info, pad with a pak */
+    config.out_cfg[1].dev_mode = DEV_PAD;
+    config.out_cfg[1].acc_mode = ACC_MEM;
+    cmd[0] = 0x00;
+    nsi_sim_rx(ch, cmd, 1);
+    nsi_sim_isr(NSI_SIM_N64, ch);
+    nsi_check_reply("N64 info", ch, (uint8_t []){0x05, 0x00, N64_SLOT_OCCUPIED}, 3);
+
+    /* Poll, reply is the published frame */
+    nsi_sim_publish(1, (uint8_t []){0x81, 0x42, 0x7F, 0x80}, 4);
+    cmd[0] = 0x01;
+    nsi_sim_rx(ch, cmd, 1);
+    nsi_sim_isr(NSI_SIM_N64, ch);
+    nsi_check_reply("N64 poll", ch, (uint8_t []){0x81, 0x42, 0x7F, 0x80}, 4);
+
+    /* Pak read */
+    cmd[0] = 0x02;
+    cmd[1] = addr >> 8;
+    cmd[2] = (addr & 0xE0) | 0x15; /* Address CRC ignored */
+    memcpy(exp, pak_ref + addr, 32);
+    exp[32] = nsi_ref_crc(exp, 32);
+    nsi_sim_rx(ch, cmd, 3);
+    nsi_sim_isr(NSI_SIM_N64, ch);
+    nsi_check_reply("N64 pak read", ch, exp, 33);
+
+    /* Pak write, reply is data CRC and data land in pak */
+    cmd[0] = 0x03;
+    cmd[1] = 0x7F;
+    cmd[2] = 0xE0;
+    for (uint32_t i = 0; i < 32; i++) {
+        cmd[3 + i] = i * 37 + 11;
+    }
+    exp[0] = nsi_ref_crc(cmd + 3, 32);
+    nsi_sim_rx(ch, cmd, 35);
+    nsi_sim_isr(NSI_SIM_N64, ch);
+    nsi_check_reply("N64 pak write", ch, exp, 1);
+    TEST_CHECK(memcmp(mempak[1] + 0x7FE0, cmd + 3, 32) == 0, "N64 pak write: data not in pak");
+    TEST_CHECK(atomic_test_bit(mempak_dirty[1], 0x7FE0 / MEMPAK_SECTOR_SIZE), "N64 pak write: sector not dirty");
+
+    /* Rumble pak ident and motor */
+    config.out_cfg[1].acc_mode = ACC_RUMBLE;
+    cmd[0] = 0x02;
+    cmd[1] = 0x80;
+    cmd[2] = 0x01;
+    memcpy(exp, rumble_ident, 32);
+    exp[32] = nsi_ref_crc(exp, 32);
+    nsi_sim_rx(ch, cmd, 3);
+    nsi_sim_isr(NSI_SIM_N64, ch);
+    nsi_check_reply("N64 rumble ident", ch, exp, 33);
+
+    cmd[0] = 0x03;
+    cmd[1] = 0xC0;
+    cmd[2] = 0x1B;
+    memset(cmd + 3, 0x01, 32);
+    exp[0] = nsi_ref_crc(cmd + 3, 32);
+    nsi_sim_rx(ch, cmd, 35);
+    nsi_sim_isr(NSI_SIM_N64, ch);
+    nsi_check_reply("N64 rumble on", ch, exp, 1);
+    {
+        size_t len;
+        uint8_t *fb = xRingbufferReceive(wired_adapter.input_q_hdl, &len, 0);
+
+        TEST_CHECK(fb && len == 2 && fb[0] == 1 && fb[1] == 0x01, "N64 rumble on: no feedback queued");
+        if (fb) {
+            vRingbufferReturnItem(wired_adapter.input_q_hdl, fb);
+        }
+    }
+
+    /* Unknown command go back RX without reply */
+    cmd[0] = 0x13;
+    nsi_sim_rx(ch, cmd, 1);
+    nsi_sim_isr(NSI_SIM_N64, ch);
+    TEST_CHECK(!RMT.conf_ch[ch].conf1.tx_start && RMT.conf_ch[ch].conf1.rx_en, "N64 0x13: not back in RX");
+    config.out_cfg[1].acc_mode = ACC_MEM;
+}
+
+/* Pak bank files, writes reach the file and banks swap */
+static void nsi_pak_file_check(void) {
+    uint32_t ch = nsi_sim_channel(NSI_SIM_N64, 1);
+    uint8_t cmd[35], exp[33], data[32];
+    char filename[32];
+    FILE *file;
+
+    for (uint32_t bank = 2; bank < 4; bank++) {
+        sprintf(filename, MEMPAK_FILE, 1, bank);
+        remove(filename);
+    }
+    config.out_cfg[1].acc_mode = ACC_MEM;
+    nsi_mempak_load(1, 2);
+
+    cmd[0] = 0x03;
+    cmd[1] = 0x02;
+    cmd[2] = 0x20;
+    for (uint32_t i = 0; i < 32; i++) {
+        cmd[3 + i] = 0xFF - i * 3;
+    }
+    exp[0] = nsi_ref_crc(cmd + 3, 32);
+    nsi_sim_rx(ch, cmd, 35);
+    nsi_sim_isr(NSI_SIM_N64, ch);
+    nsi_check_reply("N64 pak file write", ch, exp, 1);
+
+    nsi_mempak_flush(1);
+    TEST_CHECK(!atomic_test_bit(mempak_dirty[1], 0x220 / MEMPAK_SECTOR_SIZE), "N64 pak file: sector still dirty");
+    sprintf(filename, MEMPAK_FILE, 1, 2);
+    file = fopen(filename, "rb");
+    TEST_CHECK(file, "N64 pak file: %s missing", filename);
+    if (file) {
+        fseek(file, 0x220, SEEK_SET);
+        TEST_CHECK(fread(data, 32, 1, file) == 1 && memcmp(data, cmd + 3, 32) == 0, "N64 pak file: write not flushed");
+        fclose(file);
+    }
+
+    /* New bank is blank, previous bank get its data back */
+    nsi_mempak_load(1, 3);
+    cmd[0] = 0x02;
+    memset(exp, 0, 32);
+    exp[32] = nsi_ref_crc(exp, 32);
+    nsi_sim_rx(ch, cmd, 3);
+    nsi_sim_isr(NSI_SIM_N64, ch);
+    nsi_check_reply("N64 pak file blank bank", ch, exp, 33);
+
+    nsi_mempak_load(1, 2);
+    memcpy(exp, cmd + 3, 32);
+    exp[32] = nsi_ref_crc(exp, 32);
+    nsi_sim_rx(ch, cmd, 3);
+    nsi_sim_isr(NSI_SIM_N64, ch);
+    nsi_check_reply("N64 pak file reload", ch, exp, 33);
+}
+
+static void nsi_gc_check(void) {
+    uint32_t ch = nsi_sim_channel(NSI_SIM_GC, 2);
+    const uint8_t frame[GC_FRAME_LEN] = {0x21, 0x80, 0x12, 0xEE, 0x80, 0x80, 0x00, 0x40};
+    uint8_t cmd[3];
+
+    cmd[0] = 0x00;
+    nsi_sim_rx(ch, cmd, 1);
+    nsi_sim_isr(NSI_SIM_GC, ch);
+    nsi_check_reply("GC info", ch, gc_ident, sizeof(gc_ident));
+
+    nsi_sim_publish(2, frame, sizeof(frame));
+    cmd[0] = 0x40;
+    cmd[1] = 0x03;
+    cmd[2] = 0x00;
+    nsi_sim_rx(ch, cmd, 3);
+    nsi_sim_isr(NSI_SIM_GC, ch);
+    nsi_check_reply("GC poll", ch, frame, sizeof(frame));
+
+    /* Origin, neutral reply then polls have origin bit cleared */
+    cmd[0] = 0x41;
+    nsi_sim_rx(ch, cmd, 1);
+    nsi_sim_isr(NSI_SIM_GC, ch);
+    nsi_check_reply("GC origin", ch, gc_neutral, sizeof(gc_neutral));
+    cmd[0] = 0x40;
+    nsi_sim_rx(ch, cmd, 3);
+    nsi_sim_isr(NSI_SIM_GC, ch);
+    nsi_check_reply("GC poll after origin", ch, (uint8_t []){0x01, 0x80, 0x12, 0xEE, 0x80, 0x80, 0x00, 0x40}, 8);
+}
+
+/* Host cycles spent in ISR per command, RX decode to TX start */
+static void nsi_bench(uint32_t system, const struct nsi_sim_cmd *sim_cmd) {
+    uint32_t ch = nsi_sim_channel(system, 0);
+    uint64_t sum = 0, max = 0;
+
+    for (uint32_t i = 0; i < NSI_SIM_RUNS; i++) {
+        uint64_t start, cycles;
+
+        nsi_sim_rx(ch, sim_cmd->cmd, sim_cmd->len);
+        start = test_cycles();
+        nsi_sim_isr(system, ch);
+        cycles = test_cycles() - start;
+        sum += cycles;
+        if (cycles > max) {
+            max = cycles;
+        }
+        /* Drain feedback so queue never fill */
+        while (1) {
+            size_t len;
+            void *fb = xRingbufferReceive(wired_adapter.input_q_hdl, &len, 0);
+
+            if (fb == NULL) {
+                break;
+            }
+            vRingbufferReturnItem(wired_adapter.input_q_hdl, fb);
+        }
+    }
+    printf("%-16s %8u %8u\n", sim_cmd->name, (uint32_t)(sum / NSI_SIM_RUNS), (uint32_t)max);
+}
+
+int main(int argc, char **argv) {
+    static const struct nsi_sim_cmd n64_cmds[] = {
+        {"N64 0x00 info", NSI_SIM_N64, 1, {0x00}},
+        {"N64 0x01 poll", NSI_SIM_N64, 1, {0x01}},
+        {"N64 0x02 read", NSI_SIM_N64, 3, {0x02, 0x03, 0x20}},
+        {"N64 0x03 write", NSI_SIM_N64, 35, {0x03, 0x03, 0x20, 0x55, 0xAA}},
+    };
+    static const struct nsi_sim_cmd gc_cmds[] = {
+        {"GC 0x00 info", NSI_SIM_GC, 1, {0x00}},
+        {"GC 0x40 poll", NSI_SIM_GC, 3, {0x40, 0x03, 0x00}},
+        {"GC 0x41 origin", NSI_SIM_GC, 1, {0x41}},
+    };
+
+    adapter_init();
+    config_init();
+
+    /* N64 pak per port, as loaded by nsi_mempak_task */
+    for (uint32_t i = 0; i < sizeof(pak_ref); i++) {
+        pak_ref[i] = (i * 7) ^ (i >> 8);
+    }
+    for (uint32_t i = 0; i < ARRAY_SIZE(mempak); i++) {
+        mempak[i] = malloc(MEMPAK_SIZE);
+        memcpy(mempak[i], pak_ref, MEMPAK_SIZE);
+        mempak_bank[i] = 0;
+    }
+
+    /* Reference CRC self check, a zero block CRC is known */
+    TEST_CHECK(nsi_ref_crc(empty, 32) == 0x00, "reference CRC of zero block 0x%02X", nsi_ref_crc(empty, 32));
+
+    wired_adapter.system_id = N64;
+    nsi_init();
+    nsi_n64_check();
+    nsi_pak_file_check();
+    printf("ISR host cycles per command\n%-16s %8s %8s\n", "", "avg", "max");
+    for (uint32_t i = 0; i < ARRAY_SIZE(n64_cmds); i++) {
+        nsi_bench(NSI_SIM_N64, &n64_cmds[i]);
+    }
+
+    wired_adapter.system_id = GC;
+    nsi_init();
+    nsi_gc_check();
+    for (uint32_t i = 0; i < ARRAY_SIZE(gc_cmds); i++) {
+        nsi_bench(NSI_SIM_GC, &gc_cmds[i]);
+    }
+
+    return TEST_RESULT();
+}
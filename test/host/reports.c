@@ -0,0 +1,182 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include "zephyr/types.h"
+#include "util.h"
+#include "adapter.h"
+#include "hid_parser.h"
+#include "reports.h"
+
+/* 16 buttons, hat, X/Y/Z/Rz 8 bits gamepad */
+static const uint8_t hid_pad_desc[] = {
+    0x05, 0x01, 0x09, 0x05, 0xA1, 0x01, 0x85, 0x01,
+    0x05, 0x09, 0x19, 0x01, 0x29, 0x10, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x10, 0x81, 0x02,
+    0x05, 0x01, 0x09, 0x39, 0x15, 0x00, 0x25, 0x07, 0x75, 0x04, 0x95, 0x01, 0x81, 0x42,
+    0x75, 0x04, 0x95, 0x01, 0x81, 0x01,
+    0x09, 0x30, 0x09, 0x31, 0x09, 0x32, 0x09, 0x35, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x04, 0x81, 0x02,
+    0xC0,
+};
+
+/* btns[2], hat, X, Y, Z, Rz */
+static const struct host_report hid_pad_reports[] = {
+    {7, {0x00, 0x00, 0x08, 0x80, 0x80, 0x80, 0x80}},
+    {7, {0x01, 0x00, 0x08, 0x80, 0x80, 0x80, 0x80}},
+    {7, {0x00, 0x00, 0x00, 0x80, 0x80, 0x80, 0x80}},
+    {7, {0x00, 0x00, 0x08, 0xFF, 0x80, 0x80, 0x80}},
+    {7, {0x00, 0x00, 0x08, 0x00, 0x00, 0x80, 0x80}},
+    {7, {0x00, 0x00, 0x08, 0xC0, 0x40, 0x20, 0xE0}},
+    {7, {0x03, 0x80, 0x02, 0xA0, 0x60, 0x80, 0x80}},
+    {7, {0x00, 0x00, 0x08, 0x84, 0x7B, 0x80, 0x80}},
+};
+
+/* btns[4], rsv, LX, LY, RX, RY, rsv[8], L2, R2 */
+static const struct host_report ps3_reports[] = {
+    {19, {0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x80, 0x80, 0x80}},
+    {19, {0x00, 0x40, 0x00, 0x00, 0x00, 0x80, 0x80, 0x80, 0x80}},
+    {19, {0x10, 0x00, 0x00, 0x00, 0x00, 0x80, 0x80, 0x80, 0x80}},
+    {19, {0x00, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x80, 0x80, 0x80}},
+    {19, {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x80}},
+    {19, {0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x40, 0x20, 0xE0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0x40}},
+    {19, {0x01, 0x24, 0x00, 0x00, 0x00, 0xA0, 0x60, 0x80, 0x80, 0, 0, 0, 0, 0, 0, 0, 0, 0x80, 0x00}},
+    {19, {0x00, 0x00, 0x00, 0x00, 0x00, 0x84, 0x7B, 0x80, 0x80}},
+};
+
+/* core btns[2] */
+static const struct host_report wii_reports[] = {
+    {2, {0x00, 0x00}},
+    {2, {0x00, 0x08}},
+    {2, {0x08, 0x00}},
+    {2, {0x01, 0x00}},
+    {2, {0x02, 0x04}},
+    {2, {0x10, 0x02}},
+    {2, {0x04, 0x01}},
+    {2, {0x00, 0x00}},
+};
+
+/* core btns[2], acc[3], SX, SY, acc[3], btns (active low) */
+static const struct host_report wiin_reports[] = {
+    {11, {0x00, 0x00, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x03}},
+    {11, {0x00, 0x00, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x02}},
+    {11, {0x00, 0x08, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x03}},
+    {11, {0x00, 0x00, 0x80, 0x80, 0x80, 0xE3, 0x80, 0x80, 0x80, 0x80, 0x03}},
+    {11, {0x00, 0x00, 0x80, 0x80, 0x80, 0x1D, 0x1D, 0x80, 0x80, 0x80, 0x03}},
+    {11, {0x02, 0x00, 0x80, 0x80, 0x80, 0xC0, 0x40, 0x80, 0x80, 0x80, 0x01}},
+    {11, {0x00, 0x04, 0x80, 0x80, 0x80, 0xA0, 0x60, 0x80, 0x80, 0x80, 0x00}},
+    {11, {0x00, 0x00, 0x80, 0x80, 0x80, 0x83, 0x7D, 0x80, 0x80, 0x80, 0x03}},
+};
+
+/* core btns[2], acc[3], packed axes[4], btns[2] (active low) */
+static const struct host_report wiic_reports[] = {
+    {11, {0x00, 0x00, 0x80, 0x80, 0x80, 0xA0, 0x20, 0x10, 0x42, 0xFF, 0xFF}},
+    {11, {0x00, 0x00, 0x80, 0x80, 0x80, 0xA0, 0x20, 0x10, 0x42, 0xFF, 0xEF}},
+    {11, {0x00, 0x00, 0x80, 0x80, 0x80, 0xA0, 0x20, 0x10, 0x42, 0xFE, 0xFF}},
+    {11, {0x00, 0x00, 0x80, 0x80, 0x80, 0xBB, 0x20, 0x10, 0x42, 0xFF, 0xFF}},
+    {11, {0x00, 0x00, 0x80, 0x80, 0x80, 0x85, 0x05, 0x10, 0x42, 0xFF, 0xFF}},
+    {11, {0x00, 0x00, 0x80, 0x80, 0x80, 0xB0, 0x10, 0x98, 0xFD, 0xFF, 0xFF}},
+    {11, {0x00, 0x00, 0x80, 0x80, 0x80, 0xA8, 0x18, 0x10, 0x42, 0x7B, 0xDF}},
+    {11, {0x00, 0x00, 0x80, 0x80, 0x80, 0xA1, 0x1F, 0x10, 0x42, 0xFF, 0xFF}},
+};
+
+/* rsv[5], LX, RX, LY, RY 16 bits, btns[4] (active low) */
+static const struct host_report wiiu_reports[] = {
+    {17, {0, 0, 0, 0, 0, 0x00, 0x08, 0x00, 0x08, 0x00, 0x08, 0x00, 0x08, 0xFF, 0xFF, 0xFF, 0xFF}},
+    {17, {0, 0, 0, 0, 0, 0x00, 0x08, 0x00, 0x08, 0x00, 0x08, 0x00, 0x08, 0xFF, 0xEF, 0xFF, 0xFF}},
+    {17, {0, 0, 0, 0, 0, 0x00, 0x08, 0x00, 0x08, 0x00, 0x08, 0x00, 0x08, 0x7F, 0xFF, 0xFF, 0xFF}},
+    {17, {0, 0, 0, 0, 0, 0x4C, 0x0C, 0x00, 0x08, 0x00, 0x08, 0x00, 0x08, 0xFF, 0xFF, 0xFF, 0xFF}},
+    {17, {0, 0, 0, 0, 0, 0xB4, 0x03, 0x00, 0x08, 0xB4, 0x03, 0x00, 0x08, 0xFF, 0xFF, 0xFF, 0xFF}},
+    {17, {0, 0, 0, 0, 0, 0x00, 0x0B, 0x00, 0x05, 0x00, 0x06, 0x00, 0x0A, 0xFF, 0xFD, 0xFF, 0xFF}},
+    {17, {0, 0, 0, 0, 0, 0x80, 0x09, 0x80, 0x07, 0x00, 0x08, 0x00, 0x08, 0xDF, 0x7F, 0xFE, 0xFF}},
+    {17, {0, 0, 0, 0, 0, 0x10, 0x08, 0x00, 0x08, 0xF0, 0x07, 0x00, 0x08, 0xFF, 0xFF, 0xFF, 0xFF}},
+};
+
+/* rsv[2], LX, LY, RX, RY, hat/btns[3], L2, R2 */
+static const struct host_report ps4_reports[] = {
+    {11, {0xC0, 0x00, 0x80, 0x80, 0x80, 0x80, 0x08, 0x00, 0x00, 0x00, 0x00}},
+    {11, {0xC0, 0x00, 0x80, 0x80, 0x80, 0x80, 0x28, 0x00, 0x00, 0x00, 0x00}},
+    {11, {0xC0, 0x00, 0x80, 0x80, 0x80, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00}},
+    {11, {0xC0, 0x00, 0xFF, 0x80, 0x80, 0x80, 0x08, 0x00, 0x00, 0x00, 0x00}},
+    {11, {0xC0, 0x00, 0x00, 0x00, 0x80, 0x80, 0x08, 0x00, 0x00, 0x00, 0x00}},
+    {11, {0xC0, 0x00, 0xC0, 0x40, 0x20, 0xE0, 0x08, 0x0C, 0x00, 0xFF, 0x40}},
+    {11, {0xC0, 0x00, 0xA0, 0x60, 0x80, 0x80, 0x92, 0x31, 0x00, 0x80, 0x00}},
+    {11, {0xC0, 0x00, 0x84, 0x7B, 0x80, 0x80, 0x08, 0x00, 0x00, 0x00, 0x00}},
+};
+
+/* LX, LY, RX, RY, LT, RT 16 bits, hat, btns[4] */
+static const struct host_report xb1_reports[] = {
+    {17, {0x00, 0x80, 0x00, 0x80, 0x00, 0x80, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}},
+    {17, {0x00, 0x80, 0x00, 0x80, 0x00, 0x80, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00}},
+    {17, {0x00, 0x80, 0x00, 0x80, 0x00, 0x80, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00}},
+    {17, {0xFF, 0xFF, 0x00, 0x80, 0x00, 0x80, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}},
+    {17, {0x00, 0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}},
+    {17, {0x00, 0xC0, 0x00, 0x40, 0x00, 0x20, 0x00, 0xE0, 0xFF, 0x03, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00}},
+    {17, {0x00, 0xA0, 0x00, 0x60, 0x00, 0x80, 0x00, 0x80, 0x00, 0x02, 0x00, 0x00, 0x03, 0x18, 0x20, 0x00, 0x00}},
+    {17, {0x00, 0x84, 0x00, 0x7B, 0x00, 0x80, 0x00, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}},
+};
+
+/* btns[2], hat, LX, LY, RX, RY 16 bits */
+static const struct host_report sw_reports[] = {
+    {11, {0x00, 0x00, 0x08, 0x00, 0x80, 0x00, 0x80, 0x00, 0x80, 0x00, 0x80}},
+    {11, {0x02, 0x00, 0x08, 0x00, 0x80, 0x00, 0x80, 0x00, 0x80, 0x00, 0x80}},
+    {11, {0x00, 0x00, 0x00, 0x00, 0x80, 0x00, 0x80, 0x00, 0x80, 0x00, 0x80}},
+    {11, {0x00, 0x00, 0x08, 0xEC, 0xDE, 0x00, 0x80, 0x00, 0x80, 0x00, 0x80}},
+    {11, {0x00, 0x00, 0x08, 0x14, 0x21, 0x14, 0x21, 0x00, 0x80, 0x00, 0x80}},
+    {11, {0x00, 0x00, 0x08, 0x00, 0xC0, 0x00, 0x40, 0x00, 0x20, 0x00, 0xE0}},
+    {11, {0x41, 0x84, 0x02, 0x00, 0xA0, 0x00, 0x60, 0x00, 0x80, 0x00, 0x80}},
+    {11, {0x00, 0x00, 0x08, 0x00, 0x84, 0x00, 0x7B, 0x00, 0x80, 0x00, 0x80}},
+};
+
+#define REPORT_SET(type, id, set) \
+    [type] = {type, #type, id, NULL, 0, ARRAY_SIZE(set), set}
+
+const struct host_report_set host_report_sets[BT_MAX] = {
+    [HID_GENERIC] = {HID_GENERIC, "HID_GENERIC", 0x01, hid_pad_desc, sizeof(hid_pad_desc),
+        ARRAY_SIZE(hid_pad_reports), hid_pad_reports},
+    REPORT_SET(PS3_DS3, 0x01, ps3_reports),
+    REPORT_SET(WII_CORE, 0x35, wii_reports),
+    REPORT_SET(WII_NUNCHUCK, 0x35, wiin_reports),
+    REPORT_SET(WII_CLASSIC, 0x35, wiic_reports),
+    REPORT_SET(WIIU_PRO, 0x3D, wiiu_reports),
+    REPORT_SET(PS4_DS4, 0x11, ps4_reports),
+    REPORT_SET(XB1_S, 0x01, xb1_reports),
+    REPORT_SET(XB1_ADAPTIVE, 0x01, xb1_reports),
+    REPORT_SET(SW, 0x3F, sw_reports),
+};
+
+void host_report_dev_init(const struct host_report_set *set, uint8_t dev_id) {
+    static struct hid_report hid_reports[BT_MAX][REPORT_MAX];
+    static uint32_t hid_parsed;
+    struct bt_data *bt_data = &bt_adapter.data[dev_id];
+
+    memset((void *)bt_data, 0, sizeof(*bt_data));
+    bt_data->dev_id = dev_id;
+    bt_data->dev_type = set->dev_type;
+    if (set->hid_desc) {
+        /* Parse once, parser is verbose */
+        if (!(hid_parsed & BIT(set->dev_type))) {
+            hid_parser(bt_data, (uint8_t *)set->hid_desc, set->hid_desc_len);
+            memcpy(hid_reports[set->dev_type], bt_data->reports, sizeof(bt_data->reports));
+            hid_parsed |= BIT(set->dev_type);
+        }
+        memcpy(bt_data->reports, hid_reports[set->dev_type], sizeof(bt_data->reports));
+    }
+}
+
+void host_report_bridge(const struct host_report_set *set, uint8_t dev_id, uint32_t idx) {
+    struct bt_data *bt_data = &bt_adapter.data[dev_id];
+    const struct host_report *report = &set->reports[idx % set->cnt];
+
+    if (set->dev_type == HID_GENERIC) {
+        for (uint32_t i = 0; i < REPORT_MAX; i++) {
+            if (bt_data->reports[i].id == set->report_id) {
+                bt_data->report_type = i;
+                break;
+            }
+        }
+    }
+    bt_data->report_id = set->report_id;
+    memcpy(bt_data->input, report->data, report->len);
+    adapter_bridge(bt_data);
+}
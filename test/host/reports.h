@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _REPORTS_H_
+#define _REPORTS_H_
+
+#include <stdint.h>
+#include "adapter.h"
+
+#define HOST_REPORT_LEN 32
+
+/* Input reports recorded from each BT device type, as passed to
+ * bt_host_bridge() (HIDP header and report ID stripped). First report
+ * of each set is at rest and is used for axes calibration.
+ */
+struct host_report {
+    uint8_t len;
+    uint8_t data[HOST_REPORT_LEN];
+};
+
+struct host_report_set {
+    int32_t dev_type;
+    const char *name;
+    uint8_t report_id;
+    const uint8_t *hid_desc;
+    uint32_t hid_desc_len;
+    uint32_t cnt;
+    const struct host_report *reports;
+};
+
+extern const struct host_report_set host_report_sets[BT_MAX];
+
+/* Set bt_adapter.data[dev_id] as if the device just connected */
+void host_report_dev_init(const struct host_report_set *set, uint8_t dev_id);
+/* Feed report idx of the set to adapter_bridge() like bt_host_bridge() */
+void host_report_bridge(const struct host_report_set *set, uint8_t dev_id, uint32_t idx);
+
+#endif /* _REPORTS_H_ */
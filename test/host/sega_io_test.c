@@ -0,0 +1,480 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdint.h>
+
+/* Output registers are write only, sega_io_host.c is sega_io.c with
+ * GPIO.out*_w1ts/w1tc writes routed here so lines state is kept.
+ */
+static uint32_t out0, out1;
+
+static void host_gpio_out_w1ts(uint32_t val) {
+    out0 |= val;
+}
+
+static void host_gpio_out_w1tc(uint32_t val) {
+    out0 &= ~val;
+}
+
+static void host_gpio_out1_w1ts(uint32_t val) {
+    out1 |= val;
+}
+
+static void host_gpio_out1_w1tc(uint32_t val) {
+    out1 &= ~val;
+}
+
+#include "sega_io_host.c"
+#include "test.h"
+
+/* Console side replay: TH & TR edges are set on inputs and the ISR is run
+ * like the GPIO interrupt would, for one or both ports at once. Lines set
+ * by the ISR are checked against the frames published by the adapter.
+ */
+
+#define SIO_TEST_POLLS 5000
+
+static uint32_t in0, in1;
+
+static uint32_t sio_test_lvl(uint8_t pin) {
+    if (pin < 32) {
+        return !!(out0 & BIT(pin));
+    }
+    return !!(out1 & BIT(pin - 32));
+}
+
+static uint8_t sio_test_nibble(uint32_t port) {
+    return (sio_test_lvl(gpio_pin[port][SIO_R]) << 3) | (sio_test_lvl(gpio_pin[port][SIO_L]) << 2)
+        | (sio_test_lvl(gpio_pin[port][SIO_D]) << 1) | sio_test_lvl(gpio_pin[port][SIO_U]);
+}
+
+static uint32_t sio_test_tl(uint32_t port) {
+    return sio_test_lvl(gpio_pin[port][SIO_TL]);
+}
+
+static void sio_test_isr(uint32_t low_io, uint32_t high_io) {
+    GPIO.in = in0;
+    GPIO.in1.val = in1;
+    GPIO.acpu_int = low_io;
+    GPIO.acpu_int1.intr = high_io;
+    sega_io_isr(NULL);
+}
+
+static uint32_t sio_test_th(uint32_t port, uint32_t level) {
+    const uint32_t mask = BIT(gpio_pin[port][SIO_TH] - 32);
+
+    if (level) {
+        in1 |= mask;
+    }
+    else {
+        in1 &= ~mask;
+    }
+    return mask;
+}
+
+static uint32_t sio_test_tr(uint32_t port, uint32_t level) {
+    const uint32_t mask = BIT(gpio_pin[port][SIO_TR]);
+
+    if (level) {
+        in0 |= mask;
+    }
+    else {
+        in0 &= ~mask;
+    }
+    return mask;
+}
+
+static void sio_test_publish(uint32_t wired_id) {
+    for (uint32_t i = 0; i < 8; i++) {
+        wired_adapter.data[wired_id].output[i] = rand();
+    }
+    adapter_test_publish(wired_id, NULL);
+}
+
+/* TWH bytes expected from current frames */
+static uint32_t sio_test_saturn_expect(uint32_t mt, uint32_t first, const uint8_t *modes, uint8_t *data) {
+    uint32_t len = 0;
+
+    if (mt) {
+        data[len++] = 0x41;
+        data[len++] = 0x60;
+    }
+    for (uint32_t i = first; i < first + (mt ? MT_PORT_MAX : 1); i++) {
+        const uint8_t *frame = wired_frame(&wired_adapter.data[i]);
+
+        if (modes[i] == DEV_PAD) {
+            data[len++] = 0x02;
+            memcpy(&data[len], frame, 2);
+            len += 2;
+        }
+        else {
+            data[len++] = 0x16;
+            memcpy(&data[len], frame, 6);
+            len += 6;
+        }
+    }
+    return len;
+}
+
+/* Both ports read together, TR edges land in the same ISR or not, some
+ * reads aborted by TH going high mid frame. Outputs get published mid read.
+ */
+static void sio_test_saturn(uint32_t mt_cfg) {
+    const uint32_t mt[2] = {mt_cfg == MT_SLOT_1 || mt_cfg == MT_DUAL, mt_cfg == MT_SLOT_2 || mt_cfg == MT_DUAL};
+    const uint32_t first[2] = {0, mt[0] ? MT_PORT_MAX : 1};
+    uint8_t modes[WIRED_MAX_DEV];
+    uint32_t full = 0, aborted = 0;
+
+    srand(2);
+    wired_adapter.system_id = SATURN;
+    config.global_cfg.multitap_cfg = mt_cfg;
+    for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
+        modes[i] = (rand() & 1) ? DEV_PAD : DEV_PAD_ALT;
+        config.out_cfg[i].dev_mode = modes[i];
+    }
+    for (uint32_t port = 0; port < 2; port++) {
+        sio_test_th(port, 1);
+        sio_test_tr(port, 1);
+    }
+    sega_io_init();
+
+    for (uint32_t poll = 0; poll < SIO_TEST_POLLS && !test_fail_cnt; poll++) {
+        uint8_t exp[2][TWH_DATA_MAX];
+        uint8_t nibbles[2][TWH_NIBBLE_MAX];
+        uint32_t len[2], step[2] = {0}, abort_at[2], done[2] = {0};
+
+        for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
+            if (rand() & 1) {
+                sio_test_publish(i);
+            }
+        }
+        for (uint32_t port = 0; port < 2; port++) {
+            len[port] = sio_test_saturn_expect(mt[port], first[port], modes, exp[port]);
+            abort_at[port] = (rand() % 4 == 0) ? rand() % (len[port] * 2 + 2) : ~0;
+        }
+
+        /* TH low on both ports in same ISR */
+        sio_test_isr(0, sio_test_th(0, 0) | sio_test_th(1, 0));
+        for (uint32_t port = 0; port < 2; port++) {
+            TEST_CHECK(sio_test_nibble(port) == 0x1 && sio_test_tl(port), "poll %u port %u: ID0 2nd nibble", poll, port);
+        }
+
+        while (!done[0] || !done[1]) {
+            uint32_t low_io = 0;
+            uint32_t edge[2] = {0};
+
+            for (uint32_t port = 0; port < 2; port++) {
+                if (done[port]) {
+                    continue;
+                }
+                if (step[port] == abort_at[port]) {
+                    sio_test_isr(0, sio_test_th(port, 1));
+                    TEST_CHECK(sio_test_nibble(port) == 0x1 && sio_test_tl(port), "poll %u port %u: abort end state", poll, port);
+                    done[port] = 1;
+                    aborted++;
+                    continue;
+                }
+                if (rand() & 1) {
+                    low_io |= sio_test_tr(port, step[port] & 0x1);
+                    edge[port] = 1;
+                }
+            }
+            if (!low_io) {
+                continue;
+            }
+            /* Publishes while reading must not change the frame being sent */
+            if (rand() % 4 == 0) {
+                sio_test_publish(rand() % WIRED_MAX_DEV);
+            }
+            sio_test_isr(low_io, 0);
+            for (uint32_t port = 0; port < 2; port++) {
+                if (!edge[port]) {
+                    continue;
+                }
+                TEST_CHECK(sio_test_tl(port) == (step[port] & 0x1), "poll %u port %u step %u: TL", poll, port, step[port]);
+                nibbles[port][step[port]] = sio_test_nibble(port);
+                if (++step[port] < len[port] * 2 + 2) {
+                    continue;
+                }
+                TEST_CHECK(nibbles[port][step[port] - 2] == 0x0 && nibbles[port][step[port] - 1] == 0x1,
+                    "poll %u port %u: end nibbles", poll, port);
+                for (uint32_t i = 0; i < len[port]; i++) {
+                    uint8_t byte = (nibbles[port][2 * i] << 4) | nibbles[port][2 * i + 1];
+
+                    TEST_CHECK(byte == exp[port][i], "poll %u port %u byte %u: %02X != %02X", poll, port, i, byte, exp[port][i]);
+                }
+                /* Spurious TR edge after end must not change lines */
+                sio_test_isr(sio_test_tr(port, 0), 0);
+                TEST_CHECK(sio_test_nibble(port) == 0x1 && sio_test_tl(port), "poll %u port %u: idle after end", poll, port);
+                sio_test_isr(0, sio_test_th(port, 1));
+                TEST_CHECK(sio_test_nibble(port) == 0x1 && sio_test_tl(port), "poll %u port %u: TH high", poll, port);
+                done[port] = 1;
+                full++;
+            }
+        }
+        sio_test_tr(0, 1);
+        sio_test_tr(1, 1);
+    }
+    printf("# %s: multitap %u, %u full frames, %u aborted\n", __FUNCTION__, mt_cfg, full, aborted);
+}
+
+static uint32_t sio_test_tl_in(uint32_t port, uint32_t level) {
+    const uint32_t mask = BIT(gpio_pin[port][SIO_TL] - 32);
+
+    if (level) {
+        in1 |= mask;
+    }
+    else {
+        in1 &= ~mask;
+    }
+    return mask;
+}
+
+static uint8_t gen_modes[WIRED_MAX_DEV];
+static int32_t gen_pos[WIRED_MAX_DEV][2];
+static int32_t gen_read_pos[WIRED_MAX_DEV][2];
+static uint8_t gen_btns[WIRED_MAX_DEV];
+/* Outputs when a read start, what the console must get */
+static uint16_t gen_snap_input[WIRED_MAX_DEV];
+static int32_t gen_snap_pos[WIRED_MAX_DEV][2];
+static uint8_t gen_snap_btns[WIRED_MAX_DEV];
+
+/* segaio mouse frame: buttons then wrapping absolute position */
+static void sio_test_publish_mouse(uint32_t wired_id) {
+    uint8_t *output = wired_adapter.data[wired_id].output;
+
+    gen_btns[wired_id] = rand() & 0xF;
+    for (uint32_t i = 0; i < 2; i++) {
+        int32_t motion = (rand() % 3 == 0) ? (rand() % 1200) - 600 : (rand() % 60) - 30;
+
+        gen_pos[wired_id][i] = (int32_t)((uint32_t)gen_pos[wired_id][i] + (uint32_t)motion);
+    }
+    output[0] = gen_btns[wired_id];
+    memcpy(&output[1], gen_pos[wired_id], sizeof(gen_pos[0]));
+    adapter_test_publish(wired_id, NULL);
+}
+
+static void sio_test_gen_publish(uint32_t wired_id) {
+    if (gen_modes[wired_id] == DEV_MOUSE) {
+        sio_test_publish_mouse(wired_id);
+    }
+    else {
+        sio_test_publish(wired_id);
+    }
+}
+
+static void sio_test_gen_snap(void) {
+    for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
+        gen_snap_input[i] = *(uint16_t *)wired_frame(&wired_adapter.data[i]);
+        memcpy(gen_snap_pos[i], gen_pos[i], sizeof(gen_pos[0]));
+        gen_snap_btns[i] = gen_btns[i];
+    }
+}
+
+/* Read cnt nibbles or less if aborted, 1 in 4 reads are */
+static uint32_t sio_test_twh_cnt(uint32_t len) {
+    return (rand() % 4 == 0) ? rand() % len : len;
+}
+
+/* TH low then one nibble per TR edge, TL must follow TR. Outputs get
+ * published mid read, TH high after cnt nibbles.
+ */
+static void sio_test_twh_read(uint32_t port, uint32_t cnt, uint8_t *nibbles, uint8_t start) {
+    sio_test_gen_snap();
+    sio_test_isr(0, sio_test_th(port, 0));
+    TEST_CHECK(sio_test_nibble(port) == start, "port %u: start nibble %X", port, sio_test_nibble(port));
+    for (uint32_t i = 0; i < cnt; i++) {
+        if (rand() % 4 == 0) {
+            sio_test_gen_publish(rand() % WIRED_MAX_DEV);
+        }
+        sio_test_isr(sio_test_tr(port, i & 0x1), 0);
+        TEST_CHECK(sio_test_tl(port) == (i & 0x1), "port %u nibble %u: TL", port, i);
+        nibbles[i] = sio_test_nibble(port);
+    }
+    sio_test_tr(port, 1);
+    sio_test_isr(0, sio_test_th(port, 1));
+}
+
+/* Motion since last read clamped to 9 bits with overflow flags, read
+ * once host asked the nibble after it or ended a full read.
+ */
+static void sio_test_mouse_check(uint32_t wired_id, const uint8_t *nibbles, uint32_t read) {
+    TEST_CHECK(nibbles[1] == gen_snap_btns[wired_id], "mouse %u: buttons %X != %X", wired_id, nibbles[1], gen_snap_btns[wired_id]);
+    for (uint32_t i = 0; i < 2; i++) {
+        int32_t delta = (int32_t)((uint32_t)gen_snap_pos[wired_id][i] - (uint32_t)gen_read_pos[wired_id][i]);
+        uint32_t over = 0;
+        uint32_t sign = !!(nibbles[0] & (MOUSE_X_SIGN << i));
+        int32_t value = (nibbles[2 + 2 * i] << 4) | nibbles[3 + 2 * i];
+
+        if (delta > 255) {
+            delta = 255;
+            over = 1;
+        }
+        else if (delta < -256) {
+            delta = -256;
+            over = 1;
+        }
+        if (sign) {
+            value -= 256;
+        }
+        TEST_CHECK(value == delta && over == !!(nibbles[0] & (MOUSE_X_OVER << i)) && sign == (delta < 0),
+            "mouse %u axis %u: %d != %d over %u", wired_id, i, value, delta, over);
+        /* Anything past overflow is dropped */
+        if (read) {
+            gen_read_pos[wired_id][i] = gen_snap_pos[wired_id][i];
+        }
+    }
+}
+
+/* Lines on a 3 buttons pad port: TR, TL, R, L, D, U */
+static uint8_t sio_test_pins6(uint32_t port) {
+    return (sio_test_lvl(gpio_pin[port][SIO_TR]) << 5) | (sio_test_tl(port) << 4) | sio_test_nibble(port);
+}
+
+/* TH high: C B R L D U, TH low: S A 0 0 D U */
+static uint8_t sio_test_pins6_expect(uint16_t input, uint32_t th) {
+    if (th) {
+        return (((input >> 1) & 0x1) << 5) | ((input & 0x1) << 4) | ((input >> 4) & 0xF);
+    }
+    return (((input >> 3) & 0x1) << 5) | (((input >> 2) & 0x1) << 4) | ((input >> 4) & 0x3);
+}
+
+/* Genesis console reads: Team Player, EA 4-Way Play, Mega Mouse or pads */
+static void sio_test_genesis(uint32_t mt_cfg, uint32_t all_mice) {
+    const uint32_t tp[2] = {mt_cfg == MT_SLOT_1 || mt_cfg == MT_DUAL, mt_cfg == MT_SLOT_2 || mt_cfg == MT_DUAL};
+    const uint32_t first[2] = {0, tp[0] ? GEN_MT_PORT_MAX : 1};
+    uint32_t reads = 0;
+
+    srand(3);
+    /* Far apart so 6 buttons pads never cycle */
+    host_ccount_step = CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ * 1000;
+    wired_adapter.system_id = GENESIS;
+    config.global_cfg.multitap_cfg = mt_cfg;
+    for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
+        uint32_t r = rand() % 3;
+
+        gen_modes[i] = all_mice ? DEV_MOUSE : (r == 0) ? DEV_PAD : (r == 1) ? DEV_PAD_ALT : DEV_MOUSE;
+        config.out_cfg[i].dev_mode = gen_modes[i];
+        /* Start close to wrap around */
+        gen_pos[i][0] = INT32_MAX - 2000;
+        gen_pos[i][1] = INT32_MIN + 2000;
+    }
+    for (uint32_t port = 0; port < 2; port++) {
+        sio_test_th(port, 1);
+        sio_test_tr(port, 1);
+    }
+    sio_test_tl_in(1, 1);
+    GPIO.in = in0;
+    GPIO.in1.val = in1;
+    for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
+        sio_test_gen_publish(i);
+    }
+    sega_io_init();
+
+    for (uint32_t poll = 0; poll < SIO_TEST_POLLS && !test_fail_cnt; poll++) {
+        for (uint32_t i = 0; i < WIRED_MAX_DEV; i++) {
+            if (rand() & 1) {
+                sio_test_gen_publish(i);
+            }
+        }
+
+        if (mt_cfg == MT_ALT) {
+            /* Detect, port 2 TH high and port 1 U & D low with TH low */
+            sio_test_isr(0, sio_test_th(1, 1));
+            sio_test_isr(0, sio_test_th(0, 0));
+            TEST_CHECK((sio_test_pins6(0) & 0x3) == 0, "poll %u: EA detect", poll);
+            sio_test_isr(0, sio_test_th(0, 1));
+            for (uint32_t pad = 0; pad < 4; pad++) {
+                uint16_t input = *(uint16_t *)wired_frame(&wired_adapter.data[pad]);
+
+                sio_test_tl_in(1, pad & 0x1);
+                sio_test_isr(sio_test_tr(1, pad >> 1), sio_test_th(1, 0) | BIT(gpio_pin[1][SIO_TL] - 32));
+                TEST_CHECK(sio_test_pins6(0) == sio_test_pins6_expect(input, 1), "poll %u pad %u: EA TH high", poll, pad);
+                sio_test_isr(0, sio_test_th(0, 0));
+                TEST_CHECK(sio_test_pins6(0) == sio_test_pins6_expect(input, 0), "poll %u pad %u: EA TH low", poll, pad);
+                sio_test_isr(0, sio_test_th(0, 1));
+                reads++;
+            }
+            continue;
+        }
+
+        for (uint32_t port = 0; port < 2; port++) {
+            uint8_t nibbles[TWH_NIBBLE_MAX];
+
+            if (tp[port]) {
+                uint32_t len = 2 + GEN_MT_PORT_MAX;
+                uint32_t k = len;
+                uint32_t cnt;
+
+                for (uint32_t i = first[port]; i < first[port] + GEN_MT_PORT_MAX; i++) {
+                    len += (gen_modes[i] == DEV_PAD) ? 2 : (gen_modes[i] == DEV_PAD_ALT) ? 3 : 6;
+                }
+                cnt = sio_test_twh_cnt(len);
+                TEST_CHECK(sio_test_nibble(port) == 0x3, "poll %u port %u: Team Player idle", poll, port);
+                sio_test_twh_read(port, cnt, nibbles, 0xF);
+                TEST_CHECK(cnt < 2 || (nibbles[0] == 0x0 && nibbles[1] == 0x0), "poll %u port %u: Team Player header", poll, port);
+                for (uint32_t i = 0; i < GEN_MT_PORT_MAX; i++) {
+                    uint32_t id = first[port] + i;
+                    uint32_t type = (gen_modes[id] == DEV_PAD) ? TP_TYPE_3BTNS : (gen_modes[id] == DEV_PAD_ALT) ? TP_TYPE_6BTNS : TP_TYPE_MOUSE;
+                    uint16_t input = gen_snap_input[id];
+
+                    TEST_CHECK(2 + i >= cnt || nibbles[2 + i] == type, "poll %u port %u pad %u: type %X", poll, port, i, nibbles[2 + i]);
+                    if (type == TP_TYPE_MOUSE) {
+                        if (k + 6 <= cnt) {
+                            sio_test_mouse_check(id, &nibbles[k], k + 6 < cnt || cnt == len);
+                        }
+                        k += 6;
+                        continue;
+                    }
+                    TEST_CHECK(k + 2 > cnt || (nibbles[k] == ((input >> 4) & 0xF) && nibbles[k + 1] == (input & 0xF)),
+                        "poll %u port %u pad %u: buttons", poll, port, i);
+                    k += 2;
+                    if (type == TP_TYPE_6BTNS) {
+                        TEST_CHECK(k >= cnt || nibbles[k] == ((input >> 12) & 0xF), "poll %u port %u pad %u: 6 buttons", poll, port, i);
+                        k++;
+                    }
+                }
+            }
+            else if (gen_modes[first[port]] == DEV_MOUSE) {
+                uint32_t cnt = sio_test_twh_cnt(8);
+
+                TEST_CHECK(sio_test_nibble(port) == 0x0, "poll %u port %u: mouse idle", poll, port);
+                sio_test_twh_read(port, cnt, nibbles, 0xB);
+                TEST_CHECK(cnt < 2 || (nibbles[0] == 0xF && nibbles[1] == 0xF), "poll %u port %u: mouse header", poll, port);
+                if (cnt == 8) {
+                    sio_test_mouse_check(first[port], &nibbles[2], 1);
+                }
+            }
+            else {
+                uint16_t input = *(uint16_t *)wired_frame(&wired_adapter.data[first[port]]);
+
+                sio_test_isr(0, sio_test_th(port, 0));
+                TEST_CHECK(sio_test_pins6(port) == sio_test_pins6_expect(input, 0), "poll %u port %u: pad TH low", poll, port);
+                sio_test_isr(0, sio_test_th(port, 1));
+                TEST_CHECK(sio_test_pins6(port) == sio_test_pins6_expect(input, 1), "poll %u port %u: pad TH high", poll, port);
+            }
+            reads++;
+        }
+    }
+    printf("# %s: multitap %u, %u reads\n", __FUNCTION__, mt_cfg, reads);
+}
+
+/* One config per run, sega_io_init() is only done once on boot */
+int main(int argc, char **argv) {
+    uint32_t mt_cfg = (argc > 2) ? atoi(argv[2]) : MT_NONE;
+
+    if (argc > 1 && strcmp(argv[1], "saturn") == 0) {
+        sio_test_saturn(mt_cfg);
+    }
+    else if (argc > 1 && strcmp(argv[1], "genesis") == 0) {
+        sio_test_genesis(mt_cfg, argc > 3 && strcmp(argv[3], "mouse") == 0);
+    }
+    else {
+        printf("# usage: %s saturn|genesis [multitap_cfg] [mouse]\n", argv[0]);
+        return 1;
+    }
+
+    return TEST_RESULT();
+}
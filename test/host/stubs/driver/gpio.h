@@ -0,0 +1,89 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _DRIVER_GPIO_H_
+#define _DRIVER_GPIO_H_
+
+#include <stdint.h>
+#include <esp_attr.h>
+#include <esp_intr_alloc.h>
+
+#define GPIO_NUM_MAX 40
+
+#define GPIO_MODE_INPUT 1
+#define GPIO_MODE_OUTPUT 2
+#define GPIO_MODE_INPUT_OUTPUT_OD 3
+#define GPIO_MODE_OUTPUT_OD 4
+#define GPIO_MODE_INPUT_OUTPUT 5
+
+#define GPIO_PULLUP_ONLY 0
+#define GPIO_PULLUP_DISABLE 0
+#define GPIO_PULLUP_ENABLE 1
+#define GPIO_PULLDOWN_DISABLE 0
+
+#define GPIO_INTR_DISABLE 0
+#define GPIO_INTR_POSEDGE 1
+#define GPIO_INTR_NEGEDGE 2
+#define GPIO_INTR_ANYEDGE 3
+#define GPIO_PIN_INTR_DISABLE GPIO_INTR_DISABLE
+#define GPIO_PIN_INTR_POSEDGE GPIO_INTR_POSEDGE
+#define GPIO_PIN_INTR_NEGEDGE GPIO_INTR_NEGEDGE
+#define GPIO_PIN_INTR_ANYEDGE GPIO_INTR_ANYEDGE
+
+#define PIN_FUNC_GPIO 2
+#define PIN_FUNC_SELECT(reg, func) ((void)(reg), (void)(func))
+#define PIN_INPUT_ENABLE(reg) ((void)(reg))
+
+#define ETS_GPIO_INTR_SOURCE 22
+
+typedef int gpio_num_t;
+
+typedef struct {
+    uint64_t pin_bit_mask;
+    int mode;
+    int pull_up_en;
+    int pull_down_en;
+    int intr_type;
+} gpio_config_t;
+
+/* Registers used by the wired drivers, plain memory on host */
+typedef struct {
+    uint32_t out;
+    uint32_t out_w1ts;
+    uint32_t out_w1tc;
+    struct { uint32_t data; uint32_t val; } out1, out1_w1ts, out1_w1tc;
+    uint32_t enable;
+    uint32_t enable_w1ts;
+    uint32_t enable_w1tc;
+    struct { uint32_t data; uint32_t val; } enable1, enable1_w1ts, enable1_w1tc;
+    uint32_t in;
+    struct { uint32_t data; uint32_t val; } in1;
+    uint32_t status;
+    uint32_t status_w1tc;
+    struct { uint32_t intr_st; uint32_t val; } status1, status1_w1tc;
+    uint32_t acpu_int;
+    uint32_t pcpu_int;
+    struct { uint32_t intr; uint32_t val; } acpu_int1, pcpu_int1;
+    struct { uint32_t int_type:3; uint32_t int_ena:5; uint32_t val; } pin[GPIO_NUM_MAX];
+    struct { uint32_t func_sel; uint32_t sig_in_sel; uint32_t val; } func_in_sel_cfg[256];
+    struct { uint32_t func_sel; uint32_t val; } func_out_sel_cfg[GPIO_NUM_MAX];
+} gpio_dev_t;
+
+extern volatile gpio_dev_t GPIO;
+extern uint32_t GPIO_PIN_MUX_REG[GPIO_NUM_MAX];
+
+int gpio_config(const gpio_config_t *cfg);
+int gpio_set_direction(gpio_num_t gpio_num, int mode);
+int gpio_set_pull_mode(gpio_num_t gpio_num, int pull);
+int gpio_set_level(gpio_num_t gpio_num, uint32_t level);
+int gpio_get_level(gpio_num_t gpio_num);
+int gpio_set_intr_type(gpio_num_t gpio_num, int intr_type);
+int gpio_intr_enable(gpio_num_t gpio_num);
+int gpio_intr_disable(gpio_num_t gpio_num);
+int gpio_isr_register(void (*fn)(void *), void *arg, int intr_alloc_flags, intr_handle_t *handle);
+void gpio_matrix_out(uint32_t gpio, uint32_t signal_idx, int out_inv, int oen_inv);
+void gpio_matrix_in(uint32_t gpio, uint32_t signal_idx, int inv);
+
+#endif /* _DRIVER_GPIO_H_ */
@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _DRIVER_PERIPH_CTRL_H_
+#define _DRIVER_PERIPH_CTRL_H_
+
+typedef enum {
+    PERIPH_RMT_MODULE,
+    PERIPH_UART1_MODULE,
+    PERIPH_I2S0_MODULE,
+    PERIPH_I2S1_MODULE,
+} periph_module_t;
+
+void periph_module_enable(periph_module_t periph);
+void periph_module_reset(periph_module_t periph);
+
+#endif /* _DRIVER_PERIPH_CTRL_H_ */
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _DRIVER_RMT_H_
+#define _DRIVER_RMT_H_
+
+#include <stdint.h>
+#include <driver/gpio.h>
+
+#define RMT_MEM_ITEM_NUM 64
+#define RMT_CHANNEL_MAX 8
+
+#define RMT_MEM_OWNER_TX 0
+#define RMT_MEM_OWNER_RX 1
+#define RMT_DATA_MODE_MEM 1
+#define RMT_BASECLK_APB 1
+#define RMT_IDLE_LEVEL_HIGH 1
+#define RMT_CARRIER_LEVEL_LOW 0
+
+#define RMT_SIG_IN0_IDX 83
+#define RMT_SIG_OUT0_IDX 87
+
+typedef union {
+    struct {
+        uint32_t duration0:15;
+        uint32_t level0:1;
+        uint32_t duration1:15;
+        uint32_t level1:1;
+    };
+    uint32_t val;
+} rmt_item32_t;
+
+typedef struct {
+    struct {
+        struct {
+            uint32_t div_cnt:8;
+            uint32_t idle_thres:16;
+            uint32_t mem_size:4;
+            uint32_t carrier_en:1;
+            uint32_t carrier_out_lv:1;
+            uint32_t mem_pd:1;
+            uint32_t clk_en:1;
+        } conf0;
+        struct {
+            uint32_t tx_start:1;
+            uint32_t rx_en:1;
+            uint32_t mem_wr_rst:1;
+            uint32_t mem_rd_rst:1;
+            uint32_t apb_mem_rst:1;
+            uint32_t mem_owner:1;
+            uint32_t tx_conti_mode:1;
+            uint32_t rx_filter_en:1;
+            uint32_t rx_filter_thres:8;
+            uint32_t ref_cnt_rst:1;
+            uint32_t ref_always_on:1;
+            uint32_t idle_out_lv:1;
+            uint32_t idle_out_en:1;
+        } conf1;
+    } conf_ch[RMT_CHANNEL_MAX];
+    struct { uint32_t val; } int_raw, int_st, int_ena, int_clr;
+    struct { uint32_t high:16; uint32_t low:16; } carrier_duty_ch[RMT_CHANNEL_MAX];
+    struct { uint32_t fifo_mask:1; uint32_t mem_tx_wrap_en:1; } apb_conf;
+} rmt_dev_t;
+
+/* Channels memory blocks are contiguous, like on ESP32 */
+typedef struct {
+    struct {
+        rmt_item32_t data32[RMT_MEM_ITEM_NUM];
+    } chan[RMT_CHANNEL_MAX];
+} rmt_mem_t;
+
+extern volatile rmt_dev_t RMT;
+extern volatile rmt_mem_t RMTMEM;
+
+int rmt_isr_register(void (*fn)(void *), void *arg, int intr_alloc_flags, intr_handle_t *handle);
+int rmt_set_tx_intr_en(int channel, int en);
+int rmt_set_rx_intr_en(int channel, int en);
+int rmt_set_err_intr_en(int channel, int en);
+int rmt_rx_start(int channel, int rx_idx_rst);
+
+#endif /* _DRIVER_RMT_H_ */
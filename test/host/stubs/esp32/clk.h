@@ -0,0 +1,11 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _ESP32_CLK_H_
+#define _ESP32_CLK_H_
+
+#include <soc/soc.h>
+
+#endif /* _ESP32_CLK_H_ */
@@ -0,0 +1,15 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _ESP32_DPORT_ACCESS_H_
+#define _ESP32_DPORT_ACCESS_H_
+
+#include <esp32/rom/ets_sys.h>
+
+/* Single core host, nothing to stall */
+#define DPORT_STALL_OTHER_CPU_START()
+#define DPORT_STALL_OTHER_CPU_END()
+
+#endif /* _ESP32_DPORT_ACCESS_H_ */
@@ -0,0 +1,13 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _ESP32_ROM_CRC_H_
+#define _ESP32_ROM_CRC_H_
+
+#include <stdint.h>
+
+uint32_t crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif /* _ESP32_ROM_CRC_H_ */
@@ -0,0 +1,18 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _ESP32_ROM_ETS_SYS_H_
+#define _ESP32_ROM_ETS_SYS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef ets_printf
+#define ets_printf printf
+#endif
+
+void ets_delay_us(uint32_t us);
+
+#endif /* _ESP32_ROM_ETS_SYS_H_ */
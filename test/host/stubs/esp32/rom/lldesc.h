@@ -0,0 +1,27 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _ESP32_ROM_LLDESC_H_
+#define _ESP32_ROM_LLDESC_H_
+
+#include <stdint.h>
+
+typedef struct lldesc_s {
+    volatile uint32_t size :12,
+                      length:12,
+                      offset: 5,
+                      sosf  : 1,
+                      eof   : 1,
+                      owner : 1;
+    volatile uint8_t *buf;
+    union {
+        volatile uint32_t empty;
+        struct {
+            struct lldesc_s *stqe_next;
+        } qe;
+    };
+} lldesc_t;
+
+#endif /* _ESP32_ROM_LLDESC_H_ */
@@ -0,0 +1,12 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _ESP_ATTR_H_
+#define _ESP_ATTR_H_
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+#endif /* _ESP_ATTR_H_ */
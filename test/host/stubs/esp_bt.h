@@ -0,0 +1,32 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _ESP_BT_H_
+#define _ESP_BT_H_
+
+#include <stdint.h>
+#include <esp_system.h>
+
+typedef struct {
+    void (*notify_host_send_available)(void);
+    int (*notify_host_recv)(uint8_t *data, uint16_t len);
+} esp_vhci_host_callback_t;
+
+typedef struct {
+    uint32_t unused;
+} esp_bt_controller_config_t;
+
+#define BT_CONTROLLER_INIT_CONFIG_DEFAULT() {0}
+
+#define ESP_BT_MODE_BTDM 3
+
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t *cfg);
+esp_err_t esp_bt_controller_enable(int mode);
+
+/* No controller on host, tests provide these as a fake VHCI */
+esp_err_t esp_vhci_host_register_callback(const esp_vhci_host_callback_t *callback);
+void esp_vhci_host_send_packet(uint8_t *data, uint16_t len);
+
+#endif /* _ESP_BT_H_ */
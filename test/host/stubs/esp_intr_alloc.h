@@ -0,0 +1,19 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _ESP_INTR_ALLOC_H_
+#define _ESP_INTR_ALLOC_H_
+
+#define ESP_INTR_FLAG_LEVEL1 (1 << 1)
+#define ESP_INTR_FLAG_LEVEL2 (1 << 2)
+#define ESP_INTR_FLAG_LEVEL3 (1 << 3)
+#define ESP_INTR_FLAG_IRAM (1 << 10)
+
+typedef void *intr_handle_t;
+
+/* Interrupts never fire on host, tests call the ISR themselves */
+int esp_intr_alloc(int source, int flags, void (*handler)(void *), void *arg, intr_handle_t *ret_handle);
+
+#endif /* _ESP_INTR_ALLOC_H_ */
@@ -0,0 +1,21 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _ESP_SYSTEM_H_
+#define _ESP_SYSTEM_H_
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_ERR_NVS_NO_FREE_PAGES 0x1100
+
+#define ESP_ERROR_CHECK(x) (void)(x)
+
+const char *esp_err_to_name(esp_err_t code);
+esp_err_t esp_base_mac_addr_set(uint8_t *mac);
+
+#endif /* _ESP_SYSTEM_H_ */
@@ -0,0 +1,14 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _ESP_TASK_WDT_H_
+#define _ESP_TASK_WDT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+int esp_task_wdt_init(uint32_t timeout, bool panic);
+
+#endif /* _ESP_TASK_WDT_H_ */
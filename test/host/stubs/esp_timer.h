@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _ESP_TIMER_H_
+#define _ESP_TIMER_H_
+
+#include <stdint.h>
+
+typedef void *esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+} esp_timer_create_args_t;
+
+/* Timers never fire on their own, host_timer_fire() run pending ones */
+int esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle);
+int esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+int esp_timer_delete(esp_timer_handle_t timer);
+int64_t esp_timer_get_time(void);
+
+#endif /* _ESP_TIMER_H_ */
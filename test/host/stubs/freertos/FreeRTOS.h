@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _FREERTOS_H_
+#define _FREERTOS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <sdkconfig.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS pdTRUE
+#define portMAX_DELAY 0xFFFFFFFF
+#define portTICK_PERIOD_MS 1
+
+#define ets_printf printf
+
+#endif /* _FREERTOS_H_ */
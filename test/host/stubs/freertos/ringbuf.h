@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _RINGBUF_H_
+#define _RINGBUF_H_
+
+#include "FreeRTOS.h"
+
+/* Only NOSPLIT is used, host version is a plain FIFO of items */
+typedef void *RingbufHandle_t;
+
+typedef enum {
+    RINGBUF_TYPE_NOSPLIT = 0,
+} RingbufferType_t;
+
+RingbufHandle_t xRingbufferCreate(size_t xBufferSize, RingbufferType_t xBufferType);
+void vRingbufferDelete(RingbufHandle_t xRingbuffer);
+UBaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xItemSize, TickType_t xTicksToWait);
+UBaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xItemSize, BaseType_t *pxHigherPriorityTaskWoken);
+void *xRingbufferReceive(RingbufHandle_t xRingbuffer, size_t *pxItemSize, TickType_t xTicksToWait);
+void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem);
+
+#endif /* _RINGBUF_H_ */
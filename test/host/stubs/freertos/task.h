@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _TASK_H_
+#define _TASK_H_
+
+#include "FreeRTOS.h"
+
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *arg);
+
+/* Tasks are never run, tests call task bodies themselves */
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth,
+    void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pvCreatedTask, BaseType_t xCoreID);
+void vTaskDelete(TaskHandle_t xTaskToDelete);
+void vTaskDelay(TickType_t xTicksToDelay);
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify);
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken);
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait);
+TickType_t xTaskGetTickCount(void);
+BaseType_t xPortGetCoreID(void);
+
+#endif /* _TASK_H_ */
@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _HAL_UART_LL_H_
+#define _HAL_UART_LL_H_
+
+#include <stdint.h>
+#include <soc/uart_periph.h>
+
+#define UART_INTR_RXFIFO_FULL (1 << 0)
+#define UART_INTR_TXFIFO_EMPTY (1 << 1)
+#define UART_INTR_RXFIFO_OVF (1 << 4)
+#define UART_INTR_RXFIFO_TOUT (1 << 8)
+#define UART_INTR_TX_DONE (1 << 14)
+
+uint32_t uart_ll_get_rxfifo_len(volatile uart_dev_t *hw);
+void uart_ll_rxfifo_rst(volatile uart_dev_t *hw);
+void uart_ll_txfifo_rst(volatile uart_dev_t *hw);
+
+#endif /* _HAL_UART_LL_H_ */
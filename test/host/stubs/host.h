@@ -0,0 +1,33 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _HOST_H_
+#define _HOST_H_
+
+#include <stdint.h>
+
+/* Simulated time returned by esp_timer_get_time() */
+extern int64_t host_time_us;
+
+/* Core returned by xPortGetCoreID() */
+extern int32_t host_core_id;
+/* Pending vTaskNotifyGiveFromISR() count */
+extern uint32_t host_task_notify;
+
+/* Called by gpio_matrix_out(), lets tests run peripheral DMA */
+extern void (*host_gpio_matrix_out_hook)(uint32_t gpio, uint32_t signal_idx);
+
+/* UART1 FIFO, tests fill RX and read back TX */
+#define HOST_UART_FIFO_SIZE 512
+extern uint8_t host_uart_rx[HOST_UART_FIFO_SIZE];
+extern uint32_t host_uart_rx_len;
+extern uint32_t host_uart_rx_pos;
+extern uint8_t host_uart_tx[HOST_UART_FIFO_SIZE];
+extern uint32_t host_uart_tx_len;
+
+/* Run callback of every started esp_timer */
+void host_timer_fire(void);
+
+#endif /* _HOST_H_ */
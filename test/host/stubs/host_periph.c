@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <driver/gpio.h>
+#include <driver/rmt.h>
+#include <driver/periph_ctrl.h>
+#include <esp_intr_alloc.h>
+#include <esp_task_wdt.h>
+#include <esp32/rom/ets_sys.h>
+#include <soc/i2s_struct.h>
+#include <soc/uart_periph.h>
+#include <hal/uart_ll.h>
+#include "host.h"
+
+/* Peripherals registers are plain memory, tests set inputs and read
+ * outputs directly and call driver ISR themselves.
+ */
+volatile gpio_dev_t GPIO;
+uint32_t GPIO_PIN_MUX_REG[GPIO_NUM_MAX];
+volatile rmt_dev_t RMT;
+volatile rmt_mem_t RMTMEM;
+volatile i2s_dev_t I2S0;
+volatile i2s_dev_t I2S1;
+void (*host_gpio_matrix_out_hook)(uint32_t gpio, uint32_t signal_idx);
+volatile uart_dev_t UART1;
+const uart_signal_conn_t uart_periph_signal[3];
+uint8_t host_uart_rx[HOST_UART_FIFO_SIZE];
+uint32_t host_uart_rx_len;
+uint32_t host_uart_rx_pos;
+uint8_t host_uart_tx[HOST_UART_FIFO_SIZE];
+uint32_t host_uart_tx_len;
+
+int gpio_config(const gpio_config_t *cfg) {
+    return 0;
+}
+
+int gpio_set_direction(gpio_num_t gpio_num, int mode) {
+    return 0;
+}
+
+int gpio_set_pull_mode(gpio_num_t gpio_num, int pull) {
+    return 0;
+}
+
+int gpio_set_level(gpio_num_t gpio_num, uint32_t level) {
+    if (gpio_num < 32) {
+        if (level) {
+            GPIO.out |= 1U << gpio_num;
+        }
+        else {
+            GPIO.out &= ~(1U << gpio_num);
+        }
+    }
+    return 0;
+}
+
+int gpio_get_level(gpio_num_t gpio_num) {
+    if (gpio_num < 32) {
+        return (GPIO.in >> gpio_num) & 0x1;
+    }
+    return (GPIO.in1.val >> (gpio_num - 32)) & 0x1;
+}
+
+int gpio_set_intr_type(gpio_num_t gpio_num, int intr_type) {
+    GPIO.pin[gpio_num].int_type = intr_type;
+    return 0;
+}
+
+int gpio_intr_enable(gpio_num_t gpio_num) {
+    return 0;
+}
+
+int gpio_intr_disable(gpio_num_t gpio_num) {
+    return 0;
+}
+
+int gpio_isr_register(void (*fn)(void *), void *arg, int intr_alloc_flags, intr_handle_t *handle) {
+    return 0;
+}
+
+void gpio_matrix_out(uint32_t gpio, uint32_t signal_idx, int out_inv, int oen_inv) {
+    if (host_gpio_matrix_out_hook) {
+        host_gpio_matrix_out_hook(gpio, signal_idx);
+    }
+}
+
+void gpio_matrix_in(uint32_t gpio, uint32_t signal_idx, int inv) {
+}
+
+int rmt_isr_register(void (*fn)(void *), void *arg, int intr_alloc_flags, intr_handle_t *handle) {
+    return 0;
+}
+
+int rmt_set_tx_intr_en(int channel, int en) {
+    return 0;
+}
+
+int rmt_set_rx_intr_en(int channel, int en) {
+    return 0;
+}
+
+int rmt_set_err_intr_en(int channel, int en) {
+    return 0;
+}
+
+int rmt_rx_start(int channel, int rx_idx_rst) {
+    RMT.conf_ch[channel].conf1.rx_en = 1;
+    return 0;
+}
+
+void periph_module_enable(periph_module_t periph) {
+}
+
+void periph_module_reset(periph_module_t periph) {
+}
+
+int esp_intr_alloc(int source, int flags, void (*handler)(void *), void *arg, intr_handle_t *ret_handle) {
+    return 0;
+}
+
+int esp_task_wdt_init(uint32_t timeout, bool panic) {
+    return 0;
+}
+
+void ets_delay_us(uint32_t us) {
+}
+
+/* UART1 FIFO only, RX bytes are set by tests and TX bytes kept */
+uint32_t host_peri_reg_read(uint32_t addr) {
+    if (addr == UART_FIFO_REG(1) && host_uart_rx_pos < host_uart_rx_len) {
+        return host_uart_rx[host_uart_rx_pos++];
+    }
+    return 0;
+}
+
+void host_peri_reg_write(uint32_t addr, uint32_t val) {
+    if (addr == UART_FIFO_AHB_REG(1) && host_uart_tx_len < HOST_UART_FIFO_SIZE) {
+        host_uart_tx[host_uart_tx_len++] = val;
+    }
+}
+
+uint32_t uart_ll_get_rxfifo_len(volatile uart_dev_t *hw) {
+    return host_uart_rx_len - host_uart_rx_pos;
+}
+
+void uart_ll_rxfifo_rst(volatile uart_dev_t *hw) {
+    host_uart_rx_len = 0;
+    host_uart_rx_pos = 0;
+}
+
+void uart_ll_txfifo_rst(volatile uart_dev_t *hw) {
+    host_uart_tx_len = 0;
+}
@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/ringbuf.h>
+#include <freertos/task.h>
+#include <xtensa/hal.h>
+#include <esp_timer.h>
+#include <esp_bt.h>
+#include <nvs_flash.h>
+#include <esp32/rom/crc.h>
+#include "host.h"
+
+#define HOST_TIMER_MAX 32
+
+struct host_rb_item {
+    struct host_rb_item *next;
+    size_t len;
+    uint8_t data[0];
+};
+
+struct host_rb {
+    size_t size;
+    size_t used;
+    struct host_rb_item *head;
+    struct host_rb_item *tail;
+    struct host_rb_item *recv;
+};
+
+struct host_timer {
+    esp_timer_create_args_t args;
+    uint32_t started;
+};
+
+int64_t host_time_us = 0;
+int32_t host_core_id = 0;
+uint32_t host_task_notify = 0;
+uint32_t host_ccount = 0;
+uint32_t host_ccount_step = 1;
+static struct host_timer *host_timers[HOST_TIMER_MAX];
+
+RingbufHandle_t xRingbufferCreate(size_t xBufferSize, RingbufferType_t xBufferType) {
+    struct host_rb *rb = calloc(1, sizeof(*rb));
+
+    if (rb) {
+        rb->size = xBufferSize;
+    }
+    return rb;
+}
+
+void vRingbufferDelete(RingbufHandle_t xRingbuffer) {
+    struct host_rb *rb = xRingbuffer;
+
+    while (rb->head) {
+        struct host_rb_item *item = rb->head;
+        rb->head = item->next;
+        free(item);
+    }
+    free(rb);
+}
+
+UBaseType_t xRingbufferSend(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xItemSize, TickType_t xTicksToWait) {
+    struct host_rb *rb = xRingbuffer;
+    /* NOSPLIT items use an 8 bytes header and are 32 bits aligned */
+    size_t len = ((xItemSize + 3) & ~3) + 8;
+    struct host_rb_item *item;
+
+    if (rb->used + len > rb->size) {
+        return pdFALSE;
+    }
+    item = malloc(sizeof(*item) + xItemSize);
+    if (item == NULL) {
+        return pdFALSE;
+    }
+    item->next = NULL;
+    item->len = xItemSize;
+    memcpy(item->data, pvItem, xItemSize);
+    if (rb->tail) {
+        rb->tail->next = item;
+    }
+    else {
+        rb->head = item;
+    }
+    rb->tail = item;
+    if (rb->recv == NULL) {
+        rb->recv = item;
+    }
+    rb->used += len;
+    return pdTRUE;
+}
+
+UBaseType_t xRingbufferSendFromISR(RingbufHandle_t xRingbuffer, const void *pvItem, size_t xItemSize, BaseType_t *pxHigherPriorityTaskWoken) {
+    return xRingbufferSend(xRingbuffer, pvItem, xItemSize, 0);
+}
+
+void *xRingbufferReceive(RingbufHandle_t xRingbuffer, size_t *pxItemSize, TickType_t xTicksToWait) {
+    struct host_rb *rb = xRingbuffer;
+    struct host_rb_item *item = rb->recv;
+
+    if (item == NULL) {
+        return NULL;
+    }
+    rb->recv = item->next;
+    *pxItemSize = item->len;
+    return item->data;
+}
+
+void vRingbufferReturnItem(RingbufHandle_t xRingbuffer, void *pvItem) {
+    struct host_rb *rb = xRingbuffer;
+    struct host_rb_item *item = rb->head;
+
+    /* Items are returned in order they were received */
+    if (item == NULL || item->data != pvItem) {
+        abort();
+    }
+    rb->head = item->next;
+    if (rb->head == NULL) {
+        rb->tail = NULL;
+    }
+    rb->used -= ((item->len + 3) & ~3) + 8;
+    free(item);
+}
+
+int esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle) {
+    for (uint32_t i = 0; i < HOST_TIMER_MAX; i++) {
+        if (host_timers[i] == NULL) {
+            host_timers[i] = calloc(1, sizeof(*host_timers[i]));
+            host_timers[i]->args = *create_args;
+            *out_handle = host_timers[i];
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+    ((struct host_timer *)timer)->started = 1;
+    return 0;
+}
+
+int esp_timer_delete(esp_timer_handle_t timer) {
+    for (uint32_t i = 0; i < HOST_TIMER_MAX; i++) {
+        if (host_timers[i] && host_timers[i] == timer) {
+            free(host_timers[i]);
+            host_timers[i] = NULL;
+        }
+    }
+    return 0;
+}
+
+int64_t esp_timer_get_time(void) {
+    return host_time_us;
+}
+
+void host_timer_fire(void) {
+    for (uint32_t i = 0; i < HOST_TIMER_MAX; i++) {
+        if (host_timers[i] && host_timers[i]->started) {
+            host_timers[i]->started = 0;
+            host_timers[i]->args.callback(host_timers[i]->args.arg);
+        }
+    }
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t pvTaskCode, const char *pcName, uint32_t usStackDepth,
+        void *pvParameters, UBaseType_t uxPriority, TaskHandle_t *pvCreatedTask, BaseType_t xCoreID) {
+    if (pvCreatedTask) {
+        *pvCreatedTask = NULL;
+    }
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t xTaskToDelete) {
+}
+
+void vTaskDelay(TickType_t xTicksToDelay) {
+    host_time_us += xTicksToDelay * portTICK_PERIOD_MS * 1000;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t xTaskToNotify) {
+    host_task_notify++;
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t xTaskToNotify, BaseType_t *pxHigherPriorityTaskWoken) {
+    host_task_notify++;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t xClearCountOnExit, TickType_t xTicksToWait) {
+    uint32_t cnt = host_task_notify;
+
+    host_task_notify = xClearCountOnExit ? 0 : (cnt ? cnt - 1 : 0);
+    return cnt;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(host_time_us / 1000 / portTICK_PERIOD_MS);
+}
+
+BaseType_t xPortGetCoreID(void) {
+    return host_core_id;
+}
+
+esp_err_t nvs_flash_init(void) {
+    return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void) {
+    return ESP_OK;
+}
+
+esp_err_t esp_bt_controller_init(esp_bt_controller_config_t *cfg) {
+    return ESP_OK;
+}
+
+esp_err_t esp_bt_controller_enable(int mode) {
+    return ESP_OK;
+}
+
+const char *esp_err_to_name(esp_err_t code) {
+    return (code == ESP_OK) ? "ESP_OK" : "ESP_FAIL";
+}
+
+esp_err_t esp_base_mac_addr_set(uint8_t *mac) {
+    return ESP_OK;
+}
+
+/* Same as ROM one, crc is inverted on entry and exit */
+uint32_t crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len) {
+    crc = ~crc;
+    while (len--) {
+        crc ^= *buf++;
+        for (uint32_t i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
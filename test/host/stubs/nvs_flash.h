@@ -0,0 +1,14 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _NVS_FLASH_H_
+#define _NVS_FLASH_H_
+
+#include <esp_system.h>
+
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+
+#endif /* _NVS_FLASH_H_ */
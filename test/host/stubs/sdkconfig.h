@@ -0,0 +1,11 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _SDKCONFIG_H_
+#define _SDKCONFIG_H_
+
+#define CONFIG_ESP32_DEFAULT_CPU_FREQ_MHZ 240
+
+#endif /* _SDKCONFIG_H_ */
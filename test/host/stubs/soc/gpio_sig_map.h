@@ -0,0 +1,15 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _SOC_GPIO_SIG_MAP_H_
+#define _SOC_GPIO_SIG_MAP_H_
+
+#define U1RXD_IN_IDX 17
+#define U1TXD_OUT_IDX 17
+#define I2S1O_DATA_OUT0_IDX 166
+#define I2S1O_DATA_OUT1_IDX 167
+#define SIG_GPIO_OUT_IDX 256
+
+#endif /* _SOC_GPIO_SIG_MAP_H_ */
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _SOC_I2S_STRUCT_H_
+#define _SOC_I2S_STRUCT_H_
+
+#include <stdint.h>
+
+/* Registers used by the wired drivers, host DMA is run by the tests */
+typedef struct {
+    union {
+        struct {
+            uint32_t tx_reset:1;
+            uint32_t rx_reset:1;
+            uint32_t tx_fifo_reset:1;
+            uint32_t rx_fifo_reset:1;
+            uint32_t tx_start:1;
+            uint32_t rx_start:1;
+        };
+        uint32_t val;
+    } conf;
+    union {
+        struct {
+            uint32_t out_total_eof:1;
+            uint32_t out_eof:1;
+        };
+        uint32_t val;
+    } int_raw, int_st, int_ena, int_clr;
+    union {
+        struct {
+            uint32_t tx_stop_en:1;
+            uint32_t tx_pcm_bypass:1;
+        };
+        uint32_t val;
+    } conf1;
+    union {
+        struct {
+            uint32_t lcd_en:1;
+            uint32_t lcd_tx_wrx2_en:1;
+            uint32_t lcd_tx_sdx2_en:1;
+        };
+        uint32_t val;
+    } conf2;
+    union {
+        struct {
+            uint32_t clkm_div_num:8;
+            uint32_t clkm_div_b:6;
+            uint32_t clkm_div_a:6;
+            uint32_t clk_en:1;
+            uint32_t clka_en:1;
+        };
+        uint32_t val;
+    } clkm_conf;
+    union {
+        struct {
+            uint32_t tx_bck_div_num:6;
+            uint32_t rx_bck_div_num:6;
+            uint32_t tx_bits_mod:6;
+            uint32_t rx_bits_mod:6;
+        };
+        uint32_t val;
+    } sample_rate_conf;
+    union {
+        struct {
+            uint32_t rx_data_num:6;
+            uint32_t tx_data_num:6;
+            uint32_t dscr_en:1;
+            uint32_t tx_fifo_mod:3;
+            uint32_t rx_fifo_mod:3;
+            uint32_t tx_fifo_mod_force_en:1;
+            uint32_t rx_fifo_mod_force_en:1;
+        };
+        uint32_t val;
+    } fifo_conf;
+    union {
+        struct {
+            uint32_t tx_chan_mod:3;
+            uint32_t rx_chan_mod:2;
+        };
+        uint32_t val;
+    } conf_chan;
+    union {
+        uint32_t val;
+    } timing;
+    union {
+        struct {
+            uint32_t in_rst:1;
+            uint32_t out_rst:1;
+            uint32_t ahbm_fifo_rst:1;
+            uint32_t ahbm_rst:1;
+            uint32_t out_loop_test:1;
+            uint32_t in_loop_test:1;
+            uint32_t out_auto_wrback:1;
+            uint32_t out_no_restart_clr:1;
+            uint32_t out_eof_mode:1;
+            uint32_t outdscr_burst_en:1;
+            uint32_t indscr_burst_en:1;
+            uint32_t out_data_burst_en:1;
+        };
+        uint32_t val;
+    } lc_conf;
+    /* Descriptor address is 20 bits on target, full pointer on host */
+    struct {
+        uintptr_t addr;
+        uint32_t stop:1;
+        uint32_t start:1;
+        uint32_t restart:1;
+        uint32_t park:1;
+    } out_link;
+} i2s_dev_t;
+
+extern volatile i2s_dev_t I2S0;
+extern volatile i2s_dev_t I2S1;
+
+#endif /* _SOC_I2S_STRUCT_H_ */
@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _SOC_SOC_H_
+#define _SOC_SOC_H_
+
+#include <stdint.h>
+
+#define APB_CLK_FREQ 80000000
+
+#define ETS_UART1_INTR_SOURCE 35
+
+/* Register access go through host_periph.c FIFO model */
+uint32_t host_peri_reg_read(uint32_t addr);
+void host_peri_reg_write(uint32_t addr, uint32_t val);
+
+#define READ_PERI_REG(addr) host_peri_reg_read(addr)
+#define WRITE_PERI_REG(addr, val) host_peri_reg_write(addr, val)
+
+#endif /* _SOC_SOC_H_ */
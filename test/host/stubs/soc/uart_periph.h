@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _SOC_UART_PERIPH_H_
+#define _SOC_UART_PERIPH_H_
+
+#include <stdint.h>
+#include <soc/soc.h>
+
+#define UART_CLKDIV_S 0
+#define UART_CLKDIV_FRAG_S 20
+
+#define UART_FIFO_REG(i) (0x3FF40000 + (i) * 0x10000)
+#define UART_FIFO_AHB_REG(i) (0x60000000 + (i) * 0x10000)
+
+#define UART_DATA_8_BITS 3
+#define UART_STOP_BITS_1 1
+
+/* Registers used by the wired drivers, FIFO is modeled in host_periph.c */
+typedef struct {
+    union {
+        struct {
+            uint32_t div_int:20;
+            uint32_t div_frag:4;
+        };
+        uint32_t val;
+    } clk_div;
+    union {
+        uint32_t val;
+    } int_raw, int_st, int_ena, int_clr;
+    struct {
+        uint32_t parity_en;
+        uint32_t bit_num;
+        uint32_t stop_bit_num;
+        uint32_t tx_flow_en;
+        uint32_t irda_en;
+        uint32_t tick_ref_always_on;
+    } conf0;
+    struct {
+        uint32_t rxfifo_full_thrhd;
+        uint32_t txfifo_empty_thrhd;
+        uint32_t rx_flow_en;
+        uint32_t rx_tout_thrhd;
+        uint32_t rx_tout_en;
+    } conf1;
+    struct {
+        uint32_t en;
+        uint32_t dl1_en;
+        uint32_t tx_rx_en;
+        uint32_t rx_busy_tx_en;
+    } rs485_conf;
+    struct {
+        uint32_t tx_idle_num;
+    } idle_conf;
+} uart_dev_t;
+
+typedef struct {
+    uint32_t tx_sig;
+    uint32_t rx_sig;
+} uart_signal_conn_t;
+
+extern volatile uart_dev_t UART1;
+extern const uart_signal_conn_t uart_periph_signal[3];
+
+#endif /* _SOC_UART_PERIPH_H_ */
@@ -0,0 +1,23 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _XTENSA_HAL_H_
+#define _XTENSA_HAL_H_
+
+#include <stdint.h>
+
+/* Simulated CPU cycle counter, advance by host_ccount_step on each read
+ * so driver timeout loops always end. Tests move it forward to
+ * simulate time between events.
+ */
+extern uint32_t host_ccount;
+extern uint32_t host_ccount_step;
+
+static inline uint32_t xthal_get_ccount(void) {
+    host_ccount += host_ccount_step;
+    return host_ccount;
+}
+
+#endif /* _XTENSA_HAL_H_ */
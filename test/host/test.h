@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef _TEST_H_
+#define _TEST_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+static uint32_t test_fail_cnt __attribute__((unused));
+
+#define TEST_CHECK(cond, fmt, ...) do { \
+    if (!(cond)) { \
+        printf("# %s:%d: " fmt "\n", __FILE__, __LINE__, ##__VA_ARGS__); \
+        test_fail_cnt++; \
+    } \
+} while (0)
+
+#define TEST_RESULT() (test_fail_cnt ? 1 : 0)
+
+static inline uint64_t test_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/* Host CPU cycles, ns where no cycle counter is available */
+static inline uint64_t test_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __builtin_ia32_rdtsc();
+#else
+    return test_ns();
+#endif
+}
+
+#endif /* _TEST_H_ */
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "trace.h"
+
+/* Turn a trace.bin pulled from the SD card into a timeline.
+ *   trace_dump [-f cpu_mhz] trace.bin
+ * Each core ccount is unwrapped on its own, both cores are merged in time
+ * order assuming their ccount started together, which is close enough
+ * on ESP32 to line up BT RX on core 0 with wired ISR on core 1.
+ */
+
+#define TRACE_DUMP_CORE_MAX 2
+
+struct dump_rec {
+    uint64_t cycles;
+    uint32_t seq;
+    uint16_t core;
+    uint16_t evt;
+    uint16_t arg;
+};
+
+struct dump_core {
+    uint32_t valid;
+    uint32_t last_ccount;
+    uint32_t last_seq;
+    uint64_t cycles;
+    uint64_t prev_cycles;
+    uint32_t prev_valid;
+    uint32_t gaps;
+    uint32_t lost;
+};
+
+static const char *evt_names[TRACE_EVT_MAX] = {
+    "ACL_RX", "HIDP", "TO_GENERIC", "MAPPING", "FROM_GENERIC", "FB_TX", "ISR_ENTRY", "ISR_EXIT",
+};
+
+static struct dump_core cores[TRACE_DUMP_CORE_MAX];
+
+static int dump_cmp(const void *a, const void *b) {
+    const struct dump_rec *rec_a = a, *rec_b = b;
+
+    if (rec_a->cycles != rec_b->cycles) {
+        return (rec_a->cycles < rec_b->cycles) ? -1 : 1;
+    }
+    return (int)rec_a->core - (int)rec_b->core;
+}
+
+int main(int argc, char **argv) {
+    struct trace_blk_hdr hdr;
+    struct trace_rec rec;
+    struct dump_rec *recs = NULL;
+    uint32_t cnt = 0, size = 0, cpu_mhz = 240;
+    uint64_t start = UINT64_MAX;
+    FILE *file;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:")) != -1) {
+        switch (opt) {
+            case 'f':
+                cpu_mhz = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-f cpu_mhz] trace.bin\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc || cpu_mhz == 0) {
+        fprintf(stderr, "usage: %s [-f cpu_mhz] trace.bin\n", argv[0]);
+        return 1;
+    }
+
+    file = fopen(argv[optind], "rb");
+    if (file == NULL) {
+        fprintf(stderr, "# %s: failed to open %s\n", __FUNCTION__, argv[optind]);
+        return 1;
+    }
+
+    while (fread((void *)&hdr, sizeof(hdr), 1, file) == 1) {
+        struct dump_core *core;
+
+        if (hdr.magic != TRACE_MAGIC || hdr.core >= TRACE_DUMP_CORE_MAX) {
+            fprintf(stderr, "# %s: bad block header at 0x%lX\n", __FUNCTION__, ftell(file) - (long)sizeof(hdr));
+            fclose(file);
+            return 1;
+        }
+        core = &cores[hdr.core];
+        core->lost = hdr.lost;
+
+        for (uint32_t i = 0; i < hdr.cnt; i++) {
+            if (fread((void *)&rec, sizeof(rec), 1, file) != 1) {
+                fprintf(stderr, "# %s: truncated block\n", __FUNCTION__);
+                break;
+            }
+            /* ccount wrap every 2^32 cycles, records are in order per core */
+            if (core->valid) {
+                core->cycles += (uint32_t)(rec.ccount - core->last_ccount);
+                if (rec.seq != core->last_seq + 1) {
+                    core->gaps++;
+                }
+            }
+            else {
+                core->cycles = rec.ccount;
+                core->valid = 1;
+            }
+            core->last_ccount = rec.ccount;
+            core->last_seq = rec.seq;
+
+            if (cnt == size) {
+                size = size ? size * 2 : 4096;
+                recs = realloc(recs, size * sizeof(*recs));
+                if (recs == NULL) {
+                    fprintf(stderr, "# %s: out of memory\n", __FUNCTION__);
+                    fclose(file);
+                    return 1;
+                }
+            }
+            recs[cnt].cycles = core->cycles;
+            recs[cnt].seq = rec.seq;
+            recs[cnt].core = hdr.core;
+            recs[cnt].evt = rec.evt;
+            recs[cnt].arg = rec.arg;
+            if (core->cycles < start) {
+                start = core->cycles;
+            }
+            cnt++;
+        }
+    }
+    fclose(file);
+
+    qsort(recs, cnt, sizeof(*recs), dump_cmp);
+
+    /* Time from trace start and from previous event on the same core */
+    printf("%14s %12s %4s %10s %-12s %5s\n", "time_us", "delta_us", "core", "seq", "event", "arg");
+    for (uint32_t i = 0; i < cnt; i++) {
+        struct dump_rec *dump = &recs[i];
+        struct dump_core *core = &cores[dump->core];
+        uint64_t delta = core->prev_valid ? dump->cycles - core->prev_cycles : 0;
+
+        core->prev_cycles = dump->cycles;
+        core->prev_valid = 1;
+        if (dump->evt < TRACE_EVT_MAX) {
+            printf("%14.3f %12.3f %4u %10u %-12s %5u\n", (double)(dump->cycles - start) / cpu_mhz,
+                (double)delta / cpu_mhz, dump->core, dump->seq, evt_names[dump->evt], dump->arg);
+        }
+        else {
+            printf("%14.3f %12.3f %4u %10u %-12u %5u\n", (double)(dump->cycles - start) / cpu_mhz,
+                (double)delta / cpu_mhz, dump->core, dump->seq, dump->evt, dump->arg);
+        }
+    }
+
+    for (uint32_t i = 0; i < TRACE_DUMP_CORE_MAX; i++) {
+        if (cores[i].valid) {
+            printf("# core %u: %u seq gaps, %u records lost\n", i, cores[i].gaps, cores[i].lost);
+        }
+    }
+    free(recs);
+    return 0;
+}
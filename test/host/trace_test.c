@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2019-2020, Jacques Gagnon
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/* Built with trace.c to reach the rings and drain */
+#define TRACE_ENABLE
+#include "trace.c"
+#include "host.h"
+#include "test.h"
+
+/* Check ring drain commit handling and write a trace file, in the same
+ * format as trace_task, for the trace_dump test.
+ */
+
+static FILE *trace_file;
+
+static uint32_t trace_drain_core(uint32_t core) {
+    struct trace_blk_hdr hdr = {.magic = TRACE_MAGIC};
+
+    hdr.core = core;
+    hdr.cnt = trace_ring_drain(&trace_rings[core]);
+    hdr.lost = trace_rings[core].lost;
+    if (hdr.cnt && trace_file) {
+        fwrite((void *)&hdr, sizeof(hdr), 1, trace_file);
+        fwrite((void *)trace_buf, sizeof(trace_buf[0]), hdr.cnt, trace_file);
+    }
+    return hdr.cnt;
+}
+
+static void trace_check_seq(uint32_t cnt, uint32_t first_seq) {
+    for (uint32_t i = 0; i < cnt; i++) {
+        TEST_CHECK(trace_buf[i].seq == first_seq + i, "record %u seq %u expected %u", i, trace_buf[i].seq, first_seq + i);
+    }
+}
+
+int main(int argc, char **argv) {
+    struct trace_ring *ring = &trace_rings[0];
+    struct trace_rec *rec;
+    uint32_t cnt, pos;
+
+    if (argc > 1) {
+        trace_file = fopen(argv[1], "wb");
+        TEST_CHECK(trace_file, "can't open %s", argv[1]);
+    }
+    host_ccount_step = 240;
+
+    /* A bridged report on core 0 and a wired poll on core 1 */
+    for (uint32_t i = 0; i < 10; i++) {
+        host_core_id = 0;
+        trace_event(TRACE_ACL_RX, i);
+        trace_event(TRACE_HIDP, i);
+        trace_event(TRACE_TO_GENERIC, 7);
+        trace_event(TRACE_MAPPING, 0);
+        trace_event(TRACE_FROM_GENERIC, 0);
+        host_core_id = 1;
+        trace_event(TRACE_ISR_ENTRY, 0);
+        trace_event(TRACE_ISR_EXIT, 0);
+    }
+    cnt = trace_drain_core(0);
+    TEST_CHECK(cnt == 50, "%u records on core 0", cnt);
+    trace_check_seq(cnt, 1);
+    TEST_CHECK(trace_buf[5].evt == TRACE_ACL_RX && trace_buf[5].arg == 1, "record 5 is %u/%u", trace_buf[5].evt, trace_buf[5].arg);
+    cnt = trace_drain_core(1);
+    TEST_CHECK(cnt == 20, "%u records on core 1", cnt);
+
+    /* Writer reserved a slot but didn't commit yet */
+    host_core_id = 0;
+    trace_event(TRACE_FB_TX, 1);
+    pos = (uint32_t)atomic_inc(&ring->head);
+    rec = &ring->recs[pos & (TRACE_RING_SIZE - 1)];
+    atomic_set((atomic_t *)&rec->seq, 0);
+    cnt = trace_drain_core(0);
+    TEST_CHECK(cnt == 1 && trace_buf[0].evt == TRACE_FB_TX, "%u records before uncommitted one", cnt);
+    rec->ccount = xthal_get_ccount();
+    rec->evt = TRACE_FB_TX;
+    rec->arg = 2;
+    atomic_set((atomic_t *)&rec->seq, pos + 1);
+    cnt = trace_drain_core(0);
+    TEST_CHECK(cnt == 1 && trace_buf[0].arg == 2, "%u records after commit", cnt);
+
+    /* Ring lapped before drain */
+    for (uint32_t i = 0; i < TRACE_RING_SIZE + 5; i++) {
+        trace_event(TRACE_ACL_RX, i);
+    }
+    cnt = trace_drain_core(0);
+    TEST_CHECK(cnt == TRACE_RING_SIZE && ring->lost == 5, "%u records %u lost after lap", cnt, ring->lost);
+    trace_check_seq(cnt, 53 + 5);
+
+    /* Slot rewritten by a later lap is skipped as lost */
+    trace_event(TRACE_ACL_RX, 0);
+    trace_event(TRACE_ACL_RX, 1);
+    rec = &ring->recs[(atomic_get(&ring->head) - 2) & (TRACE_RING_SIZE - 1)];
+    atomic_set((atomic_t *)&rec->seq, rec->seq + TRACE_RING_SIZE);
+    cnt = trace_drain_core(0);
+    TEST_CHECK(cnt == 1 && trace_buf[0].arg == 1 && ring->lost == 6, "%u records %u lost after overwrite", cnt, ring->lost);
+
+    if (trace_file) {
+        fclose(trace_file);
+    }
+    return TEST_RESULT();
+}